@@ -1,3 +1,9 @@
 #version 320 es
 
-void main(void) {}
+precision mediump float;
+
+layout(location = 0) in vec3 inColor;
+
+layout(location = 0) out vec4 outColor;
+
+void main(void) { outColor = vec4(inColor, 1.0); }
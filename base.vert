@@ -1,3 +1,11 @@
 #version 320 es
 
-void main(void) {}
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inColor;
+
+layout(location = 0) out vec3 outColor;
+
+void main(void) {
+  outColor = inColor;
+  gl_Position = vec4(inPosition, 1.0);
+}
@@ -1,9 +1,11 @@
 #pragma once
 
+#include <filesystem>
 #include <fstream>
 #include <sstream>
+#include <thread>
 
-bool readFile(const std::string &filepath, std::string &source) {
+inline bool readFile(const std::string &filepath, std::string &source) {
   std::ifstream fs(filepath);
   if (!fs.is_open()) { return false; }
 
@@ -13,3 +15,32 @@ bool readFile(const std::string &filepath, std::string &source) {
 
   return true;
 }
+
+// Write to a temporary sibling first and rename it over the destination, so
+// readers never observe a partially written file
+inline bool writeFileAtomic(const std::string &filepath, const void *data,
+                            size_t size) {
+  std::hash<std::thread::id> hasher{};
+  auto temporary = filepath + "." +
+                   std::to_string(hasher(std::this_thread::get_id())) + ".tmp";
+  {
+    std::ofstream fs(temporary, std::ios::binary | std::ios::trunc);
+    if (!fs.is_open()) { return false; }
+    fs.write(static_cast<const char *>(data),
+             static_cast<std::streamsize>(size));
+    fs.flush();
+    if (!fs.good()) {
+      fs.close();
+      std::filesystem::remove(temporary);
+      return false;
+    }
+  }
+
+  std::error_code error{};
+  std::filesystem::rename(temporary, filepath, error);
+  if (error) {
+    std::filesystem::remove(temporary, error);
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+
+// 64-bit FNV-1a. Unlike std::hash, the result is stable across runs, builds
+// and platforms, so it can be used for keys that are persisted to disk.
+constexpr uint64_t STABLE_HASH_SEED = 0xcbf29ce484222325ULL;
+
+inline uint64_t stableHash(const void *data, size_t size,
+                           uint64_t seed = STABLE_HASH_SEED) {
+  auto bytes = static_cast<const uint8_t *>(data);
+  for (size_t i = 0; i < size; ++i) {
+    seed ^= bytes[i];
+    seed *= 0x100000001b3ULL;
+  }
+  return seed;
+}
+
+inline uint64_t stableHash(std::string_view str,
+                           uint64_t seed = STABLE_HASH_SEED) {
+  // Mix in the length so that adjacent strings can't be re-split
+  seed = stableHash(str.data(), str.size(), seed);
+  size_t size = str.size();
+  return stableHash(&size, sizeof(size), seed);
+}
+
+template <typename T, std::enable_if_t<std::is_trivially_copyable_v<T> &&
+                                           !std::is_pointer_v<T>,
+                                       bool> = true>
+inline uint64_t stableHash(const T &value, uint64_t seed = STABLE_HASH_SEED) {
+  return stableHash(&value, sizeof(T), seed);
+}
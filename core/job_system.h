@@ -0,0 +1,428 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using Job = std::function<void()>;
+
+// Jobs of a group that have not finished yet. Jobs can be made to wait for a
+// counter, they are queued once it drops to zero. Only destroy a counter that
+// jobs were counted with after waiting for it
+struct JobCounter {
+public:
+  bool isDone() const { return count.load(std::memory_order_acquire) == 0; }
+
+private:
+  friend struct JobSystem;
+
+  std::atomic<size_t> count{0};
+  std::mutex mutex; // Guards the dependents, and the count dropping to zero
+  std::vector<std::pair<Job, bool>> dependents; // With whether in background
+};
+
+struct JobWorkerStats {
+  uint64_t executedCount{0};
+  uint64_t stealCount{0}; // Jobs taken from the deques of other workers
+  size_t queueDepth{0};
+  size_t maxQueueDepth{0};
+};
+
+struct JobSystemStats {
+  std::vector<JobWorkerStats> workers;
+  JobWorkerStats helpers{}; // Other threads running jobs while they wait
+  size_t sharedQueueDepth{0};
+  size_t maxSharedQueueDepth{0};
+  size_t backgroundQueueDepth{0};
+};
+
+// Worker threads that each run the jobs of their own deque, newest first,
+// and steal the oldest jobs of the others when theirs is empty. Jobs queued
+// from other threads go to a shared queue that is run in order. Threads that
+// wait for jobs run queued jobs meanwhile. Background jobs have a queue of
+// their own, taken from by idle workers only
+struct JobSystem {
+public:
+  static std::unique_ptr<JobSystem> make(size_t workerCount = 0) {
+    if (workerCount == 0) {
+      workerCount = std::max(2U, std::thread::hardware_concurrency()) - 1;
+    }
+
+    auto jobSystem = std::make_unique<JobSystem>();
+    jobSystem->mainThread = std::this_thread::get_id();
+    for (size_t i = 0; i < workerCount; ++i) {
+      jobSystem->workers.emplace_back(std::make_unique<Worker>());
+    }
+    try {
+      for (size_t i = 0; i < workerCount; ++i) {
+        jobSystem->threads.emplace_back(&JobSystem::work, jobSystem.get(), i);
+      }
+    } catch (const std::system_error &) {
+      if (jobSystem->threads.empty()) { return nullptr; }
+    }
+    return std::move(jobSystem);
+  }
+
+  ~JobSystem() {
+    {
+      std::lock_guard<std::mutex> guard(sleepMutex);
+      stopping = true;
+    }
+    condition.notify_all();
+    for (auto &thread : threads) { thread.join(); }
+  }
+
+  // Queue the job, counted by `counter` until it has run
+  void run(Job job, JobCounter *counter = nullptr) {
+    if (counter) { counter->count.fetch_add(1, std::memory_order_relaxed); }
+    push(wrap(std::move(job), counter));
+  }
+
+  // Queue a job nothing waits for soon, such as building resources ahead of
+  // time. Workers only run it when no other job is queued, and threads that
+  // wait for a counter never do, so it doesn't hold up the frame
+  void runBackground(Job job, JobCounter *counter = nullptr) {
+    if (counter) { counter->count.fetch_add(1, std::memory_order_relaxed); }
+    push(wrap(std::move(job), counter), true);
+  }
+
+  // Queue the job once `dependency` has dropped to zero
+  void runAfter(JobCounter &dependency, Job job, JobCounter *counter = nullptr,
+                bool background = false) {
+    if (counter) { counter->count.fetch_add(1, std::memory_order_relaxed); }
+    auto wrapped = wrap(std::move(job), counter);
+    {
+      std::lock_guard<std::mutex> guard(dependency.mutex);
+      if (dependency.count.load(std::memory_order_acquire) != 0) {
+        dependency.dependents.emplace_back(std::move(wrapped), background);
+        return;
+      }
+    }
+    push(std::move(wrapped), background);
+  }
+
+  // Queue the job once every counter of `dependencies` has dropped to zero
+  void runAfterAll(std::vector<JobCounter *> dependencies, Job job,
+                   JobCounter *counter = nullptr, bool background = false) {
+    if (dependencies.empty()) {
+      if (counter) { counter->count.fetch_add(1, std::memory_order_relaxed); }
+      push(wrap(std::move(job), counter), background);
+      return;
+    }
+    // Waits for one counter at a time, counted so that `counter` doesn't drop
+    // to zero in between
+    auto &dependency = *dependencies.back();
+    dependencies.pop_back();
+    runAfter(
+        dependency,
+        [this, dependencies = std::move(dependencies), job = std::move(job),
+         counter, background]() {
+          runAfterAll(dependencies, job, counter, background);
+        },
+        counter, background);
+  }
+
+  // A job with a result. Jobs must not block on the future of a job queued
+  // after their own, or on one queued from a worker
+  template <typename F>
+  auto submit(F &&function, JobCounter *counter = nullptr) {
+    using R = std::invoke_result_t<F>;
+    auto task =
+        std::make_shared<std::packaged_task<R()>>(std::forward<F>(function));
+    auto future = task->get_future();
+    run([task]() { (*task)(); }, counter);
+    return future;
+  }
+
+  // Run queued jobs, and main thread jobs on the main thread, until the
+  // counter drops to zero. Background jobs are left to the workers, the
+  // thread sleeps while there is nothing else to run
+  void wait(JobCounter &counter) {
+    auto index = getThreadIndex();
+    auto onMainThread = isMainThread();
+    while (!counter.isDone()) {
+      if (onMainThread) { runMainThreadJobs(); }
+      if (auto job = take(index, false)) {
+        job();
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(sleepMutex);
+      ++waitingCount;
+      waitCondition.wait(lock, [&]() {
+        return counter.isDone() ||
+               pendingCount.load(std::memory_order_acquire) > 0 ||
+               (onMainThread &&
+                mainThreadJobCount.load(std::memory_order_acquire) > 0);
+      });
+      --waitingCount;
+    }
+    // The last job may still be releasing the counter
+    std::lock_guard<std::mutex> guard(counter.mutex);
+  }
+
+  // Split [0, count) into batches of at least `minBatchSize` over the workers
+  // and the calling thread, and wait for them. `function` takes the begin and
+  // end of a batch
+  template <typename F>
+  void parallelFor(size_t count, size_t minBatchSize, F &&function) {
+    if (count == 0) { return; }
+    auto batchCount = std::clamp<size_t>(
+        count / std::max<size_t>(minBatchSize, 1), 1, workers.size() + 1);
+    JobCounter counter;
+    for (size_t i = 1; i < batchCount; ++i) {
+      run(
+          [&function, count, batchCount, i]() {
+            function(count * i / batchCount, count * (i + 1) / batchCount);
+          },
+          &counter);
+    }
+    function(0, count / batchCount);
+    wait(counter);
+  }
+
+  // Jobs that must run on the thread that made the system, such as
+  // presenting, run by runMainThreadJobs() and by waits on that thread
+  void runOnMainThread(Job job) {
+    {
+      std::lock_guard<std::mutex> guard(mainThreadMutex);
+      mainThreadJobs.emplace_back(std::move(job));
+      mainThreadJobCount.store(mainThreadJobs.size(),
+                               std::memory_order_release);
+    }
+    notifyWaiting();
+  }
+
+  void runMainThreadJobs() {
+    std::vector<Job> jobs;
+    {
+      std::lock_guard<std::mutex> guard(mainThreadMutex);
+      jobs.swap(mainThreadJobs);
+      mainThreadJobCount.store(0, std::memory_order_release);
+    }
+    for (auto &job : jobs) { job(); }
+  }
+
+  bool isMainThread() const { return std::this_thread::get_id() == mainThread; }
+
+  size_t getWorkerCount() const { return threads.size(); }
+
+  // Index of the calling worker, the worker count on other threads
+  size_t getThreadIndex() const {
+    return currentSystem == this ? currentWorker : workers.size();
+  }
+
+  JobSystemStats getStats() {
+    JobSystemStats stats{};
+    for (auto &worker : workers) {
+      JobWorkerStats workerStats{};
+      workerStats.executedCount = worker->executedCount.load();
+      workerStats.stealCount = worker->stealCount.load();
+      {
+        std::lock_guard<std::mutex> guard(worker->mutex);
+        workerStats.queueDepth = worker->jobs.size();
+        workerStats.maxQueueDepth = worker->maxQueueDepth;
+      }
+      stats.workers.emplace_back(workerStats);
+    }
+    stats.helpers.executedCount = helpers.executedCount.load();
+    stats.helpers.stealCount = helpers.stealCount.load();
+    std::lock_guard<std::mutex> guard(sharedMutex);
+    stats.sharedQueueDepth = sharedJobs.size();
+    stats.maxSharedQueueDepth = maxSharedQueueDepth;
+    stats.backgroundQueueDepth = backgroundJobs.size();
+    return stats;
+  }
+
+  void report() {
+    auto stats = getStats();
+    std::cout << "[JobSystem] " << stats.workers.size()
+              << " workers, shared queue depth " << stats.sharedQueueDepth
+              << " (max " << stats.maxSharedQueueDepth << "), background "
+              << stats.backgroundQueueDepth << ", waiting threads "
+              << stats.helpers.executedCount << " jobs / "
+              << stats.helpers.stealCount << " steals" << std::endl;
+    for (size_t i = 0; i < stats.workers.size(); ++i) {
+      const auto &worker = stats.workers[i];
+      std::cout << "[JobSystem]   worker " << i << " "
+                << worker.executedCount << " jobs / " << worker.stealCount
+                << " steals, queue depth " << worker.queueDepth << " (max "
+                << worker.maxQueueDepth << ")" << std::endl;
+    }
+  }
+
+private:
+  struct Worker {
+    std::mutex mutex;
+    std::deque<Job> jobs; // The owner works at the back, thieves at the front
+    size_t maxQueueDepth{0};
+    std::atomic<uint64_t> executedCount{0};
+    std::atomic<uint64_t> stealCount{0};
+  };
+
+  Job wrap(Job job, JobCounter *counter) {
+    if (!counter) { return job; }
+    return [this, job = std::move(job), counter]() {
+      job();
+      finish(*counter);
+    };
+  }
+
+  void finish(JobCounter &counter) {
+    std::vector<std::pair<Job, bool>> dependents;
+    {
+      std::lock_guard<std::mutex> guard(counter.mutex);
+      if (counter.count.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+        return;
+      }
+      dependents.swap(counter.dependents);
+    }
+    for (auto &[job, background] : dependents) {
+      push(std::move(job), background);
+    }
+    notifyWaiting();
+  }
+
+  // Wakes the threads waiting for a counter, to take a job or return
+  void notifyWaiting() {
+    {
+      std::lock_guard<std::mutex> guard(sleepMutex);
+      if (waitingCount == 0) { return; }
+    }
+    waitCondition.notify_all();
+  }
+
+  void push(Job job, bool background = false) {
+    // Counted first so that sleeping threads never miss a job
+    auto &count = background ? backgroundCount : pendingCount;
+    count.fetch_add(1, std::memory_order_release);
+    auto index = getThreadIndex();
+    if (background) {
+      std::lock_guard<std::mutex> guard(sharedMutex);
+      backgroundJobs.emplace_back(std::move(job));
+    } else if (index < workers.size()) {
+      auto &worker = *workers[index];
+      std::lock_guard<std::mutex> guard(worker.mutex);
+      worker.jobs.emplace_back(std::move(job));
+      worker.maxQueueDepth = std::max(worker.maxQueueDepth, worker.jobs.size());
+    } else {
+      std::lock_guard<std::mutex> guard(sharedMutex);
+      sharedJobs.emplace_back(std::move(job));
+      maxSharedQueueDepth = std::max(maxSharedQueueDepth, sharedJobs.size());
+    }
+    bool waiting{false};
+    {
+      std::lock_guard<std::mutex> guard(sleepMutex);
+      waiting = !background && waitingCount > 0;
+    }
+    condition.notify_one();
+    if (waiting) { waitCondition.notify_all(); }
+  }
+
+  // The newest job of the worker's own deque, else the oldest shared job,
+  // else the oldest job of another worker, else the oldest background job
+  Job take(size_t index, bool background) {
+    Job job;
+    if (index < workers.size()) {
+      auto &worker = *workers[index];
+      std::lock_guard<std::mutex> guard(worker.mutex);
+      if (!worker.jobs.empty()) {
+        job = std::move(worker.jobs.back());
+        worker.jobs.pop_back();
+      }
+    }
+    if (!job) {
+      std::lock_guard<std::mutex> guard(sharedMutex);
+      if (!sharedJobs.empty()) {
+        job = std::move(sharedJobs.front());
+        sharedJobs.pop_front();
+      }
+    }
+    // Deques that are busy are skipped at first, and locked when no other
+    // had a job, rather than given up on while their jobs are counted
+    bool contended{false};
+    for (size_t i = 1; !job && i <= 2 * workers.size(); ++i) {
+      auto &victim = *workers[(index + i) % workers.size()];
+      auto blocking = i > workers.size();
+      if (blocking && !contended) { break; }
+      std::unique_lock<std::mutex> lock(victim.mutex, std::defer_lock);
+      if (blocking) {
+        lock.lock();
+      } else if (!lock.try_lock()) {
+        contended = true;
+        continue;
+      }
+      if (victim.jobs.empty()) { continue; }
+      job = std::move(victim.jobs.front());
+      victim.jobs.pop_front();
+      auto &thief = index < workers.size() ? *workers[index] : helpers;
+      ++thief.stealCount;
+    }
+    if (job) {
+      pendingCount.fetch_sub(1, std::memory_order_relaxed);
+    } else if (background) {
+      std::lock_guard<std::mutex> guard(sharedMutex);
+      if (!backgroundJobs.empty()) {
+        job = std::move(backgroundJobs.front());
+        backgroundJobs.pop_front();
+        backgroundCount.fetch_sub(1, std::memory_order_relaxed);
+      }
+    }
+    if (!job) { return job; }
+    auto &runner = index < workers.size() ? *workers[index] : helpers;
+    ++runner.executedCount;
+    return job;
+  }
+
+  void work(size_t index) {
+    currentSystem = this;
+    currentWorker = index;
+    while (true) {
+      if (auto job = take(index, true)) {
+        job();
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(sleepMutex);
+      auto hasJobs = [this]() {
+        return pendingCount.load(std::memory_order_acquire) > 0 ||
+               backgroundCount.load(std::memory_order_acquire) > 0;
+      };
+      condition.wait(lock, [&]() { return stopping || hasJobs(); });
+      // Drain the queues before stopping
+      if (stopping && !hasJobs()) { return; }
+    }
+  }
+
+  inline static thread_local JobSystem *currentSystem{nullptr};
+  inline static thread_local size_t currentWorker{0};
+
+  std::vector<std::unique_ptr<Worker>> workers;
+  Worker helpers; // Stats of the threads that are not workers
+  std::mutex sharedMutex;
+  std::deque<Job> sharedJobs;
+  size_t maxSharedQueueDepth{0};
+  std::deque<Job> backgroundJobs; // Guarded by the shared mutex
+
+  std::atomic<size_t> pendingCount{0}; // Queued and not yet taken
+  std::atomic<size_t> backgroundCount{0}; // Of background jobs
+  std::mutex sleepMutex;
+  std::condition_variable condition; // Wakes the workers
+  bool stopping{false};
+  // Threads sleeping in wait(), guarded by the sleep mutex
+  std::condition_variable waitCondition;
+  size_t waitingCount{0};
+
+  std::thread::id mainThread;
+  std::mutex mainThreadMutex;
+  std::vector<Job> mainThreadJobs;
+  std::atomic<size_t> mainThreadJobCount{0};
+
+  std::vector<std::thread> threads;
+};
@@ -1,10 +1,16 @@
 #include "core/logging.h"
+#include "renderer/buffer.h"
 #include "renderer/device.h"
 #include "renderer/forward_subpass.h"
 #include "renderer/instance.h"
 #include "renderer/render_context.h"
 #include "renderer/render_pipeline.h"
+#include "scene/mesh.h"
 #include <GLFW/glfw3.h>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
 
 const char *windowTitle = "neon";
 uint32_t windowWidth{800};
@@ -16,6 +22,95 @@ VkSurfaceKHR surface{VK_NULL_HANDLE};
 Device device{};
 
 std::unique_ptr<RenderContext> renderContext;
+std::unique_ptr<RenderPipeline> renderPipeline;
+
+// Quads laid out in a grid, each a sub mesh of its own
+struct Grid {
+  std::unique_ptr<Buffer> vertexBuffer;
+  std::unique_ptr<Buffer> indexBuffer;
+  std::vector<SubMesh> subMeshes;
+  Mesh mesh;
+};
+
+std::unique_ptr<Grid> sceneGrid;
+std::unique_ptr<Grid> overlayGrid;
+
+// CPU time spent recording the frames
+double recordMilliseconds{0.0};
+uint64_t recordedFrameCount{0};
+
+// Device local and uploaded through the transfer queue when there is an
+// uploader, raising `uploadValue` to the value of the upload. Otherwise host
+// visible and written directly
+std::unique_ptr<Buffer> createBuffer(VkBufferUsageFlags usage,
+                                     const void *data, VkDeviceSize size,
+                                     uint64_t &uploadValue) {
+  if (auto uploader = renderContext->getUploader()) {
+    auto buffer =
+        Buffer::make(device, size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    uint64_t value{0};
+    if (!buffer || !uploader->uploadBuffer(*buffer, 0, data, size, value)) {
+      return nullptr;
+    }
+    uploadValue = std::max(uploadValue, value);
+    return std::move(buffer);
+  }
+  auto buffer = Buffer::make(device, size, usage,
+                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                 VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  if (!buffer) { return nullptr; }
+  std::memcpy(buffer->getMapped(), data, size);
+  return std::move(buffer);
+}
+
+// Quads scaled down by `quadScale` within their cells, at `depth`
+std::unique_ptr<Grid> createGrid(uint32_t columns, uint32_t rows, float depth,
+                                 float quadScale, uint64_t &uploadValue) {
+  auto grid = std::make_unique<Grid>();
+  std::vector<Vertex> vertices;
+  vertices.reserve(4 * columns * rows);
+  float width = 2.0f / static_cast<float>(columns);
+  float height = 2.0f / static_cast<float>(rows);
+  float insetX = width * (1.0f - quadScale) / 2.0f;
+  float insetY = height * (1.0f - quadScale) / 2.0f;
+  for (uint32_t row = 0; row < rows; ++row) {
+    for (uint32_t column = 0; column < columns; ++column) {
+      float x0 = -1.0f + width * static_cast<float>(column) + insetX;
+      float y0 = -1.0f + height * static_cast<float>(row) + insetY;
+      float x1 = x0 + width - 2.0f * insetX;
+      float y1 = y0 + height - 2.0f * insetY;
+      glm::vec3 color{static_cast<float>(column) / static_cast<float>(columns),
+                      static_cast<float>(row) / static_cast<float>(rows),
+                      depth};
+      vertices.push_back({{x0, y0, depth}, color});
+      vertices.push_back({{x1, y0, depth}, color});
+      vertices.push_back({{x0, y1, depth}, color});
+      vertices.push_back({{x1, y1, depth}, color});
+    }
+  }
+  // Counter clockwise in framebuffer coordinates, whose y axis points down
+  const uint16_t indices[] = {0, 2, 1, 1, 2, 3};
+
+  grid->vertexBuffer =
+      createBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vertices.data(),
+                   vertices.size() * sizeof(Vertex), uploadValue);
+  grid->indexBuffer = createBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indices,
+                                   sizeof(indices), uploadValue);
+  if (!grid->vertexBuffer || !grid->indexBuffer) { return nullptr; }
+
+  grid->subMeshes.resize(columns * rows);
+  for (size_t i = 0; i < grid->subMeshes.size(); ++i) {
+    auto &subMesh = grid->subMeshes[i];
+    subMesh.vertexBuffer = grid->vertexBuffer.get();
+    subMesh.indexBuffer = grid->indexBuffer.get();
+    subMesh.indexCount = 6;
+    subMesh.vertexOffset = static_cast<int32_t>(4 * i);
+    grid->mesh.subMeshes.push_back(&subMesh);
+  }
+  return std::move(grid);
+}
 
 void setViewport(CommandBuffer &commandBuffer, const VkExtent2D &extent) {
   VkViewport viewport{};
@@ -31,56 +126,84 @@ void setScissor(CommandBuffer &commandBuffer, const VkExtent2D &extent) {
   commandBuffer.setScissor(scissor);
 }
 
-void draw(CommandBuffer &commandBuffer, RenderTarget *renderTarget) {
+bool draw(CommandBuffer &commandBuffer, RenderTarget *renderTarget) {
   setViewport(commandBuffer, renderTarget->extent);
   setScissor(commandBuffer, renderTarget->extent);
 
-  // TODO
+  return renderPipeline->draw(commandBuffer, *renderTarget);
 }
 
-void render(CommandBuffer &commandBuffer, RenderTarget *renderTarget) {
-  auto &imageViews = renderTarget->imageViews;
-  { // image 0 is the swapchain
-    ImageMemoryBarrier memoryBarrier{};
-    memoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    memoryBarrier.newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-    memoryBarrier.srcAccess = 0;
-    memoryBarrier.dstAccess = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-    memoryBarrier.srcStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    memoryBarrier.dstStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-
-    commandBuffer.imageMemoryBarrier(imageViews[0], memoryBarrier);
-
-    for (size_t i = 2; i < imageViews.size(); ++i) {
-      commandBuffer.imageMemoryBarrier(imageViews[i], memoryBarrier);
-    }
-  }
-  {
-    ImageMemoryBarrier memoryBarrier{};
-    memoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    memoryBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-    memoryBarrier.srcAccess = 0;
-    memoryBarrier.dstAccess = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
-                              VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-    memoryBarrier.srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-    memoryBarrier.dstStage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
-                             VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
-
-    commandBuffer.imageMemoryBarrier(imageViews[1], memoryBarrier);
+bool render(CommandBuffer &commandBuffer, RenderTarget *renderTarget) {
+  // The render graph barriers the attachments before drawing
+  if (!draw(commandBuffer, renderTarget)) { return false; }
+
+  // Presenting waits for the semaphore the submit signals, not for a stage
+  commandBuffer.useImage(renderTarget->imageViews[0],
+                         {.layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR});
+  return true;
+}
+
+// Compare runs with a cold and a warm shader cache to see what it saves.
+// Preparing the subpasses requests the modules of every variant their sub
+// meshes are drawn with. Modules the shader pack has don't reach the cache
+void reportStartup(double milliseconds) {
+  auto modules = renderContext->getResourceCache().getStats().shaderModules;
+  std::cout << "[Startup] Render pipeline prepared in " << milliseconds
+            << " ms, " << modules.count << " shader modules";
+  if (auto shaderCache = renderContext->getResourceCache().getShaderCache()) {
+    auto stats = shaderCache->getStats();
+    std::cout << ", shader cache " << stats.hits << " hits / " << stats.misses
+              << " misses, load " << stats.loadMilliseconds << " ms, compile "
+              << stats.compileMilliseconds << " ms";
   }
+  std::cout << std::endl;
+}
 
-  draw(commandBuffer, renderTarget);
+void reportResourceCache() {
+  auto stats = renderContext->getResourceCache().getStats();
+  auto report = [](const char *name, const ResourceStats &stats) {
+    std::cout << "[ResourceCache] " << name << " " << stats.hits << " hits / "
+              << stats.misses << " misses / " << stats.evictions
+              << " evictions, " << stats.count << " resident" << std::endl;
+  };
+  report("Shader modules", stats.shaderModules);
+  report("Graphics pipelines", stats.graphicsPipelines);
+  report("Framebuffers", stats.framebuffers);
+}
 
-  {
-    ImageMemoryBarrier memoryBarrier{};
-    memoryBarrier.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-    memoryBarrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-    memoryBarrier.srcAccess = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-    memoryBarrier.srcStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    memoryBarrier.dstStage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+void reportCommandStats() {
+  const auto &stats = renderContext->getCommandStats();
+  std::cout << "[CommandBuffer] Last frame " << stats.emittedCount
+            << " state commands recorded, " << stats.elidedCount
+            << " redundant ones dropped, " << stats.barrierCount
+            << " barriers in " << stats.barrierBatchCount
+            << " batches, " << stats.drawCount
+            << " draws, static subpasses recorded "
+            << renderPipeline->getStaticRecordCount() << " times"
+            << std::endl;
+}
 
-    commandBuffer.imageMemoryBarrier(imageViews[0], memoryBarrier);
-  }
+// Compare runs with different draws per thread to see what splitting the
+// subpasses over threads saves
+void reportRecording(size_t minDrawsPerThread) {
+  if (recordedFrameCount == 0) { return; }
+  std::cout << "[Frame] Recorded in "
+            << recordMilliseconds / static_cast<double>(recordedFrameCount)
+            << " ms on average over " << recordedFrameCount
+            << " frames, on up to " << renderContext->getThreadCount()
+            << " threads from " << minDrawsPerThread << " draws per thread"
+            << std::endl;
+}
+
+void reportRenderGraph() {
+  constexpr VkDeviceSize KiB = 1024;
+  const auto &stats = renderPipeline->getRenderGraph().getStats();
+  std::cout << "[RenderGraph] Last frame " << stats.passCount << " passes, "
+            << stats.culledPassCount << " culled, " << stats.renderPassCount
+            << " render passes, " << stats.transientImageCount
+            << " transient images in " << stats.memorySlotCount
+            << " memory slots, " << stats.transientBytes / KiB << " KiB ("
+            << stats.unaliasedBytes / KiB << " KiB unaliased)" << std::endl;
 }
 
 bool update() {
@@ -89,13 +212,24 @@ bool update() {
   if (!commandBuffer->begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT)) {
     return false;
   }
-  render(*commandBuffer, renderContext->getActiveFrame()->getRenderTarget());
+  auto recordStart = std::chrono::steady_clock::now();
+  if (!render(*commandBuffer,
+              renderContext->getActiveFrame()->getRenderTarget())) {
+    return false;
+  }
+  recordMilliseconds += std::chrono::duration<double, std::milli>(
+                            std::chrono::steady_clock::now() - recordStart)
+                            .count();
+  ++recordedFrameCount;
   if (!commandBuffer->end()) { return false; }
   if (!renderContext->submit(commandBuffer)) { return false; }
   return true;
 }
 
-int main() {
+// neon [min draws per thread], 0 records every subpass on the main thread
+int main(int argc, char **argv) {
+  size_t minDrawsPerThread = argc > 1 ? std::stoul(argv[1]) : 64;
+
   std::cout << LOG_COLOR_MAGENTA << "Hello, stranger." << LOG_COLOR_RESET
             << std::endl;
   if (!glfwInit() || !glfwVulkanSupported()) { return 1; }
@@ -124,6 +258,9 @@ int main() {
     return 1;
   }
 
+#ifdef NEON_TRACK_HOST_MEMORY
+  device.hostAllocator = HostAllocator::make();
+#endif
   if (!createDevice(instance, &device, surface)) { return 1; }
 
   int width{0}, height{0};
@@ -133,30 +270,104 @@ int main() {
       Swapchain::make(device, surface, {(uint32_t)width, (uint32_t)height}, 3);
   if (!swapchain) { return 1; }
 
-  renderContext = RenderContext::make(std::move(swapchain));
+  // Large subpasses are recorded on up to four threads
+  renderContext = RenderContext::make(
+      std::move(swapchain), std::min(4U, std::thread::hardware_concurrency()));
   if (!renderContext) { return 1; }
 
-  ShaderSource vertShader{};
-  ShaderSource fragShader{};
-  if (!createShaderSource(&vertShader, "base.vert") ||
-      !createShaderSource(&fragShader, "base.frag")) {
+  if (auto pipelineCache =
+          PipelineCache::make(device, ".cache/pipelines.bin")) {
+    renderContext->getResourceCache().setPipelineCache(
+        std::move(pipelineCache));
+  }
+  ResourceCacheBudgets budgets{};
+  budgets.shaderModules.maxBytes = 64 * 1024 * 1024;
+  budgets.graphicsPipelines.maxCount = 4096;
+  budgets.framebuffers.maxCount = 64;
+  renderContext->getResourceCache().setBudgets(budgets);
+  if (auto shaderPack = ShaderPack::make(NEON_SHADER_PACK)) {
+    renderContext->getResourceCache().setShaderPack(std::move(shaderPack));
+  }
+  if (auto shaderCache = ShaderCache::make(".cache/shaders")) {
+    renderContext->getResourceCache().setShaderCache(std::move(shaderCache));
+  }
+
+  // Build what previous sessions needed while the first frames are prepared
+  if (auto resourceRecorder = ResourceRecorder::make(".cache/resources.bin")) {
+    auto log = resourceRecorder->getLog();
+    renderContext->getResourceCache().setResourceRecorder(
+        std::move(resourceRecorder));
+    renderContext->getResourceCache().warmup(log);
+  }
+
+#ifndef NDEBUG
+  renderContext->getResourceCache().enableShaderHotReload();
+  device.allocator->setReportInterval(3600);
+  if (device.hostAllocator) { device.hostAllocator->setReportInterval(3600); }
+#endif
+
+  // The overlay is nearer, depth is cleared to 0 and greater depth wins
+  uint64_t uploadValue{0};
+  sceneGrid = createGrid(32, 32, 0.25f, 0.9f, uploadValue);
+  overlayGrid = createGrid(16, 16, 0.5f, 0.3f, uploadValue);
+  if (!sceneGrid || !overlayGrid) { return 1; }
+  // The grids are drawn from the first frame on
+  if (auto uploader = renderContext->getUploader();
+      uploader && uploadValue > 0 && !uploader->wait(uploadValue)) {
     return 1;
   }
 
-  auto sceneSubpass = std::make_unique<ForwardSubpass>(
-      renderContext.get(), std::move(vertShader), std::move(fragShader));
+  auto prepareStart = std::chrono::steady_clock::now();
 
-  auto renderPipeline = std::make_unique<RenderPipeline>();
+  auto createSubpass = [](Grid &grid) -> std::unique_ptr<ForwardSubpass> {
+    ShaderSource vertShader{};
+    ShaderSource fragShader{};
+    if (!createShaderSource(&vertShader, "base.vert") ||
+        !createShaderSource(&fragShader, "base.frag")) {
+      return nullptr;
+    }
+    auto subpass = std::make_unique<ForwardSubpass>(
+        renderContext.get(), std::move(vertShader), std::move(fragShader));
+    subpass->addMesh(grid.mesh);
+    return subpass;
+  };
+  auto sceneSubpass = createSubpass(*sceneGrid);
+  // Recorded every frame, split over threads when it has enough draws
+  auto overlaySubpass = createSubpass(*overlayGrid);
+  if (!sceneSubpass || !overlaySubpass) { return 1; }
+  // The scene doesn't change, its draws are recorded once and reused
+  sceneSubpass->setStatic(true);
+
+  renderPipeline = std::make_unique<RenderPipeline>(renderContext.get());
+  renderPipeline->setMinDrawsPerThread(minDrawsPerThread);
   renderPipeline->addSubpass(std::move(sceneSubpass));
+  renderPipeline->addSubpass(std::move(overlaySubpass));
+
+  reportStartup(std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - prepareStart)
+                    .count());
 
   while (!glfwWindowShouldClose(window)) {
     if (!update()) { printf("update error\n"); }
     glfwPollEvents();
+    if (auto jobSystem = renderContext->getJobSystem()) {
+      jobSystem->runMainThreadJobs();
+    }
   }
 
   device.waitIdle();
 
+  reportResourceCache();
+  reportCommandStats();
+  reportRenderGraph();
+  reportRecording(minDrawsPerThread);
+  device.allocator->report();
+  if (device.hostAllocator) { device.hostAllocator->report(); }
+  if (auto jobSystem = renderContext->getJobSystem()) { jobSystem->report(); }
+
   renderPipeline.reset();
+  overlayGrid.reset();
+  sceneGrid.reset();
 
   renderContext.reset();
 
@@ -0,0 +1,47 @@
+#include "renderer/attachment_pool.h"
+
+constexpr VkImageUsageFlags ATTACHMENT_USAGE =
+    VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+    VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+    VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+
+AttachmentPool::~AttachmentPool() { trim(); }
+
+std::shared_ptr<Image>
+AttachmentPool::request(const VkExtent2D &extent, VkFormat format,
+                        VkImageUsageFlags usage,
+                        VkSampleCountFlagBits sampleCount, uint32_t index) {
+  if (!(usage & ~ATTACHMENT_USAGE)) {
+    usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+  }
+
+  Key key{extent.width, extent.height, format, usage, sampleCount, index};
+  auto &sharedImage = sharedImages[key];
+  if (auto image = sharedImage.lock()) { return image; }
+
+  std::unique_ptr<Image> image;
+  if (auto it = unusedImages.find(key); it != unusedImages.end()) {
+    image = std::move(it->second);
+    unusedImages.erase(it);
+  } else {
+    image = std::make_unique<Image>();
+    if (!createImage(image.get(), &device, extent, format, usage,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 1, 1, sampleCount)) {
+      return nullptr;
+    }
+  }
+
+  // The last render target to release the image hands it back to the pool
+  std::shared_ptr<Image> shared(image.release(), [this, key](Image *image) {
+    unusedImages[key].reset(image);
+  });
+  sharedImage = shared;
+  return shared;
+}
+
+void AttachmentPool::trim() {
+  for (auto &[key, image] : unusedImages) { destroyImage(image.get()); }
+  unusedImages.clear();
+  std::erase_if(sharedImages,
+                [](const auto &item) { return item.second.expired(); });
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "renderer/image.h"
+#include <map>
+#include <memory>
+#include <tuple>
+
+// Attachments that are only written and read within a frame, such as depth or
+// multisampled color, shared by the render targets that request the same
+// parameters. Frames use them one after another on the graphics queue, so a
+// single image serves every frame in flight
+struct AttachmentPool {
+public:
+  explicit AttachmentPool(Device &device) : device{device} {}
+
+  ~AttachmentPool();
+
+  // Requests with a different index get different images, for attachments
+  // that are read back in a later frame. Attachment only usages are made
+  // transient, to use lazily allocated memory where the device has it
+  std::shared_ptr<Image>
+  request(const VkExtent2D &extent, VkFormat format, VkImageUsageFlags usage,
+          VkSampleCountFlagBits sampleCount = VK_SAMPLE_COUNT_1_BIT,
+          uint32_t index = 0);
+
+  // Destroy the images no render target uses anymore, such as those of the
+  // previous extent after a resize. The device must be idle
+  void trim();
+
+private:
+  using Key = std::tuple<uint32_t, uint32_t, VkFormat, VkImageUsageFlags,
+                         VkSampleCountFlagBits, uint32_t>;
+
+  Device &device;
+  std::map<Key, std::weak_ptr<Image>> sharedImages;
+  // Released by every render target, reused until trimmed
+  std::map<Key, std::unique_ptr<Image>> unusedImages;
+};
@@ -0,0 +1,151 @@
+#include "renderer/barrier_batch.h"
+
+// Stages of synchronization2 without a legacy bit map to the legacy stages
+// that cover them, the others have the same value
+static VkPipelineStageFlags toLegacyStages(VkPipelineStageFlags2 stages) {
+  auto legacy = static_cast<VkPipelineStageFlags>(stages & 0xffffffff);
+  if (stages & (VK_PIPELINE_STAGE_2_COPY_BIT | VK_PIPELINE_STAGE_2_RESOLVE_BIT |
+                VK_PIPELINE_STAGE_2_BLIT_BIT | VK_PIPELINE_STAGE_2_CLEAR_BIT)) {
+    legacy |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+  }
+  if (stages & (VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT |
+                VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT)) {
+    legacy |= VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+  }
+  if (stages & VK_PIPELINE_STAGE_2_PRE_RASTERIZATION_SHADERS_BIT) {
+    legacy |= VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+              VK_PIPELINE_STAGE_TESSELLATION_CONTROL_SHADER_BIT |
+              VK_PIPELINE_STAGE_TESSELLATION_EVALUATION_SHADER_BIT |
+              VK_PIPELINE_STAGE_GEOMETRY_SHADER_BIT;
+  }
+  return legacy;
+}
+
+static VkAccessFlags toLegacyAccess(VkAccessFlags2 access) {
+  auto legacy = static_cast<VkAccessFlags>(access & 0xffffffff);
+  if (access & (VK_ACCESS_2_SHADER_SAMPLED_READ_BIT |
+                VK_ACCESS_2_SHADER_STORAGE_READ_BIT)) {
+    legacy |= VK_ACCESS_SHADER_READ_BIT;
+  }
+  if (access & VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT) {
+    legacy |= VK_ACCESS_SHADER_WRITE_BIT;
+  }
+  return legacy;
+}
+
+void BarrierBatch::addMemoryBarrier(const VkMemoryBarrier2 &barrier) {
+  memoryBarrier.srcStageMask |= barrier.srcStageMask;
+  memoryBarrier.srcAccessMask |= barrier.srcAccessMask;
+  memoryBarrier.dstStageMask |= barrier.dstStageMask;
+  memoryBarrier.dstAccessMask |= barrier.dstAccessMask;
+  hasMemoryBarrier = true;
+  ++barrierCount;
+}
+
+void BarrierBatch::addBufferBarrier(const VkBufferMemoryBarrier2 &barrier) {
+  // Drivers treat buffer barriers as global ones, unless they transfer the
+  // buffer to another queue family
+  if (barrier.srcQueueFamilyIndex == barrier.dstQueueFamilyIndex) {
+    VkMemoryBarrier2 global{VK_STRUCTURE_TYPE_MEMORY_BARRIER_2};
+    global.srcStageMask = barrier.srcStageMask;
+    global.srcAccessMask = barrier.srcAccessMask;
+    global.dstStageMask = barrier.dstStageMask;
+    global.dstAccessMask = barrier.dstAccessMask;
+    addMemoryBarrier(global);
+    return;
+  }
+  bufferBarriers.push_back(barrier);
+  ++barrierCount;
+}
+
+void BarrierBatch::addImageBarrier(const VkImageMemoryBarrier2 &barrier) {
+  imageBarriers.push_back(barrier);
+  ++barrierCount;
+}
+
+bool BarrierBatch::flush(VkCommandBuffer commandBuffer) {
+  if (empty()) { return false; }
+  if (pipelineBarrier2) {
+    VkDependencyInfo dependencyInfo{VK_STRUCTURE_TYPE_DEPENDENCY_INFO};
+    if (hasMemoryBarrier) {
+      dependencyInfo.memoryBarrierCount = 1;
+      dependencyInfo.pMemoryBarriers = &memoryBarrier;
+    }
+    dependencyInfo.bufferMemoryBarrierCount = bufferBarriers.size();
+    dependencyInfo.pBufferMemoryBarriers = bufferBarriers.data();
+    dependencyInfo.imageMemoryBarrierCount = imageBarriers.size();
+    dependencyInfo.pImageMemoryBarriers = imageBarriers.data();
+    pipelineBarrier2(commandBuffer, &dependencyInfo);
+  } else {
+    flushLegacy(commandBuffer);
+  }
+  clear();
+  return true;
+}
+
+void BarrierBatch::flushLegacy(VkCommandBuffer commandBuffer) {
+  VkPipelineStageFlags2 srcStages{VK_PIPELINE_STAGE_2_NONE};
+  VkPipelineStageFlags2 dstStages{VK_PIPELINE_STAGE_2_NONE};
+
+  VkMemoryBarrier legacyMemoryBarrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+  if (hasMemoryBarrier) {
+    legacyMemoryBarrier.srcAccessMask =
+        toLegacyAccess(memoryBarrier.srcAccessMask);
+    legacyMemoryBarrier.dstAccessMask =
+        toLegacyAccess(memoryBarrier.dstAccessMask);
+    srcStages |= memoryBarrier.srcStageMask;
+    dstStages |= memoryBarrier.dstStageMask;
+  }
+
+  std::vector<VkBufferMemoryBarrier> legacyBufferBarriers;
+  legacyBufferBarriers.reserve(bufferBarriers.size());
+  for (const auto &barrier : bufferBarriers) {
+    VkBufferMemoryBarrier legacy{VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER};
+    legacy.srcAccessMask = toLegacyAccess(barrier.srcAccessMask);
+    legacy.dstAccessMask = toLegacyAccess(barrier.dstAccessMask);
+    legacy.srcQueueFamilyIndex = barrier.srcQueueFamilyIndex;
+    legacy.dstQueueFamilyIndex = barrier.dstQueueFamilyIndex;
+    legacy.buffer = barrier.buffer;
+    legacy.offset = barrier.offset;
+    legacy.size = barrier.size;
+    legacyBufferBarriers.push_back(legacy);
+    srcStages |= barrier.srcStageMask;
+    dstStages |= barrier.dstStageMask;
+  }
+
+  std::vector<VkImageMemoryBarrier> legacyImageBarriers;
+  legacyImageBarriers.reserve(imageBarriers.size());
+  for (const auto &barrier : imageBarriers) {
+    VkImageMemoryBarrier legacy{VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+    legacy.srcAccessMask = toLegacyAccess(barrier.srcAccessMask);
+    legacy.dstAccessMask = toLegacyAccess(barrier.dstAccessMask);
+    legacy.oldLayout = barrier.oldLayout;
+    legacy.newLayout = barrier.newLayout;
+    legacy.srcQueueFamilyIndex = barrier.srcQueueFamilyIndex;
+    legacy.dstQueueFamilyIndex = barrier.dstQueueFamilyIndex;
+    legacy.image = barrier.image;
+    legacy.subresourceRange = barrier.subresourceRange;
+    legacyImageBarriers.push_back(legacy);
+    srcStages |= barrier.srcStageMask;
+    dstStages |= barrier.dstStageMask;
+  }
+
+  // Legacy barriers can't wait on, or block, no stage at all
+  auto srcStageMask = srcStages ? toLegacyStages(srcStages)
+                                : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+  auto dstStageMask = dstStages ? toLegacyStages(dstStages)
+                                : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+  vkCmdPipelineBarrier(commandBuffer, srcStageMask, dstStageMask, 0,
+                       hasMemoryBarrier ? 1 : 0, &legacyMemoryBarrier,
+                       legacyBufferBarriers.size(),
+                       legacyBufferBarriers.data(), legacyImageBarriers.size(),
+                       legacyImageBarriers.data());
+}
+
+void BarrierBatch::clear() {
+  hasMemoryBarrier = false;
+  memoryBarrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER_2};
+  bufferBarriers.clear();
+  imageBarriers.clear();
+  barrierCount = 0;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// Barriers collected until the next point commands depend on them, then
+// recorded with a single vkCmdPipelineBarrier2. Global barriers, and buffer
+// barriers that transfer no ownership, are merged into one memory barrier.
+// Without synchronization2 a single vkCmdPipelineBarrier waits on the stages
+// of all of them
+struct BarrierBatch {
+public:
+  BarrierBatch() = default;
+  // The core or extension entry point, null without synchronization2
+  explicit BarrierBatch(PFN_vkCmdPipelineBarrier2KHR pipelineBarrier2)
+      : pipelineBarrier2{pipelineBarrier2} {}
+
+  void addMemoryBarrier(const VkMemoryBarrier2 &barrier);
+  void addBufferBarrier(const VkBufferMemoryBarrier2 &barrier);
+  void addImageBarrier(const VkImageMemoryBarrier2 &barrier);
+
+  bool empty() const {
+    return !hasMemoryBarrier && bufferBarriers.empty() && imageBarriers.empty();
+  }
+  // Barriers added since the last flush, before merging
+  size_t size() const { return barrierCount; }
+
+  // Record the barriers, if any, and clear the batch
+  bool flush(VkCommandBuffer commandBuffer);
+  void clear();
+
+private:
+  void flushLegacy(VkCommandBuffer commandBuffer);
+
+  PFN_vkCmdPipelineBarrier2KHR pipelineBarrier2{nullptr};
+  bool hasMemoryBarrier{false};
+  VkMemoryBarrier2 memoryBarrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER_2};
+  std::vector<VkBufferMemoryBarrier2> bufferBarriers;
+  std::vector<VkImageMemoryBarrier2> imageBarriers;
+  size_t barrierCount{0};
+};
@@ -0,0 +1,60 @@
+#include "renderer/buffer.h"
+#include "renderer/device.h"
+#include <atomic>
+
+MemoryCategory getBufferMemoryCategory(VkBufferUsageFlags usage) {
+  if (usage & (VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+               VK_BUFFER_USAGE_INDEX_BUFFER_BIT)) {
+    return MemoryCategory::Geometry;
+  }
+  if (usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT) {
+    return MemoryCategory::Uniform;
+  }
+  if (usage == VK_BUFFER_USAGE_TRANSFER_SRC_BIT) {
+    return MemoryCategory::Staging;
+  }
+  return MemoryCategory::Other;
+}
+
+std::unique_ptr<Buffer>
+Buffer::make(Device &device, VkDeviceSize size, VkBufferUsageFlags usage,
+             VkMemoryPropertyFlags requiredProperties,
+             VkMemoryPropertyFlags preferredProperties) {
+  VkBufferCreateInfo createInfo{VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+  createInfo.size = size;
+  createInfo.usage = usage;
+  createInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  VkBuffer handle{VK_NULL_HANDLE};
+  auto callbacks = device.getAllocationCallbacks(VK_OBJECT_TYPE_BUFFER);
+  if (vkCreateBuffer(device.handle, &createInfo, callbacks, &handle) !=
+      VK_SUCCESS) {
+    return nullptr;
+  }
+
+  MemoryAllocation allocation{};
+  if (!device.allocator->allocateBufferMemory(
+          handle, getBufferMemoryCategory(usage), requiredProperties,
+          preferredProperties, allocation)) {
+    vkDestroyBuffer(device.handle, handle, callbacks);
+    return nullptr;
+  }
+
+  auto buffer = std::make_unique<Buffer>();
+  buffer->device = &device;
+  buffer->handle = handle;
+  static std::atomic<uint64_t> nextId{1};
+  buffer->id = nextId.fetch_add(1, std::memory_order_relaxed);
+  buffer->size = size;
+  buffer->usage = usage;
+  buffer->allocation = allocation;
+  return std::move(buffer);
+}
+
+Buffer::~Buffer() {
+  if (handle) {
+    vkDestroyBuffer(device->handle, handle,
+                    device->getAllocationCallbacks(VK_OBJECT_TYPE_BUFFER));
+    device->allocator->free(allocation);
+  }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "renderer/memory_allocator.h"
+#include <memory>
+#include <vulkan/vulkan.h>
+
+struct Device;
+
+// How the buffer was used by the commands recorded so far, as the state of
+// an image subresource without a layout
+struct BufferState {
+  VkPipelineStageFlags2 writeStages{VK_PIPELINE_STAGE_2_NONE};
+  VkAccessFlags2 writeAccess{VK_ACCESS_2_NONE};
+  VkPipelineStageFlags2 readStages{VK_PIPELINE_STAGE_2_NONE};
+  VkPipelineStageFlags2 visibleStages{VK_PIPELINE_STAGE_2_NONE};
+  VkAccessFlags2 visibleAccess{VK_ACCESS_2_NONE};
+};
+
+struct Buffer {
+public:
+  static std::unique_ptr<Buffer>
+  make(Device &device, VkDeviceSize size, VkBufferUsageFlags usage,
+       VkMemoryPropertyFlags requiredProperties,
+       VkMemoryPropertyFlags preferredProperties = 0);
+
+  ~Buffer();
+
+  // Null unless the memory is host visible
+  void *getMapped() const { return allocation.mapped; }
+
+  Device *device{nullptr};
+  VkBuffer handle{VK_NULL_HANDLE};
+  // Never reused, unlike the addresses and handles of destroyed buffers
+  uint64_t id{0};
+  VkDeviceSize size{0};
+  VkBufferUsageFlags usage{0};
+  MemoryAllocation allocation{};
+  BufferState state{};
+};
@@ -0,0 +1,58 @@
+#include "renderer/buffer_pool.h"
+#include "renderer/device.h"
+#include <algorithm>
+#include <cstring>
+
+void BufferAllocation::update(const void *data, size_t dataSize,
+                              size_t dataOffset) const {
+  memcpy(static_cast<char *>(mapped) + dataOffset, data, dataSize);
+}
+
+BufferPool::BufferPool(Device &device, VkBufferUsageFlags usage,
+                       VkDeviceSize blockSize)
+    : device{device}, usage{usage}, blockSize{blockSize} {
+  VkPhysicalDeviceProperties properties{};
+  vkGetPhysicalDeviceProperties(device.physicalDevice, &properties);
+  const auto &limits = properties.limits;
+  if (usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT) {
+    alignment = std::max(alignment, limits.minUniformBufferOffsetAlignment);
+  }
+  if (usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT) {
+    alignment = std::max(alignment, limits.minStorageBufferOffsetAlignment);
+  }
+}
+
+bool BufferPool::allocate(VkDeviceSize size, BufferAllocation &allocation) {
+  auto alignedOffset = (offset + alignment - 1) / alignment * alignment;
+  while (activeBlockIndex < blocks.size() &&
+         alignedOffset + size > blocks[activeBlockIndex]->size) {
+    ++activeBlockIndex;
+    alignedOffset = 0;
+  }
+
+  if (activeBlockIndex == blocks.size()) {
+    // Device local memory the host can write when there is any, such as on
+    // unified memory
+    auto block =
+        Buffer::make(device, std::max(size, blockSize), usage,
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                         VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (!block) { return false; }
+    blocks.emplace_back(std::move(block));
+    alignedOffset = 0;
+  }
+
+  const auto &block = blocks[activeBlockIndex];
+  allocation.buffer = block.get();
+  allocation.offset = alignedOffset;
+  allocation.size = size;
+  allocation.mapped = static_cast<char *>(block->getMapped()) + alignedOffset;
+  offset = alignedOffset + size;
+  return true;
+}
+
+void BufferPool::reset() {
+  activeBlockIndex = 0;
+  offset = 0;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "renderer/buffer.h"
+#include <vector>
+
+// A range of a pool buffer, valid until the pool is reset
+struct BufferAllocation {
+  const Buffer *buffer{nullptr};
+  VkDeviceSize offset{0};
+  VkDeviceSize size{0};
+  void *mapped{nullptr};
+
+  void update(const void *data, size_t dataSize, size_t dataOffset = 0) const;
+};
+
+// Hands out ranges of persistently mapped, host visible buffers with a bump
+// pointer. Full buffers are chained rather than replaced, and are reused from
+// the start once the pool is reset after the GPU is done with them. Not
+// thread safe, each recording thread uses its own pool
+struct BufferPool {
+public:
+  BufferPool(Device &device, VkBufferUsageFlags usage,
+             VkDeviceSize blockSize = 1024 * 1024);
+
+  bool allocate(VkDeviceSize size, BufferAllocation &allocation);
+
+  void reset();
+
+private:
+  Device &device;
+  VkBufferUsageFlags usage{0};
+  VkDeviceSize blockSize{0};
+  VkDeviceSize alignment{16}; // Offset alignment the usage requires
+  std::vector<std::unique_ptr<Buffer>> blocks;
+  size_t activeBlockIndex{0};
+  VkDeviceSize offset{0};
+};
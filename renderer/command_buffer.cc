@@ -1,7 +1,45 @@
 #include "renderer/command_buffer.h"
+#include "renderer/buffer.h"
 #include "renderer/command_pool.h"
 #include "renderer/device.h"
+#include "renderer/framebuffer.h"
 #include "renderer/image_view.h"
+#include "renderer/pipeline.h"
+#include "renderer/pipeline_layout.h"
+#include "renderer/render_pass.h"
+#include <algorithm>
+#include <cstring>
+
+constexpr VkAccessFlags2 WRITE_ACCESS =
+    VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT |
+    VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT |
+    VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+    VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_HOST_WRITE_BIT |
+    VK_ACCESS_2_MEMORY_WRITE_BIT;
+
+// The range of the view with the remaining levels and layers counted
+static VkImageSubresourceRange getSubresourceRange(const ImageView &imageView) {
+  auto range = imageView.subresourceRange;
+  if (range.levelCount == VK_REMAINING_MIP_LEVELS) {
+    range.levelCount = imageView.image->mipLevels - range.baseMipLevel;
+  }
+  if (range.layerCount == VK_REMAINING_ARRAY_LAYERS) {
+    range.layerCount = imageView.image->arrayLayers - range.baseArrayLayer;
+  }
+  return range;
+}
+
+static bool operator==(const VkViewport &a, const VkViewport &b) {
+  return a.x == b.x && a.y == b.y && a.width == b.width &&
+         a.height == b.height && a.minDepth == b.minDepth &&
+         a.maxDepth == b.maxDepth;
+}
+
+static bool operator==(const VkRect2D &a, const VkRect2D &b) {
+  return a.offset.x == b.offset.x && a.offset.y == b.offset.y &&
+         a.extent.width == b.extent.width &&
+         a.extent.height == b.extent.height;
+}
 
 std::unique_ptr<CommandBuffer> CommandBuffer::make(CommandPool *commandPool,
                                                    VkCommandBufferLevel level) {
@@ -20,61 +58,487 @@ std::unique_ptr<CommandBuffer> CommandBuffer::make(CommandPool *commandPool,
   auto commandBuffer = std::make_unique<CommandBuffer>();
   commandBuffer->level = level;
   commandBuffer->handle = handle;
+  commandBuffer->barriers =
+      BarrierBatch{commandPool->device.functions.cmdPipelineBarrier2};
   return std::move(commandBuffer);
 }
 
-void CommandBuffer::reset(CommandBufferResetMode resetMode) {
-  // TODO
+bool CommandBuffer::reset(CommandBufferResetMode resetMode) {
+  // Never begun since the last reset, there is nothing to release
+  if (resetMode == CommandBufferResetMode::ResetIndividually &&
+      state != CommandBufferState::Created) {
+    if (vkResetCommandBuffer(handle, 0) != VK_SUCCESS) { return false; }
+  }
+  state = CommandBufferState::Created;
+  renderPass = nullptr;
+  framebuffer = nullptr;
+  subpassIndex = 0;
+  return true;
 }
 
-bool CommandBuffer::begin(VkCommandBufferUsageFlags usage) {
+bool CommandBuffer::begin(VkCommandBufferUsageFlags usage,
+                          const CommandBuffer *primary,
+                          bool inheritFramebuffer) {
   if (state == CommandBufferState::Recording) { return false; }
   state = CommandBufferState::Recording;
 
-  // TODO reset each domain state
+  // Nothing is bound at the start of a command buffer, secondaries included
+  bindState = {};
+  barriers.clear();
+  stats = {};
 
   VkCommandBufferBeginInfo beginInfo{
       VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
   beginInfo.flags = usage;
-  // VkCommandBufferInheritanceInfo inheritanceInfo{
-  //     VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO};
-  // if (level == VK_COMMAND_BUFFER_LEVEL_SECONDARY) {}
-  return vkBeginCommandBuffer(handle, &beginInfo) == VK_SUCCESS;
+  VkCommandBufferInheritanceInfo inheritanceInfo{
+      VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO};
+  if (level == VK_COMMAND_BUFFER_LEVEL_SECONDARY) {
+    beginInfo.pInheritanceInfo = &inheritanceInfo;
+    if (primary && primary->renderPass) {
+      renderPass = primary->renderPass;
+      framebuffer = inheritFramebuffer ? primary->framebuffer : nullptr;
+      subpassIndex = primary->subpassIndex;
+      inheritanceInfo.renderPass = renderPass->handle;
+      inheritanceInfo.subpass = subpassIndex;
+      if (framebuffer) { inheritanceInfo.framebuffer = framebuffer->handle; }
+      beginInfo.flags |= VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    }
+  }
+  if (vkBeginCommandBuffer(handle, &beginInfo) != VK_SUCCESS) {
+    state = CommandBufferState::Created;
+    return false;
+  }
+  return true;
 }
 
 bool CommandBuffer::end() {
   if (state != CommandBufferState::Recording) { return false; }
+  flushBarriers();
   if (vkEndCommandBuffer(handle) != VK_SUCCESS) { return false; }
   state = CommandBufferState::Executable;
+  if (level == VK_COMMAND_BUFFER_LEVEL_SECONDARY) {
+    renderPass = nullptr;
+    framebuffer = nullptr;
+    subpassIndex = 0;
+  }
   return true;
 }
 
 void CommandBuffer::imageMemoryBarrier(
-    const ImageView &imageView, const ImageMemoryBarrier &memoryBarrier) const {
-  VkImageMemoryBarrier imageMemoryBarrier{
-      VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
-  imageMemoryBarrier.oldLayout = memoryBarrier.oldLayout;
-  imageMemoryBarrier.newLayout = memoryBarrier.newLayout;
-  imageMemoryBarrier.image = imageView.image->handle;
-  imageMemoryBarrier.subresourceRange = imageView.subresourceRange;
-  imageMemoryBarrier.srcAccessMask = memoryBarrier.srcAccess;
-  imageMemoryBarrier.dstAccessMask = memoryBarrier.dstAccess;
-  imageMemoryBarrier.srcQueueFamilyIndex = memoryBarrier.oldQueueFamily;
-  imageMemoryBarrier.dstQueueFamilyIndex = memoryBarrier.newQueueFamily;
+    const ImageView &imageView, const ImageMemoryBarrier &memoryBarrier) {
+  VkImageMemoryBarrier2 barrier{VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2};
+  barrier.srcStageMask = memoryBarrier.srcStage;
+  barrier.srcAccessMask = memoryBarrier.srcAccess;
+  barrier.dstStageMask = memoryBarrier.dstStage;
+  barrier.dstAccessMask = memoryBarrier.dstAccess;
+  barrier.oldLayout = memoryBarrier.oldLayout;
+  barrier.newLayout = memoryBarrier.newLayout;
+  barrier.srcQueueFamilyIndex = memoryBarrier.oldQueueFamily;
+  barrier.dstQueueFamilyIndex = memoryBarrier.newQueueFamily;
+  barrier.image = imageView.image->handle;
+  barrier.subresourceRange = imageView.subresourceRange;
+  barriers.addImageBarrier(barrier);
+  if (renderPass) { flushBarriers(); }
 
-  VkPipelineStageFlags srcStage = memoryBarrier.srcStage;
-  VkPipelineStageFlags dstStage = memoryBarrier.dstStage;
+  // Later uses wait for whatever the stages after the barrier do
+  auto &image = *imageView.image;
+  auto range = getSubresourceRange(imageView);
+  for (uint32_t level = range.baseMipLevel;
+       level < range.baseMipLevel + range.levelCount; ++level) {
+    for (uint32_t layer = range.baseArrayLayer;
+         layer < range.baseArrayLayer + range.layerCount; ++layer) {
+      image.getState(level, layer) = {
+          .layout = memoryBarrier.newLayout,
+          .writeStages = memoryBarrier.dstStage,
+          .writeAccess = memoryBarrier.dstAccess & WRITE_ACCESS,
+      };
+    }
+  }
+}
 
-  vkCmdPipelineBarrier(handle, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1,
-                       &imageMemoryBarrier);
+void CommandBuffer::bufferMemoryBarrier(
+    const Buffer &buffer, VkDeviceSize offset, VkDeviceSize size,
+    const BufferMemoryBarrier &memoryBarrier) {
+  VkBufferMemoryBarrier2 barrier{VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2};
+  barrier.srcStageMask = memoryBarrier.srcStage;
+  barrier.srcAccessMask = memoryBarrier.srcAccess;
+  barrier.dstStageMask = memoryBarrier.dstStage;
+  barrier.dstAccessMask = memoryBarrier.dstAccess;
+  barrier.srcQueueFamilyIndex = memoryBarrier.oldQueueFamily;
+  barrier.dstQueueFamilyIndex = memoryBarrier.newQueueFamily;
+  barrier.buffer = buffer.handle;
+  barrier.offset = offset;
+  barrier.size = size;
+  barriers.addBufferBarrier(barrier);
+  if (renderPass) { flushBarriers(); }
 }
 
-void CommandBuffer::setViewport(const VkViewport &viewport) const {
-  std::vector<VkViewport> viewports{viewport};
-  vkCmdSetViewport(handle, 0, viewports.size(), viewports.data());
+void CommandBuffer::memoryBarrier(const GlobalMemoryBarrier &memoryBarrier) {
+  VkMemoryBarrier2 barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER_2};
+  barrier.srcStageMask = memoryBarrier.srcStage;
+  barrier.srcAccessMask = memoryBarrier.srcAccess;
+  barrier.dstStageMask = memoryBarrier.dstStage;
+  barrier.dstAccessMask = memoryBarrier.dstAccess;
+  barriers.addMemoryBarrier(barrier);
+  if (renderPass) { flushBarriers(); }
 }
 
-void CommandBuffer::setScissor(const VkRect2D &scissor) const {
-  std::vector<VkRect2D> scissors{scissor};
-  vkCmdSetScissor(handle, 0, scissors.size(), scissors.data());
+// Whether the next use of an image subresource or buffer needs a barrier,
+// and the stages and access it waits for. The state is updated as if both
+// were recorded
+template <typename State>
+static bool useAccess(State &state, VkPipelineStageFlags2 stages,
+                      VkAccessFlags2 access, bool transition,
+                      VkPipelineStageFlags2 &srcStages,
+                      VkAccessFlags2 &srcAccess) {
+  auto writeAccess = access & WRITE_ACCESS;
+  auto readAccess = access & ~WRITE_ACCESS;
+
+  if (transition || writeAccess) {
+    // Writes, layout transitions included, wait for every earlier use
+    srcStages = state.writeStages | state.readStages;
+    srcAccess = state.writeAccess;
+    state.writeStages = stages;
+    state.writeAccess = writeAccess;
+    state.readStages = VK_PIPELINE_STAGE_2_NONE;
+    state.visibleStages = VK_PIPELINE_STAGE_2_NONE;
+    state.visibleAccess = VK_ACCESS_2_NONE;
+    if (!writeAccess) {
+      // Only transitioned, the reads of the use see it already
+      state.readStages = stages;
+      state.visibleStages = stages;
+      state.visibleAccess = readAccess;
+    }
+    return transition || srcStages != VK_PIPELINE_STAGE_2_NONE;
+  }
+
+  // Reads wait for the last write once per stage and access
+  state.readStages |= stages;
+  if ((stages & ~state.visibleStages) == 0 &&
+      (readAccess & ~state.visibleAccess) == 0) {
+    return false;
+  }
+  state.visibleStages |= stages;
+  state.visibleAccess |= readAccess;
+  srcStages = state.writeStages;
+  srcAccess = state.writeAccess;
+  return state.writeStages != VK_PIPELINE_STAGE_2_NONE;
+}
+
+// The barrier a subresource needs before `usage`, if any
+static std::optional<VkImageMemoryBarrier2>
+useSubresource(ImageSubresourceState &state, const ImageUsage &usage) {
+  VkImageMemoryBarrier2 barrier{VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2};
+  barrier.dstStageMask = usage.stages;
+  barrier.dstAccessMask = usage.access;
+  barrier.oldLayout = usage.discard ? VK_IMAGE_LAYOUT_UNDEFINED : state.layout;
+  barrier.newLayout = usage.layout;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+
+  bool transition = state.layout != usage.layout;
+  bool needed = useAccess(state, usage.stages, usage.access, transition,
+                          barrier.srcStageMask, barrier.srcAccessMask);
+  state.layout = usage.layout;
+  if (!needed) { return std::nullopt; }
+  // Only a transition or a write may throw the contents away
+  if (!transition && !(usage.access & WRITE_ACCESS)) {
+    barrier.oldLayout = barrier.newLayout;
+  }
+  return barrier;
+}
+
+static bool isSameBarrier(const VkImageMemoryBarrier2 &a,
+                          const VkImageMemoryBarrier2 &b) {
+  return a.srcStageMask == b.srcStageMask &&
+         a.srcAccessMask == b.srcAccessMask &&
+         a.dstStageMask == b.dstStageMask &&
+         a.dstAccessMask == b.dstAccessMask && a.oldLayout == b.oldLayout &&
+         a.newLayout == b.newLayout;
+}
+
+void CommandBuffer::useImage(const ImageView &imageView,
+                             const ImageUsage &usage) {
+  auto &image = *imageView.image;
+  auto range = getSubresourceRange(imageView);
+
+  // Subresources that need the same barrier are covered by one, first along
+  // the layers of a level, then along levels whose layers all match
+  std::vector<VkImageMemoryBarrier2> levelBarriers;
+  auto addLevelBarriers = [&]() {
+    for (const auto &barrier : levelBarriers) {
+      barriers.addImageBarrier(barrier);
+    }
+  };
+  for (uint32_t level = range.baseMipLevel;
+       level < range.baseMipLevel + range.levelCount; ++level) {
+    std::vector<VkImageMemoryBarrier2> layerBarriers;
+    for (uint32_t layer = range.baseArrayLayer;
+         layer < range.baseArrayLayer + range.layerCount; ++layer) {
+      auto barrier = useSubresource(image.getState(level, layer), usage);
+      if (!barrier) { continue; }
+      barrier->image = image.handle;
+      barrier->subresourceRange = {range.aspectMask, level, 1, layer, 1};
+      if (!layerBarriers.empty()) {
+        auto &last = layerBarriers.back();
+        const auto &lastRange = last.subresourceRange;
+        if (isSameBarrier(last, *barrier) &&
+            lastRange.baseArrayLayer + lastRange.layerCount == layer) {
+          ++last.subresourceRange.layerCount;
+          continue;
+        }
+      }
+      layerBarriers.push_back(*barrier);
+    }
+
+    bool sameLayers = !levelBarriers.empty() &&
+                      levelBarriers.size() == layerBarriers.size();
+    for (size_t i = 0; sameLayers && i < layerBarriers.size(); ++i) {
+      const auto &a = levelBarriers[i].subresourceRange;
+      const auto &b = layerBarriers[i].subresourceRange;
+      sameLayers = isSameBarrier(levelBarriers[i], layerBarriers[i]) &&
+                   a.baseArrayLayer == b.baseArrayLayer &&
+                   a.layerCount == b.layerCount &&
+                   a.baseMipLevel + a.levelCount == level;
+    }
+    if (sameLayers) {
+      for (auto &barrier : levelBarriers) {
+        ++barrier.subresourceRange.levelCount;
+      }
+    } else {
+      addLevelBarriers();
+      levelBarriers = std::move(layerBarriers);
+    }
+  }
+  addLevelBarriers();
+  if (renderPass) { flushBarriers(); }
+}
+
+void CommandBuffer::useBuffer(Buffer &buffer, const BufferUsage &usage) {
+  VkBufferMemoryBarrier2 barrier{VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2};
+  barrier.dstStageMask = usage.stages;
+  barrier.dstAccessMask = usage.access;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.buffer = buffer.handle;
+  barrier.size = VK_WHOLE_SIZE;
+  if (!useAccess(buffer.state, usage.stages, usage.access, false,
+                 barrier.srcStageMask, barrier.srcAccessMask)) {
+    return;
+  }
+  barriers.addBufferBarrier(barrier);
+  if (renderPass) { flushBarriers(); }
+}
+
+void CommandBuffer::flushBarriers() {
+  auto count = barriers.size();
+  if (!barriers.flush(handle)) { return; }
+  stats.barrierCount += count;
+  ++stats.barrierBatchCount;
+}
+
+void CommandBuffer::setViewport(const VkViewport &viewport) {
+  if (bindState.viewport == viewport) {
+    ++stats.elidedCount;
+    return;
+  }
+  vkCmdSetViewport(handle, 0, 1, &viewport);
+  bindState.viewport = viewport;
+  ++stats.emittedCount;
+}
+
+void CommandBuffer::setScissor(const VkRect2D &scissor) {
+  if (bindState.scissor == scissor) {
+    ++stats.elidedCount;
+    return;
+  }
+  vkCmdSetScissor(handle, 0, 1, &scissor);
+  bindState.scissor = scissor;
+  ++stats.emittedCount;
+}
+
+void CommandBuffer::bindPipeline(const GraphicsPipeline &pipeline) {
+  // Viewport and scissor are dynamic in every pipeline, binding one leaves
+  // them as they are
+  if (bindState.pipeline == pipeline.handle) {
+    ++stats.elidedCount;
+    return;
+  }
+  vkCmdBindPipeline(handle, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.handle);
+  bindState.pipeline = pipeline.handle;
+  ++stats.emittedCount;
+}
+
+void CommandBuffer::bindDescriptorSets(
+    const PipelineLayout &pipelineLayout, uint32_t firstSet,
+    const std::vector<VkDescriptorSet> &descriptorSets,
+    const std::vector<uint32_t> &dynamicOffsets) {
+  if (descriptorSets.empty()) { return; }
+  auto &bound = bindState.descriptorSets;
+  // Dynamic offsets can't be told apart per set, so a single binding of
+  // several sets with dynamic offsets keeps them all with its first set
+  auto matches = [&](size_t i) {
+    auto set = firstSet + i;
+    if (set >= bound.size()) { return false; }
+    const auto &binding = bound[set];
+    return binding.layout == pipelineLayout.handle &&
+           binding.descriptorSet == descriptorSets[i] &&
+           binding.dynamicOffsets ==
+               (i == 0 ? dynamicOffsets : std::vector<uint32_t>{});
+  };
+  bool redundant = true;
+  for (size_t i = 0; redundant && i < descriptorSets.size(); ++i) {
+    redundant = matches(i);
+  }
+  if (redundant) {
+    ++stats.elidedCount;
+    return;
+  }
+
+  vkCmdBindDescriptorSets(handle, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          pipelineLayout.handle, firstSet,
+                          descriptorSets.size(), descriptorSets.data(),
+                          dynamicOffsets.size(), dynamicOffsets.data());
+  ++stats.emittedCount;
+
+  // Sets bound with another layout may be disturbed, forget all of them
+  // rather than tracking which layouts are compatible
+  for (auto &binding : bound) {
+    if (binding.layout != pipelineLayout.handle) { binding = {}; }
+  }
+  bound.resize(std::max<size_t>(bound.size(),
+                                firstSet + descriptorSets.size()));
+  for (size_t i = 0; i < descriptorSets.size(); ++i) {
+    auto &binding = bound[firstSet + i];
+    binding.layout = pipelineLayout.handle;
+    binding.descriptorSet = descriptorSets[i];
+    binding.dynamicOffsets =
+        i == 0 ? dynamicOffsets : std::vector<uint32_t>{};
+  }
+}
+
+void CommandBuffer::bindVertexBuffers(
+    uint32_t firstBinding, const std::vector<const Buffer *> &buffers,
+    const std::vector<VkDeviceSize> &offsets) {
+  auto &bound = bindState.vertexBuffers;
+  bound.resize(std::max<size_t>(bound.size(), firstBinding + buffers.size()));
+
+  // Only the bindings between the first and last that change are recorded
+  size_t begin = buffers.size();
+  size_t end = 0;
+  for (size_t i = 0; i < buffers.size(); ++i) {
+    const auto &binding = bound[firstBinding + i];
+    if (binding.buffer != buffers[i]->handle || binding.offset != offsets[i]) {
+      begin = std::min(begin, i);
+      end = i + 1;
+    }
+  }
+  if (begin >= end) {
+    ++stats.elidedCount;
+    return;
+  }
+
+  std::vector<VkBuffer> handles;
+  handles.reserve(end - begin);
+  for (size_t i = begin; i < end; ++i) {
+    handles.push_back(buffers[i]->handle);
+    bound[firstBinding + i] = {buffers[i]->handle, offsets[i]};
+  }
+  vkCmdBindVertexBuffers(handle, firstBinding + begin, handles.size(),
+                         handles.data(), offsets.data() + begin);
+  ++stats.emittedCount;
+}
+
+void CommandBuffer::bindIndexBuffer(const Buffer &buffer, VkDeviceSize offset,
+                                    VkIndexType indexType) {
+  if (bindState.indexBuffer == buffer.handle &&
+      bindState.indexOffset == offset && bindState.indexType == indexType) {
+    ++stats.elidedCount;
+    return;
+  }
+  vkCmdBindIndexBuffer(handle, buffer.handle, offset, indexType);
+  bindState.indexBuffer = buffer.handle;
+  bindState.indexOffset = offset;
+  bindState.indexType = indexType;
+  ++stats.emittedCount;
+}
+
+void CommandBuffer::pushConstants(const PipelineLayout &pipelineLayout,
+                                  VkShaderStageFlags stages, uint32_t offset,
+                                  uint32_t size, const void *data) {
+  auto &bytes = bindState.pushConstants;
+  auto &byteStages = bindState.pushConstantStages;
+  if (bindState.pushConstantLayout != pipelineLayout.handle) {
+    bindState.pushConstantLayout = pipelineLayout.handle;
+    bytes.clear();
+    byteStages.clear();
+  }
+  bytes.resize(std::max<size_t>(bytes.size(), offset + size));
+  byteStages.resize(bytes.size(), 0);
+
+  bool redundant =
+      std::memcmp(bytes.data() + offset, data, size) == 0 &&
+      std::all_of(byteStages.begin() + offset,
+                  byteStages.begin() + offset + size,
+                  [stages](VkShaderStageFlags byte) { return byte == stages; });
+  if (redundant) {
+    ++stats.elidedCount;
+    return;
+  }
+
+  vkCmdPushConstants(handle, pipelineLayout.handle, stages, offset, size,
+                     data);
+  std::memcpy(bytes.data() + offset, data, size);
+  std::fill(byteStages.begin() + offset, byteStages.begin() + offset + size,
+            stages);
+  ++stats.emittedCount;
+}
+
+void CommandBuffer::drawIndexed(uint32_t indexCount, uint32_t instanceCount,
+                                uint32_t firstIndex, int32_t vertexOffset,
+                                uint32_t firstInstance) {
+  vkCmdDrawIndexed(handle, indexCount, instanceCount, firstIndex, vertexOffset,
+                   firstInstance);
+  ++stats.drawCount;
+}
+
+void CommandBuffer::beginRenderPass(
+    const RenderPass &renderPass, const Framebuffer &framebuffer,
+    const std::vector<VkClearValue> &clearValues, VkSubpassContents contents) {
+  flushBarriers();
+  VkRenderPassBeginInfo beginInfo{VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO};
+  beginInfo.renderPass = renderPass.handle;
+  beginInfo.framebuffer = framebuffer.handle;
+  beginInfo.renderArea.extent = framebuffer.extent;
+  beginInfo.clearValueCount = clearValues.size();
+  beginInfo.pClearValues = clearValues.data();
+  vkCmdBeginRenderPass(handle, &beginInfo, contents);
+  this->renderPass = &renderPass;
+  this->framebuffer = &framebuffer;
+  subpassIndex = 0;
+}
+
+void CommandBuffer::nextSubpass(VkSubpassContents contents) {
+  vkCmdNextSubpass(handle, contents);
+  ++subpassIndex;
+}
+
+void CommandBuffer::endRenderPass() {
+  vkCmdEndRenderPass(handle);
+  renderPass = nullptr;
+  framebuffer = nullptr;
+  subpassIndex = 0;
+}
+
+void CommandBuffer::executeCommands(
+    const std::vector<CommandBuffer *> &commandBuffers) {
+  flushBarriers();
+  std::vector<VkCommandBuffer> handles;
+  handles.reserve(commandBuffers.size());
+  for (auto commandBuffer : commandBuffers) {
+    handles.push_back(commandBuffer->handle);
+    stats.add(commandBuffer->stats);
+  }
+  vkCmdExecuteCommands(handle, handles.size(), handles.data());
+  bindState = {};
 }
@@ -1,10 +1,18 @@
 #pragma once
 
+#include "renderer/barrier_batch.h"
 #include "renderer/types.h"
 #include <memory>
+#include <optional>
+#include <vector>
 
+struct Buffer;
 struct CommandPool;
+struct Framebuffer;
+struct GraphicsPipeline;
 struct ImageView;
+struct PipelineLayout;
+struct RenderPass;
 
 enum class CommandBufferResetMode {
   ResetPool,
@@ -18,21 +26,130 @@ enum class CommandBufferState {
   Executable,
 };
 
+// State commands recorded, and dropped because they would have bound what
+// was already bound, barriers with the commands that recorded them, and draws
+struct CommandBufferStats {
+  uint64_t emittedCount{0};
+  uint64_t elidedCount{0};
+  uint64_t barrierCount{0};
+  uint64_t barrierBatchCount{0};
+  uint64_t drawCount{0};
+
+  void add(const CommandBufferStats &stats) {
+    emittedCount += stats.emittedCount;
+    elidedCount += stats.elidedCount;
+    barrierCount += stats.barrierCount;
+    barrierBatchCount += stats.barrierBatchCount;
+    drawCount += stats.drawCount;
+  }
+};
+
+// What the state commands recorded since begin() have bound
+struct CommandBufferBindState {
+  VkPipeline pipeline{VK_NULL_HANDLE};
+  std::optional<VkViewport> viewport;
+  std::optional<VkRect2D> scissor;
+
+  struct DescriptorSetBinding {
+    VkPipelineLayout layout{VK_NULL_HANDLE};
+    VkDescriptorSet descriptorSet{VK_NULL_HANDLE};
+    std::vector<uint32_t> dynamicOffsets;
+  };
+  std::vector<DescriptorSetBinding> descriptorSets; // By set number
+
+  struct VertexBufferBinding {
+    VkBuffer buffer{VK_NULL_HANDLE};
+    VkDeviceSize offset{0};
+  };
+  std::vector<VertexBufferBinding> vertexBuffers; // By binding
+
+  VkBuffer indexBuffer{VK_NULL_HANDLE};
+  VkDeviceSize indexOffset{0};
+  VkIndexType indexType{VK_INDEX_TYPE_UINT16};
+
+  VkPipelineLayout pushConstantLayout{VK_NULL_HANDLE};
+  std::vector<uint8_t> pushConstants; // By offset
+  // Stages each byte was pushed to, 0 for bytes not pushed yet
+  std::vector<VkShaderStageFlags> pushConstantStages;
+};
+
 struct CommandBuffer {
   static std::unique_ptr<CommandBuffer> make(CommandPool *commandPool,
                                              VkCommandBufferLevel level);
 
-  void reset(CommandBufferResetMode resetMode);
+  // Only command buffers of pools that reset them one by one are reset here,
+  // the others are reset or freed with their pool
+  bool reset(CommandBufferResetMode resetMode);
 
-  bool begin(VkCommandBufferUsageFlags usage);
+  // Secondary command buffers begun with the primary they are executed from
+  // continue the render pass the primary is in. Those executed with other
+  // framebuffers of compatible render passes leave the framebuffer out
+  bool begin(VkCommandBufferUsageFlags usage,
+             const CommandBuffer *primary = nullptr,
+             bool inheritFramebuffer = true);
   bool end();
 
+  // Barriers are batched until commands that depend on them are recorded,
+  // beginning a render pass, executing secondaries or ending. Inside a render
+  // pass they are recorded right away. Image barriers update the tracked
+  // state of the image as useImage() does
   void imageMemoryBarrier(const ImageView &imageView,
-                          const ImageMemoryBarrier &memoryBarrier) const;
-  void setViewport(const VkViewport &viewport) const;
-  void setScissor(const VkRect2D &scissor) const;
+                          const ImageMemoryBarrier &memoryBarrier);
+  void bufferMemoryBarrier(const Buffer &buffer, VkDeviceSize offset,
+                           VkDeviceSize size,
+                           const BufferMemoryBarrier &memoryBarrier);
+  void memoryBarrier(const GlobalMemoryBarrier &memoryBarrier);
+  void flushBarriers();
+
+  // Barrier the view from how its subresources were last used to `usage`,
+  // if they need one. Uses of an image are to be recorded from one thread
+  void useImage(const ImageView &imageView, const ImageUsage &usage);
+  void useBuffer(Buffer &buffer, const BufferUsage &usage);
+
+  // State commands, dropped when they would bind what is already bound
+  void setViewport(const VkViewport &viewport);
+  void setScissor(const VkRect2D &scissor);
+  void bindPipeline(const GraphicsPipeline &pipeline);
+  void bindDescriptorSets(const PipelineLayout &pipelineLayout,
+                          uint32_t firstSet,
+                          const std::vector<VkDescriptorSet> &descriptorSets,
+                          const std::vector<uint32_t> &dynamicOffsets = {});
+  void bindVertexBuffers(uint32_t firstBinding,
+                         const std::vector<const Buffer *> &buffers,
+                         const std::vector<VkDeviceSize> &offsets);
+  void bindIndexBuffer(const Buffer &buffer, VkDeviceSize offset,
+                       VkIndexType indexType);
+  void pushConstants(const PipelineLayout &pipelineLayout,
+                     VkShaderStageFlags stages, uint32_t offset, uint32_t size,
+                     const void *data);
+
+  // With the pipeline and buffers bound so far
+  void drawIndexed(uint32_t indexCount, uint32_t instanceCount = 1,
+                   uint32_t firstIndex = 0, int32_t vertexOffset = 0,
+                   uint32_t firstInstance = 0);
+
+  void beginRenderPass(
+      const RenderPass &renderPass, const Framebuffer &framebuffer,
+      const std::vector<VkClearValue> &clearValues,
+      VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
+  void nextSubpass(VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
+  void endRenderPass();
+
+  // Leaves the bound state undefined, and counts the state commands of the
+  // secondaries in the stats
+  void executeCommands(const std::vector<CommandBuffer *> &commandBuffers);
 
   VkCommandBufferLevel level{};
   VkCommandBuffer handle{VK_NULL_HANDLE};
   CommandBufferState state{CommandBufferState::Created};
+
+  // The render pass being recorded, or inherited by a secondary
+  const RenderPass *renderPass{nullptr};
+  const Framebuffer *framebuffer{nullptr};
+  uint32_t subpassIndex{0};
+
+  // All reset by begin()
+  CommandBufferBindState bindState{};
+  BarrierBatch barriers{};
+  CommandBufferStats stats{};
 };
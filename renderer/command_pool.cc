@@ -8,10 +8,10 @@ std::unique_ptr<CommandPool> CommandPool::make(Device &device,
   VkCommandPoolCreateFlags flags;
   switch (resetMode) {
   case CommandBufferResetMode::ResetIndividually:
-  case CommandBufferResetMode::AlwaysAllocate:
     flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
     break;
   case CommandBufferResetMode::ResetPool:
+  case CommandBufferResetMode::AlwaysAllocate:
   default:
     flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
     break;
@@ -22,8 +22,9 @@ std::unique_ptr<CommandPool> CommandPool::make(Device &device,
   createInfo.flags = flags;
 
   VkCommandPool handle{VK_NULL_HANDLE};
-  auto result =
-      vkCreateCommandPool(device.handle, &createInfo, nullptr, &handle);
+  auto result = vkCreateCommandPool(
+      device.handle, &createInfo,
+      device.getAllocationCallbacks(VK_OBJECT_TYPE_COMMAND_POOL), &handle);
   if (result != VK_SUCCESS) { return nullptr; }
 
   auto commandPool = std::make_unique<CommandPool>(device);
@@ -36,7 +37,9 @@ std::unique_ptr<CommandPool> CommandPool::make(Device &device,
 CommandPool::~CommandPool() {
   primaryCommandBuffers.clear();
   secondaryCommandBuffers.clear();
-  vkDestroyCommandPool(device.handle, handle, nullptr);
+  vkDestroyCommandPool(
+      device.handle, handle,
+      device.getAllocationCallbacks(VK_OBJECT_TYPE_COMMAND_POOL));
 }
 
 bool CommandPool::requestCommandBuffer(CommandBuffer **commandBuffer,
@@ -72,22 +75,51 @@ bool CommandPool::requestCommandBuffer(CommandBuffer **commandBuffer,
   return true;
 }
 
-void CommandPool::resetPool() {
+bool CommandPool::resetPool() {
   switch (resetMode) {
   case CommandBufferResetMode::ResetPool:
-    resetCommandBuffers();
-    break;
+    if (vkResetCommandPool(device.handle, handle, 0) != VK_SUCCESS) {
+      return false;
+    }
+    return resetCommandBuffers();
   case CommandBufferResetMode::ResetIndividually:
-    // TODO
-    break;
+    return resetCommandBuffers();
   case CommandBufferResetMode::AlwaysAllocate:
-    // TODO
-    break;
+    freeCommandBuffers();
+    return true;
   }
+  return false;
 }
 
-void CommandPool::resetCommandBuffers() {
+bool CommandPool::resetCommandBuffers() {
+  bool ok = true;
   for (auto &commandBuffer : primaryCommandBuffers) {
-    commandBuffer->reset(resetMode);
+    ok &= commandBuffer->reset(resetMode);
+  }
+  for (auto &commandBuffer : secondaryCommandBuffers) {
+    ok &= commandBuffer->reset(resetMode);
   }
+  activePrimaryCommandBufferCount = 0;
+  activeSecondaryCommandBufferCount = 0;
+  return ok;
+}
+
+void CommandPool::freeCommandBuffers() {
+  std::vector<VkCommandBuffer> handles;
+  handles.reserve(primaryCommandBuffers.size() +
+                  secondaryCommandBuffers.size());
+  for (const auto &commandBuffer : primaryCommandBuffers) {
+    handles.push_back(commandBuffer->handle);
+  }
+  for (const auto &commandBuffer : secondaryCommandBuffers) {
+    handles.push_back(commandBuffer->handle);
+  }
+  if (!handles.empty()) {
+    vkFreeCommandBuffers(device.handle, handle, handles.size(),
+                         handles.data());
+  }
+  primaryCommandBuffers.clear();
+  secondaryCommandBuffers.clear();
+  activePrimaryCommandBufferCount = 0;
+  activeSecondaryCommandBufferCount = 0;
 }
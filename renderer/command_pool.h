@@ -18,8 +18,14 @@ struct CommandPool {
       CommandBuffer **commandBuffer,
       VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
 
-  void resetPool();
-  void resetCommandBuffers();
+  // Make the command buffers of the pool available again, once the device is
+  // done with them. How depends on the reset mode:
+  // - ResetPool resets the pool, and with it every command buffer
+  // - ResetIndividually resets each command buffer that was begun
+  // - AlwaysAllocate frees them all, new ones are allocated on request
+  bool resetPool();
+  bool resetCommandBuffers();
+  void freeCommandBuffers();
 
   Device &device;
   CommandBufferResetMode resetMode{CommandBufferResetMode::ResetPool};
@@ -0,0 +1,47 @@
+#include "renderer/descriptor_set_layout.h"
+#include "renderer/device.h"
+#include <algorithm>
+
+std::unique_ptr<DescriptorSetLayout>
+DescriptorSetLayout::make(Device &device,
+                          const std::vector<ShaderResource> &resources) {
+  std::vector<VkDescriptorSetLayoutBinding> bindings;
+  for (const auto &resource : resources) {
+    VkDescriptorSetLayoutBinding binding{};
+    if (!getDescriptorType(resource.type, binding.descriptorType)) {
+      continue;
+    }
+    binding.binding = resource.binding;
+    // Runtime sized arrays need descriptor indexing, which the device doesn't
+    // enable, so they bind a single descriptor
+    binding.descriptorCount = std::max(resource.arraySize, 1U);
+    binding.stageFlags = resource.stages;
+    bindings.push_back(binding);
+  }
+
+  VkDescriptorSetLayoutCreateInfo createInfo{
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+  createInfo.bindingCount = bindings.size();
+  createInfo.pBindings = bindings.data();
+
+  VkDescriptorSetLayout handle{VK_NULL_HANDLE};
+  auto callbacks =
+      device.getAllocationCallbacks(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT);
+  if (vkCreateDescriptorSetLayout(device.handle, &createInfo, callbacks,
+                                  &handle) != VK_SUCCESS) {
+    return nullptr;
+  }
+
+  auto descriptorSetLayout = std::make_unique<DescriptorSetLayout>();
+  descriptorSetLayout->device = &device;
+  descriptorSetLayout->handle = handle;
+  descriptorSetLayout->bindings = std::move(bindings);
+  return std::move(descriptorSetLayout);
+}
+
+DescriptorSetLayout::~DescriptorSetLayout() {
+  if (!handle) { return; }
+  vkDestroyDescriptorSetLayout(
+      device->handle, handle,
+      device->getAllocationCallbacks(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT));
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "renderer/resource.h"
+#include "renderer/shader_reflection.h"
+#include <memory>
+#include <vector>
+
+struct Device;
+
+struct DescriptorSetLayout : public Resource {
+public:
+  // `resources` are the descriptors of one set, merged across stages
+  static std::unique_ptr<DescriptorSetLayout>
+  make(Device &device, const std::vector<ShaderResource> &resources);
+
+  ~DescriptorSetLayout() override;
+
+  const std::vector<VkDescriptorSetLayoutBinding> &getBindings() const {
+    return bindings;
+  }
+
+  Device *device{nullptr};
+  VkDescriptorSetLayout handle{VK_NULL_HANDLE};
+
+private:
+  std::vector<VkDescriptorSetLayoutBinding> bindings;
+};
@@ -14,6 +14,12 @@ bool isDepthStencilFormat(VkFormat format) {
          format == VK_FORMAT_D32_SFLOAT_S8_UINT || isDepthOnlyFormat(format);
 }
 
+// Append a structure to a pNext chain, `tail` points at the pNext to fill
+template <typename T> void appendToChain(void **&tail, T &structure) {
+  *tail = &structure;
+  tail = &structure.pNext;
+}
+
 bool createDevice(VkInstance instance, Device *device, VkSurfaceKHR surface) {
   // pick a physical device
   uint32_t physicalDeviceCount{0};
@@ -62,6 +68,7 @@ bool createDevice(VkInstance instance, Device *device, VkSurfaceKHR surface) {
   std::unordered_map<const char *, bool> requiredDeviceExtensions;
   requiredDeviceExtensions[VK_KHR_SWAPCHAIN_EXTENSION_NAME] = false;
   requiredDeviceExtensions["VK_KHR_portability_subset"] = true;
+  requiredDeviceExtensions[VK_EXT_MEMORY_BUDGET_EXTENSION_NAME] = true;
 
   uint32_t deviceExtensionCount;
   vkEnumerateDeviceExtensionProperties(device->physicalDevice, nullptr,
@@ -76,7 +83,7 @@ bool createDevice(VkInstance instance, Device *device, VkSurfaceKHR surface) {
   std::vector<const char *> enabledDeviceExtensions;
 
   for (const auto &requiredExtension : requiredDeviceExtensions) {
-    bool found;
+    bool found{false};
     for (const auto &availableExtension : availableDeviceExtensions) {
       if (equals(availableExtension.extensionName, requiredExtension.first)) {
         found = true;
@@ -91,6 +98,10 @@ bool createDevice(VkInstance instance, Device *device, VkSurfaceKHR surface) {
       }
     } else {
       enabledDeviceExtensions.emplace_back(requiredExtension.first);
+      if (equals(requiredExtension.first,
+                 VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)) {
+        device->features.memoryBudget = true;
+      }
     }
   }
 
@@ -98,17 +109,109 @@ bool createDevice(VkInstance instance, Device *device, VkSurfaceKHR surface) {
 
   createInfo.pQueueCreateInfos = queueCreateInfos.data();
   createInfo.queueCreateInfoCount = queueCreateInfos.size();
+
+  VkPhysicalDeviceProperties properties{};
+  vkGetPhysicalDeviceProperties(device->physicalDevice, &properties);
+  bool vulkan12 = properties.apiVersion >= VK_API_VERSION_1_2;
+  bool vulkan13 = properties.apiVersion >= VK_API_VERSION_1_3;
+
+  // Extensions of features that older devices may still have
+  auto enableExtension = [&](const char *name) {
+    for (const auto &availableExtension : availableDeviceExtensions) {
+      if (equals(availableExtension.extensionName, name)) {
+        enabledDeviceExtensions.emplace_back(name);
+        return true;
+      }
+    }
+    return false;
+  };
+  bool timelineSemaphoreExtension =
+      !vulkan12 && enableExtension(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+  bool synchronization2Extension =
+      !vulkan13 && enableExtension(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
   createInfo.enabledExtensionCount = enabledDeviceExtensions.size();
   createInfo.ppEnabledExtensionNames = enabledDeviceExtensions.data();
 
+  // Structures of features promoted to core are only valid in the chains of
+  // devices of that version
+  VkPhysicalDeviceVulkan12Features supportedFeatures12{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+  VkPhysicalDeviceTimelineSemaphoreFeatures supportedTimelineSemaphore{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES};
+  VkPhysicalDeviceSynchronization2Features supportedSynchronization2{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES};
+  VkPhysicalDeviceFeatures2 supportedFeatures{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+  void **supportedTail = &supportedFeatures.pNext;
+  if (vulkan12) { appendToChain(supportedTail, supportedFeatures12); }
+  if (timelineSemaphoreExtension) {
+    appendToChain(supportedTail, supportedTimelineSemaphore);
+  }
+  if (vulkan13 || synchronization2Extension) {
+    appendToChain(supportedTail, supportedSynchronization2);
+  }
+  vkGetPhysicalDeviceFeatures2(device->physicalDevice, &supportedFeatures);
+
+  void *enabledFeatures{nullptr};
+  void **enabledTail = &enabledFeatures;
+
+  VkPhysicalDeviceVulkan12Features features12{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+  features12.timelineSemaphore = supportedFeatures12.timelineSemaphore;
+  if (vulkan12) { appendToChain(enabledTail, features12); }
+  device->features.timelineSemaphore = features12.timelineSemaphore;
+
+  VkPhysicalDeviceTimelineSemaphoreFeatures timelineSemaphore{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES};
+  timelineSemaphore.timelineSemaphore =
+      supportedTimelineSemaphore.timelineSemaphore;
+  if (timelineSemaphoreExtension) {
+    appendToChain(enabledTail, timelineSemaphore);
+    device->features.timelineSemaphore = timelineSemaphore.timelineSemaphore;
+  }
+
+  VkPhysicalDeviceSynchronization2Features synchronization2{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES};
+  synchronization2.synchronization2 =
+      supportedSynchronization2.synchronization2;
+  if (vulkan13 || synchronization2Extension) {
+    appendToChain(enabledTail, synchronization2);
+  }
+  device->features.synchronization2 = synchronization2.synchronization2;
+
   VkPhysicalDeviceFeatures features{.samplerAnisotropy = VK_TRUE};
   createInfo.pEnabledFeatures = &features;
+  createInfo.pNext = enabledFeatures;
 
-  if (vkCreateDevice(device->physicalDevice, &createInfo, nullptr,
+  if (vkCreateDevice(device->physicalDevice, &createInfo,
+                     device->getAllocationCallbacks(VK_OBJECT_TYPE_DEVICE),
                      &device->handle) != VK_SUCCESS) {
     return false;
   }
 
+  // Core entry points are only valid on devices of that version
+  auto &functions = device->functions;
+  if (device->features.timelineSemaphore) {
+    functions.waitSemaphores =
+        reinterpret_cast<PFN_vkWaitSemaphoresKHR>(vkGetDeviceProcAddr(
+            device->handle,
+            vulkan12 ? "vkWaitSemaphores" : "vkWaitSemaphoresKHR"));
+    functions.getSemaphoreCounterValue =
+        reinterpret_cast<PFN_vkGetSemaphoreCounterValueKHR>(
+            vkGetDeviceProcAddr(device->handle,
+                                vulkan12 ? "vkGetSemaphoreCounterValue"
+                                         : "vkGetSemaphoreCounterValueKHR"));
+    device->features.timelineSemaphore =
+        functions.waitSemaphores && functions.getSemaphoreCounterValue;
+  }
+  if (device->features.synchronization2) {
+    functions.cmdPipelineBarrier2 =
+        reinterpret_cast<PFN_vkCmdPipelineBarrier2KHR>(vkGetDeviceProcAddr(
+            device->handle,
+            vulkan13 ? "vkCmdPipelineBarrier2" : "vkCmdPipelineBarrier2KHR"));
+    device->features.synchronization2 = functions.cmdPipelineBarrier2;
+  }
+
   // create queues
   device->queues.resize(queueFamilyPropertyCount);
   for (uint32_t queueFamilyIndex = 0U;
@@ -119,9 +222,13 @@ bool createDevice(VkInstance instance, Device *device, VkSurfaceKHR surface) {
       VkQueue handle{VK_NULL_HANDLE};
       vkGetDeviceQueue(device->handle, queueFamilyIndex, queueIndex, &handle);
 
+      // Devices made without a surface, such as by tools, present nowhere
       VkBool32 supportPresent{VK_FALSE};
-      vkGetPhysicalDeviceSurfaceSupportKHR(
-          device->physicalDevice, queueFamilyIndex, surface, &supportPresent);
+      if (surface) {
+        vkGetPhysicalDeviceSurfaceSupportKHR(device->physicalDevice,
+                                             queueFamilyIndex, surface,
+                                             &supportPresent);
+      }
 
       Queue queue{
           .handle = handle,
@@ -133,13 +240,19 @@ bool createDevice(VkInstance instance, Device *device, VkSurfaceKHR surface) {
     }
   }
 
+  device->allocator = MemoryAllocator::make(*device);
+  if (!device->allocator) { return false; }
+
   return true;
 }
 
 void destroyDevice(Device *device) {
+  device->allocator.reset();
   device->queues.clear();
-  vkDestroyDevice(device->handle, nullptr);
+  vkDestroyDevice(device->handle,
+                  device->getAllocationCallbacks(VK_OBJECT_TYPE_DEVICE));
   device->handle = VK_NULL_HANDLE;
+  device->hostAllocator.reset();
   device->physicalDevice = VK_NULL_HANDLE;
 }
 
@@ -209,6 +322,41 @@ bool Device::getQueue(VkQueueFlags requiredFlags, uint32_t index,
 
 bool Device::waitIdle() const { return vkDeviceWaitIdle(handle) == VK_SUCCESS; }
 
+bool Device::getTransferQueue(const Queue **queue) const {
+  // Graphics and compute queues support transfers without reporting it
+  VkQueueFlags transferFlags = VK_QUEUE_TRANSFER_BIT | VK_QUEUE_GRAPHICS_BIT |
+                               VK_QUEUE_COMPUTE_BIT;
+  const Queue *found{nullptr};
+  for (const auto &familyQueues : queues) {
+    const auto &q = familyQueues.front();
+    auto queueFlags = q.properties.queueFlags;
+    if (!(queueFlags & transferFlags)) { continue; }
+    if (!(queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+      *queue = &q;
+      return true;
+    }
+    if (!found && !(queueFlags & VK_QUEUE_GRAPHICS_BIT)) { found = &q; }
+  }
+  if (found) {
+    *queue = found;
+    return true;
+  }
+
+  const Queue *graphicsQueue{nullptr};
+  if (!getGraphicsQueue(&graphicsQueue)) { return false; }
+  const auto &familyQueues = queues[graphicsQueue->familyIndex];
+  *queue = familyQueues.size() > 1 && graphicsQueue == &familyQueues[0]
+               ? &familyQueues[1]
+               : graphicsQueue;
+  return true;
+}
+
+const VkAllocationCallbacks *
+Device::getAllocationCallbacks(VkObjectType type) const {
+  if (!hostAllocator) { return nullptr; }
+  return hostAllocator->getCallbacks(type);
+}
+
 bool Device::getGraphicsQueue(const Queue **queue) const {
   for (uint32_t queueFamilyIndex = 0; queueFamilyIndex < queues.size();
        ++queueFamilyIndex) {
@@ -1,17 +1,45 @@
 #pragma once
 
+#include "renderer/host_allocator.h"
+#include "renderer/memory_allocator.h"
 #include "renderer/queue.h"
 #include <vector>
 
+// Optional features, enabled when the device supports them
+struct DeviceFeatures {
+  bool timelineSemaphore{false}; // Core in 1.2, or VK_KHR_timeline_semaphore
+  bool memoryBudget{false}; // VK_EXT_memory_budget
+  bool synchronization2{false}; // Core in 1.3, or VK_KHR_synchronization2
+};
+
+// Entry points of features that older devices have as extensions, set when
+// the feature is enabled
+struct DeviceFunctions {
+  PFN_vkWaitSemaphoresKHR waitSemaphores{nullptr};
+  PFN_vkGetSemaphoreCounterValueKHR getSemaphoreCounterValue{nullptr};
+  PFN_vkCmdPipelineBarrier2KHR cmdPipelineBarrier2{nullptr};
+};
+
 struct Device {
   bool getQueue(VkQueueFlags requiredFlags, uint32_t index,
                 const Queue **queue) const;
   bool waitIdle() const;
   bool getGraphicsQueue(const Queue **queue) const;
+  // A queue of a transfer only family when there is one, so copies run
+  // alongside rendering, otherwise another or the same graphics queue
+  bool getTransferQueue(const Queue **queue) const;
+  // Null unless host allocations are tracked
+  const VkAllocationCallbacks *getAllocationCallbacks(VkObjectType type) const;
 
   VkPhysicalDevice physicalDevice{VK_NULL_HANDLE};
   VkDevice handle{VK_NULL_HANDLE};
   std::vector<std::vector<Queue>> queues;
+  DeviceFeatures features{};
+  DeviceFunctions functions{};
+  std::unique_ptr<MemoryAllocator> allocator;
+  // Set before createDevice to track host allocations, lives until
+  // destroyDevice
+  std::unique_ptr<HostAllocator> hostAllocator;
 };
 
 bool createDevice(VkInstance instance, Device *device, VkSurfaceKHR surface);
@@ -4,7 +4,8 @@
 FencePool::~FencePool() {
   wait();
   reset();
-  for (auto fence : fences) { vkDestroyFence(device.handle, fence, nullptr); }
+  auto callbacks = device.getAllocationCallbacks(VK_OBJECT_TYPE_FENCE);
+  for (auto fence : fences) { vkDestroyFence(device.handle, fence, callbacks); }
   fences.clear();
 }
 
@@ -15,7 +16,8 @@ bool FencePool::requestFence(VkFence &fence) {
   }
   VkFence handle{VK_NULL_HANDLE};
   VkFenceCreateInfo createInfo{VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
-  if (vkCreateFence(device.handle, &createInfo, nullptr, &handle) !=
+  auto callbacks = device.getAllocationCallbacks(VK_OBJECT_TYPE_FENCE);
+  if (vkCreateFence(device.handle, &createInfo, callbacks, &handle) !=
       VK_SUCCESS) {
     return false;
   }
@@ -1,5 +1,6 @@
 #include "renderer/forward_subpass.h"
 #include "scene/mesh.h"
+#include <unordered_set>
 
 ForwardSubpass::ForwardSubpass(RenderContext *renderContext,
                                ShaderSource &&vertexShader,
@@ -10,14 +11,20 @@ ForwardSubpass::ForwardSubpass(RenderContext *renderContext,
 void ForwardSubpass::prepare() {
   auto &cache = renderContext->getResourceCache();
 
+  // Queue every variant first so they compile in parallel, then wait
+  std::unordered_set<uint64_t> variantIds;
+  std::vector<std::shared_future<ShaderModule *>> shaderModules;
   for (auto mesh : meshes) {
     for (auto subMesh : mesh->subMeshes) {
       auto &variant = subMesh->shaderVariant;
+      if (!variantIds.insert(variant.getId()).second) { continue; }
 
-      cache.requestShaderModule(VK_SHADER_STAGE_VERTEX_BIT, vertexShader,
-                                variant);
-      cache.requestShaderModule(VK_SHADER_STAGE_FRAGMENT_BIT, fragmentShader,
-                                variant);
+      shaderModules.emplace_back(cache.requestShaderModuleAsync(
+          VK_SHADER_STAGE_VERTEX_BIT, vertexShader, variant));
+      shaderModules.emplace_back(cache.requestShaderModuleAsync(
+          VK_SHADER_STAGE_FRAGMENT_BIT, fragmentShader, variant));
     }
   }
+
+  for (auto &shaderModule : shaderModules) { shaderModule.wait(); }
 }
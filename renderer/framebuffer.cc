@@ -1 +1,46 @@
 #include "renderer/framebuffer.h"
+#include "renderer/device.h"
+#include "renderer/render_pass.h"
+#include "renderer/render_target.h"
+
+std::unique_ptr<Framebuffer> Framebuffer::make(Device &device,
+                                               const RenderTarget &renderTarget,
+                                               const RenderPass &renderPass) {
+  std::vector<VkImageView> attachments;
+  for (const auto &imageView : renderTarget.imageViews) {
+    attachments.push_back(imageView.handle);
+  }
+  return make(device, attachments, renderTarget.extent, renderPass);
+}
+
+std::unique_ptr<Framebuffer>
+Framebuffer::make(Device &device, const std::vector<VkImageView> &attachments,
+                  const VkExtent2D &extent, const RenderPass &renderPass) {
+  VkFramebufferCreateInfo createInfo{VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO};
+  createInfo.renderPass = renderPass.handle;
+  createInfo.attachmentCount = attachments.size();
+  createInfo.pAttachments = attachments.data();
+  createInfo.width = extent.width;
+  createInfo.height = extent.height;
+  createInfo.layers = 1;
+
+  VkFramebuffer handle{VK_NULL_HANDLE};
+  auto callbacks = device.getAllocationCallbacks(VK_OBJECT_TYPE_FRAMEBUFFER);
+  if (vkCreateFramebuffer(device.handle, &createInfo, callbacks, &handle) !=
+      VK_SUCCESS) {
+    return nullptr;
+  }
+
+  auto framebuffer = std::make_unique<Framebuffer>();
+  framebuffer->device = &device;
+  framebuffer->handle = handle;
+  framebuffer->extent = extent;
+  return std::move(framebuffer);
+}
+
+Framebuffer::~Framebuffer() {
+  if (!handle) { return; }
+  vkDestroyFramebuffer(
+      device->handle, handle,
+      device->getAllocationCallbacks(VK_OBJECT_TYPE_FRAMEBUFFER));
+}
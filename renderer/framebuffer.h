@@ -1,3 +1,26 @@
 #pragma once
 
-struct Framebuffer {};
+#include "renderer/resource.h"
+#include <memory>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+struct Device;
+struct RenderPass;
+struct RenderTarget;
+
+struct Framebuffer : public Resource {
+public:
+  static std::unique_ptr<Framebuffer> make(Device &device,
+                                           const RenderTarget &renderTarget,
+                                           const RenderPass &renderPass);
+  static std::unique_ptr<Framebuffer>
+  make(Device &device, const std::vector<VkImageView> &imageViews,
+       const VkExtent2D &extent, const RenderPass &renderPass);
+
+  ~Framebuffer() override;
+
+  Device *device{nullptr};
+  VkFramebuffer handle{VK_NULL_HANDLE};
+  VkExtent2D extent{};
+};
@@ -1,9 +1,109 @@
 #include "renderer/geometry_subpass.h"
+#include "scene/mesh.h"
 
 GeometrySubpass::GeometrySubpass(RenderContext *renderContext,
                                  ShaderSource &&vertexShader,
                                  ShaderSource &&fragmentShader)
     : Subpass(renderContext, std::move(vertexShader),
-              std::move(fragmentShader)) {}
+              std::move(fragmentShader)) {
+  vertexInput.bindings = {{0, sizeof(Vertex), VK_VERTEX_INPUT_RATE_VERTEX}};
+  vertexInput.attributes = {
+      {0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, position)},
+      {1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, color)},
+  };
+}
 
 void GeometrySubpass::prepare() {}
+
+// The render pipeline has prepared the draws
+bool GeometrySubpass::draw(CommandBuffer &commandBuffer,
+                           PipelineState &pipelineState) {
+  return drawRange(commandBuffer, pipelineState, 0, drawList.size(), 0);
+}
+
+size_t GeometrySubpass::prepareDraws() {
+  drawList.clear();
+  for (auto mesh : meshes) {
+    drawList.insert(drawList.end(), mesh->subMeshes.begin(),
+                    mesh->subMeshes.end());
+  }
+  return drawList.size();
+}
+
+void GeometrySubpass::getDraws(std::vector<SubpassDraw> &draws) const {
+  draws.clear();
+  for (auto subMesh : drawList) {
+    draws.push_back({
+        .subMesh = subMesh,
+        .variantId = subMesh->shaderVariant.getId(),
+        .vertexBufferId = subMesh->vertexBuffer ? subMesh->vertexBuffer->id : 0,
+        .indexBufferId = subMesh->indexBuffer ? subMesh->indexBuffer->id : 0,
+        .indexType = subMesh->indexType,
+        .indexCount = subMesh->indexCount,
+        .firstIndex = subMesh->firstIndex,
+        .vertexOffset = subMesh->vertexOffset,
+    });
+  }
+}
+
+// Once per variant, consecutive sub meshes usually share it
+bool GeometrySubpass::requestPipelines(PipelineState &pipelineState) {
+  const ShaderVariant *requestedVariant{nullptr};
+  for (auto subMesh : drawList) {
+    auto &variant = subMesh->shaderVariant;
+    if (requestedVariant && requestedVariant->getId() == variant.getId()) {
+      continue;
+    }
+    if (!requestPipeline(pipelineState, variant)) { return false; }
+    requestedVariant = &variant;
+  }
+  return true;
+}
+
+GraphicsPipeline *
+GeometrySubpass::requestPipeline(PipelineState &pipelineState,
+                                 const ShaderVariant &variant) {
+  auto &cache = renderContext->getResourceCache();
+  auto vertexModule = cache.requestShaderModule(VK_SHADER_STAGE_VERTEX_BIT,
+                                                vertexShader, variant);
+  auto fragmentModule = cache.requestShaderModule(
+      VK_SHADER_STAGE_FRAGMENT_BIT, fragmentShader, variant);
+  if (!vertexModule || !fragmentModule) { return nullptr; }
+
+  pipelineState.vertexInput = vertexInput;
+  pipelineState.shaderModules = {vertexModule, fragmentModule};
+  pipelineState.pipelineLayout =
+      cache.requestPipelineLayout(pipelineState.shaderModules);
+  if (!pipelineState.pipelineLayout) { return nullptr; }
+  return cache.requestGraphicsPipeline(pipelineState);
+}
+
+bool GeometrySubpass::drawRange(CommandBuffer &commandBuffer,
+                                PipelineState &pipelineState, size_t first,
+                                size_t count, size_t threadIndex) {
+  // Consecutive sub meshes of a variant share the pipeline, those of a mesh
+  // share the buffers
+  const ShaderVariant *boundVariant{nullptr};
+  const Buffer *vertexBuffer{nullptr};
+  for (size_t i = first; i < first + count; ++i) {
+    auto &subMesh = *drawList[i];
+    if (!subMesh.vertexBuffer || !subMesh.indexBuffer) { return false; }
+
+    auto &variant = subMesh.shaderVariant;
+    if (!boundVariant || boundVariant->getId() != variant.getId()) {
+      auto pipeline = requestPipeline(pipelineState, variant);
+      if (!pipeline) { return false; }
+      commandBuffer.bindPipeline(*pipeline);
+      boundVariant = &variant;
+    }
+
+    if (subMesh.vertexBuffer != vertexBuffer) {
+      commandBuffer.bindVertexBuffers(0, {subMesh.vertexBuffer}, {0});
+      vertexBuffer = subMesh.vertexBuffer;
+    }
+    commandBuffer.bindIndexBuffer(*subMesh.indexBuffer, 0, subMesh.indexType);
+    commandBuffer.drawIndexed(subMesh.indexCount, 1, subMesh.firstIndex,
+                              subMesh.vertexOffset);
+  }
+  return true;
+}
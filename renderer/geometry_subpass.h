@@ -3,14 +3,32 @@
 #include "renderer/subpass.h"
 
 struct Mesh;
+struct SubMesh;
 
 struct GeometrySubpass : public Subpass {
 public:
   GeometrySubpass(RenderContext *renderContext, ShaderSource &&vertexShader,
                   ShaderSource &&fragmentShader);
 
+  // Added before the subpass is prepared, the mesh outlives the subpass
+  void addMesh(Mesh &mesh) { meshes.push_back(&mesh); }
+
   void prepare() override;
 
+  bool draw(CommandBuffer &commandBuffer,
+            PipelineState &pipelineState) override;
+
+  size_t prepareDraws() override;
+  bool drawRange(CommandBuffer &commandBuffer, PipelineState &pipelineState,
+                 size_t first, size_t count, size_t threadIndex) override;
+  void getDraws(std::vector<SubpassDraw> &draws) const override;
+  bool requestPipelines(PipelineState &pipelineState) override;
+
 protected:
+  GraphicsPipeline *requestPipeline(PipelineState &pipelineState,
+                                    const ShaderVariant &variant);
+
   std::vector<Mesh *> meshes;
+  std::vector<SubMesh *> drawList; // Sub meshes of every mesh, in order
+  VertexInputState vertexInput{}; // Of the Vertex layout
 };
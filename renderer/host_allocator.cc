@@ -0,0 +1,307 @@
+#include "renderer/host_allocator.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+struct HostScopeCounters {
+  std::atomic<uint64_t> allocationCount{0};
+  std::atomic<uint64_t> arenaCount{0};
+  std::atomic<size_t> liveCount{0};
+  std::atomic<size_t> liveBytes{0};
+  std::atomic<size_t> internalBytes{0};
+};
+
+// The user data of the callbacks for one type of object
+struct HostAllocationTracker {
+  HostAllocator *allocator{nullptr};
+  VkAllocationCallbacks callbacks{};
+  std::array<HostScopeCounters, HOST_ALLOCATION_SCOPE_COUNT> scopes{};
+};
+
+// Command scope allocations are freed before the command returns, on the
+// thread that made them, so the arena needs no locking
+struct HostArena {
+  std::unique_ptr<std::byte[]> data;
+  size_t capacity{0};
+  size_t offset{0};
+  size_t liveCount{0};
+};
+
+thread_local HostArena threadArena{};
+
+// Stored right before every allocation
+struct HostAllocationHeader {
+  void *base{nullptr}; // Null for arena allocations
+  size_t size{0};
+  HostArena *arena{nullptr};
+  HostAllocationTracker *tracker{nullptr};
+  VkSystemAllocationScope scope{VK_SYSTEM_ALLOCATION_SCOPE_COMMAND};
+};
+
+static uintptr_t alignAddress(uintptr_t address, size_t alignment) {
+  return (address + alignment - 1) & ~(uintptr_t{alignment} - 1);
+}
+
+static HostAllocationHeader *getHeader(void *memory) {
+  return reinterpret_cast<HostAllocationHeader *>(memory) - 1;
+}
+
+static void *allocateFromArena(size_t arenaSize, size_t size,
+                               size_t alignment) {
+  auto &arena = threadArena;
+  if (!arena.data) {
+    arena.data = std::make_unique<std::byte[]>(arenaSize);
+    arena.capacity = arenaSize;
+  }
+  auto begin = reinterpret_cast<uintptr_t>(arena.data.get());
+  auto address = alignAddress(
+      begin + arena.offset + sizeof(HostAllocationHeader), alignment);
+  if (address + size > begin + arena.capacity) { return nullptr; }
+  arena.offset = address + size - begin;
+  ++arena.liveCount;
+  return reinterpret_cast<void *>(address);
+}
+
+static void *VKAPI_CALL allocateHost(void *userData, size_t size,
+                                     size_t alignment,
+                                     VkSystemAllocationScope scope) {
+  auto tracker = static_cast<HostAllocationTracker *>(userData);
+  alignment = std::max(alignment, alignof(HostAllocationHeader));
+
+  HostAllocationHeader header{.size = size, .tracker = tracker, .scope = scope};
+  void *memory{nullptr};
+  auto arenaSize = tracker->allocator->getArenaSize();
+  if (scope == VK_SYSTEM_ALLOCATION_SCOPE_COMMAND && arenaSize > 0) {
+    memory = allocateFromArena(arenaSize, size, alignment);
+    if (memory) { header.arena = &threadArena; }
+  }
+  if (!memory) {
+    header.base =
+        std::malloc(size + sizeof(HostAllocationHeader) + alignment);
+    if (!header.base) { return nullptr; }
+    memory = reinterpret_cast<void *>(alignAddress(
+        reinterpret_cast<uintptr_t>(header.base) +
+            sizeof(HostAllocationHeader),
+        alignment));
+  }
+  *getHeader(memory) = header;
+
+  auto &counters = tracker->scopes[scope];
+  ++counters.allocationCount;
+  if (header.arena) { ++counters.arenaCount; }
+  ++counters.liveCount;
+  counters.liveBytes += size;
+  return memory;
+}
+
+static void VKAPI_CALL freeHost(void *userData, void *memory) {
+  if (!memory) { return; }
+  auto header = *getHeader(memory);
+
+  auto &counters = header.tracker->scopes[header.scope];
+  --counters.liveCount;
+  counters.liveBytes -= header.size;
+
+  if (header.arena) {
+    if (--header.arena->liveCount == 0) { header.arena->offset = 0; }
+  } else {
+    std::free(header.base);
+  }
+}
+
+static void *VKAPI_CALL reallocateHost(void *userData, void *original,
+                                       size_t size, size_t alignment,
+                                       VkSystemAllocationScope scope) {
+  if (!original) { return allocateHost(userData, size, alignment, scope); }
+  if (size == 0) {
+    freeHost(userData, original);
+    return nullptr;
+  }
+  auto memory = allocateHost(userData, size, alignment, scope);
+  if (!memory) { return nullptr; }
+  std::memcpy(memory, original, std::min(size, getHeader(original)->size));
+  freeHost(userData, original);
+  return memory;
+}
+
+static void VKAPI_CALL notifyInternalAllocation(
+    void *userData, size_t size, VkInternalAllocationType allocationType,
+    VkSystemAllocationScope scope) {
+  auto tracker = static_cast<HostAllocationTracker *>(userData);
+  tracker->scopes[scope].internalBytes += size;
+}
+
+static void VKAPI_CALL notifyInternalFree(
+    void *userData, size_t size, VkInternalAllocationType allocationType,
+    VkSystemAllocationScope scope) {
+  auto tracker = static_cast<HostAllocationTracker *>(userData);
+  tracker->scopes[scope].internalBytes -= size;
+}
+
+const char *getAllocationScopeName(VkSystemAllocationScope scope) {
+  switch (scope) {
+  case VK_SYSTEM_ALLOCATION_SCOPE_COMMAND:
+    return "command";
+  case VK_SYSTEM_ALLOCATION_SCOPE_OBJECT:
+    return "object";
+  case VK_SYSTEM_ALLOCATION_SCOPE_CACHE:
+    return "cache";
+  case VK_SYSTEM_ALLOCATION_SCOPE_DEVICE:
+    return "device";
+  case VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE:
+    return "instance";
+  default:
+    return "unknown";
+  }
+}
+
+const char *getObjectTypeName(VkObjectType type) {
+  switch (type) {
+  case VK_OBJECT_TYPE_INSTANCE:
+    return "instance";
+  case VK_OBJECT_TYPE_DEVICE:
+    return "device";
+  case VK_OBJECT_TYPE_DEVICE_MEMORY:
+    return "device memory";
+  case VK_OBJECT_TYPE_BUFFER:
+    return "buffer";
+  case VK_OBJECT_TYPE_IMAGE:
+    return "image";
+  case VK_OBJECT_TYPE_IMAGE_VIEW:
+    return "image view";
+  case VK_OBJECT_TYPE_SAMPLER:
+    return "sampler";
+  case VK_OBJECT_TYPE_SHADER_MODULE:
+    return "shader module";
+  case VK_OBJECT_TYPE_PIPELINE_CACHE:
+    return "pipeline cache";
+  case VK_OBJECT_TYPE_PIPELINE_LAYOUT:
+    return "pipeline layout";
+  case VK_OBJECT_TYPE_PIPELINE:
+    return "pipeline";
+  case VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT:
+    return "descriptor set layout";
+  case VK_OBJECT_TYPE_DESCRIPTOR_POOL:
+    return "descriptor pool";
+  case VK_OBJECT_TYPE_RENDER_PASS:
+    return "render pass";
+  case VK_OBJECT_TYPE_FRAMEBUFFER:
+    return "framebuffer";
+  case VK_OBJECT_TYPE_COMMAND_POOL:
+    return "command pool";
+  case VK_OBJECT_TYPE_FENCE:
+    return "fence";
+  case VK_OBJECT_TYPE_SEMAPHORE:
+    return "semaphore";
+  case VK_OBJECT_TYPE_SWAPCHAIN_KHR:
+    return "swapchain";
+  default:
+    return "other";
+  }
+}
+
+std::unique_ptr<HostAllocator> HostAllocator::make(size_t arenaSize) {
+  auto allocator = std::make_unique<HostAllocator>();
+  allocator->arenaSize = arenaSize;
+  return std::move(allocator);
+}
+
+HostAllocator::~HostAllocator() = default;
+
+const VkAllocationCallbacks *HostAllocator::getCallbacks(VkObjectType type) {
+  std::lock_guard<std::mutex> guard(mutex);
+  auto &tracker = trackers[type];
+  if (!tracker) {
+    tracker = std::make_unique<HostAllocationTracker>();
+    tracker->allocator = this;
+    tracker->callbacks = {
+        .pUserData = tracker.get(),
+        .pfnAllocation = allocateHost,
+        .pfnReallocation = reallocateHost,
+        .pfnFree = freeHost,
+        .pfnInternalAllocation = notifyInternalAllocation,
+        .pfnInternalFree = notifyInternalFree,
+    };
+  }
+  return &tracker->callbacks;
+}
+
+HostAllocationStats HostAllocator::getStats() {
+  std::lock_guard<std::mutex> guard(mutex);
+  HostAllocationStats stats{};
+  for (const auto &[type, tracker] : trackers) {
+    HostObjectStats objectStats{.type = type};
+    for (size_t i = 0; i < HOST_ALLOCATION_SCOPE_COUNT; ++i) {
+      const auto &counters = tracker->scopes[i];
+      HostScopeStats scopeStats{
+          .allocationCount = counters.allocationCount.load(),
+          .arenaCount = counters.arenaCount.load(),
+          .liveCount = counters.liveCount.load(),
+          .liveBytes = counters.liveBytes.load(),
+          .internalBytes = counters.internalBytes.load(),
+      };
+      for (auto total : {&stats.scopes[i], &objectStats.stats}) {
+        total->allocationCount += scopeStats.allocationCount;
+        total->arenaCount += scopeStats.arenaCount;
+        total->liveCount += scopeStats.liveCount;
+        total->liveBytes += scopeStats.liveBytes;
+        total->internalBytes += scopeStats.internalBytes;
+      }
+    }
+    stats.objectTypes.emplace_back(objectStats);
+  }
+  std::sort(stats.objectTypes.begin(), stats.objectTypes.end(),
+            [](const auto &a, const auto &b) {
+              return a.stats.allocationCount > b.stats.allocationCount;
+            });
+  stats.frameAllocationCount = frameAllocationCount;
+  return stats;
+}
+
+void HostAllocator::update() {
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    uint64_t allocationCount{0};
+    for (const auto &[type, tracker] : trackers) {
+      for (const auto &counters : tracker->scopes) {
+        allocationCount += counters.allocationCount.load();
+      }
+    }
+    frameAllocationCount = allocationCount - lastAllocationCount;
+    lastAllocationCount = allocationCount;
+  }
+
+  ++frameCount;
+  if (reportInterval > 0 && frameCount % reportInterval == 0) { report(); }
+}
+
+void HostAllocator::report() {
+  constexpr size_t KiB = 1024;
+  auto stats = getStats();
+  HostScopeStats total{};
+  for (const auto &scope : stats.scopes) {
+    total.allocationCount += scope.allocationCount;
+    total.liveBytes += scope.liveBytes;
+  }
+  std::cout << "[HostAllocator] " << total.allocationCount
+            << " allocations, " << stats.frameAllocationCount
+            << " in the last frame, " << total.liveBytes / KiB << " KiB live"
+            << std::endl;
+  for (size_t i = 0; i < stats.scopes.size(); ++i) {
+    const auto &scope = stats.scopes[i];
+    if (scope.allocationCount == 0 && scope.internalBytes == 0) { continue; }
+    std::cout << "[HostAllocator]   "
+              << getAllocationScopeName(static_cast<VkSystemAllocationScope>(i))
+              << " scope " << scope.allocationCount << " allocations ("
+              << scope.arenaCount << " from arenas), "
+              << scope.liveBytes / KiB << " KiB live, "
+              << scope.internalBytes / KiB << " KiB internal" << std::endl;
+  }
+  for (const auto &object : stats.objectTypes) {
+    if (object.stats.allocationCount == 0) { continue; }
+    std::cout << "[HostAllocator]   " << getObjectTypeName(object.type) << " "
+              << object.stats.allocationCount << " allocations, "
+              << object.stats.liveBytes / KiB << " KiB live" << std::endl;
+  }
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+constexpr size_t HOST_ALLOCATION_SCOPE_COUNT =
+    VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1;
+
+const char *getAllocationScopeName(VkSystemAllocationScope scope);
+const char *getObjectTypeName(VkObjectType type);
+
+struct HostScopeStats {
+  uint64_t allocationCount{0}; // Since the allocator was made
+  uint64_t arenaCount{0};      // Of these, served by a thread arena
+  size_t liveCount{0};
+  size_t liveBytes{0};
+  size_t internalBytes{0}; // Reported by the driver, not allocated by us
+};
+
+struct HostObjectStats {
+  VkObjectType type{VK_OBJECT_TYPE_UNKNOWN};
+  HostScopeStats stats{}; // Summed over the scopes
+};
+
+struct HostAllocationStats {
+  std::array<HostScopeStats, HOST_ALLOCATION_SCOPE_COUNT> scopes{};
+  std::vector<HostObjectStats> objectTypes;
+  uint64_t frameAllocationCount{0}; // In the last frame
+};
+
+struct HostAllocationTracker;
+
+// Host memory for the driver, through allocation callbacks that record what
+// it allocates per scope and per type of object created. Command scope
+// allocations only live for the duration of a Vulkan command, so they can be
+// served from a bump arena of the calling thread that is rewound once all of
+// them are freed
+struct HostAllocator {
+public:
+  static std::unique_ptr<HostAllocator>
+  make(size_t arenaSize = 256 * 1024);
+
+  ~HostAllocator();
+
+  // Callbacks to create and destroy objects of the type with, the same for
+  // the lifetime of the allocator
+  const VkAllocationCallbacks *getCallbacks(VkObjectType type);
+
+  HostAllocationStats getStats();
+
+  // Call once per frame to count the allocations made in the frame loop, and
+  // to report the stats every report interval
+  void update();
+
+  void setReportInterval(uint64_t frames) { reportInterval = frames; }
+  void report();
+
+  size_t getArenaSize() const { return arenaSize; }
+
+private:
+  size_t arenaSize{0}; // Per thread, 0 sends everything to the heap
+
+  std::mutex mutex;
+  std::unordered_map<VkObjectType, std::unique_ptr<HostAllocationTracker>>
+      trackers;
+
+  uint64_t lastAllocationCount{0};
+  uint64_t frameAllocationCount{0};
+  uint64_t frameCount{0};
+  uint64_t reportInterval{0}; // Frames, never when 0
+};
@@ -33,45 +33,53 @@ bool createImage(Image *image, Device *device, const VkExtent2D &extent,
   }
 
   VkImage handle{VK_NULL_HANDLE};
-  if (vkCreateImage(device->handle, &imageCreateInfo, nullptr, &handle) !=
+  auto callbacks = device->getAllocationCallbacks(VK_OBJECT_TYPE_IMAGE);
+  if (vkCreateImage(device->handle, &imageCreateInfo, callbacks, &handle) !=
       VK_SUCCESS) {
     return false;
   }
 
   createImage(image, device, handle, extent, format);
+  image->mipLevels = mipLevels;
+  image->arrayLayers = arrayLayers;
+  image->sampleCount = sampleCount;
+  image->states.assign(mipLevels * arrayLayers, {});
 
-  VkMemoryRequirements memoryRequirements{};
-  vkGetImageMemoryRequirements(device->handle, image->handle,
-                               &memoryRequirements);
-
+  // Transient attachments may never need backing memory on tiled GPUs, other
+  // devices have no lazily allocated memory and use device local memory
+  VkMemoryPropertyFlags preferredProperty{0};
   if (usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) {
-    memoryProperty |= VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+    preferredProperty |= VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
   }
 
-  VkMemoryAllocateInfo memoryAllocateInfo{
-      VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
-  memoryAllocateInfo.allocationSize = memoryRequirements.size;
-  getMemoryTypeIndex(device, memoryRequirements.memoryTypeBits, memoryProperty,
-                     memoryAllocateInfo.memoryTypeIndex);
-
-  VkDeviceMemory memory{VK_NULL_HANDLE};
-  if (vkAllocateMemory(device->handle, &memoryAllocateInfo, nullptr, &memory) !=
-      VK_SUCCESS) {
-    return false;
+  auto category = MemoryCategory::Texture;
+  if (usage & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+               VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)) {
+    category = MemoryCategory::RenderTarget;
   }
 
-  if (vkBindImageMemory(device->handle, handle, memory, 0) != VK_SUCCESS) {
+  if (!device->allocator->allocateImageMemory(
+          handle, tiling == VK_IMAGE_TILING_LINEAR, category, memoryProperty,
+          preferredProperty, image->allocation)) {
+    vkDestroyImage(device->handle, handle, callbacks);
+    image->handle = VK_NULL_HANDLE;
     return false;
   }
 
-  image->memory = memory;
-
   return true;
 }
 
 void destroyImage(Image *image) {
-  if (image->handle && image->memory) {
-    vkFreeMemory(image->device->handle, image->memory, nullptr);
-    vkDestroyImage(image->device->handle, image->handle, nullptr);
+  if (image->handle && image->allocation.memory) {
+    auto device = image->device;
+    vkDestroyImage(device->handle, image->handle,
+                   device->getAllocationCallbacks(VK_OBJECT_TYPE_IMAGE));
+    device->allocator->free(image->allocation);
   }
 }
+
+void resetImageState(Image *image, VkImageLayout layout,
+                     VkPipelineStageFlags2 stages) {
+  image->states.assign(image->states.size(),
+                       {.layout = layout, .writeStages = stages});
+}
@@ -1,16 +1,40 @@
 #pragma once
 
+#include "renderer/memory_allocator.h"
 #include <vector>
 #include <vulkan/vulkan.h>
 
 struct Device;
 
+// How a subresource was used by the commands recorded so far, assuming they
+// are submitted in the order they were recorded in
+struct ImageSubresourceState {
+  VkImageLayout layout{VK_IMAGE_LAYOUT_UNDEFINED};
+  // The last write or layout transition, which any other use waits for
+  VkPipelineStageFlags2 writeStages{VK_PIPELINE_STAGE_2_NONE};
+  VkAccessFlags2 writeAccess{VK_ACCESS_2_NONE};
+  // Reads since then, which the next write waits for
+  VkPipelineStageFlags2 readStages{VK_PIPELINE_STAGE_2_NONE};
+  // Where the last write is visible to reads already
+  VkPipelineStageFlags2 visibleStages{VK_PIPELINE_STAGE_2_NONE};
+  VkAccessFlags2 visibleAccess{VK_ACCESS_2_NONE};
+};
+
 struct Image {
   Device *device{nullptr};
   VkImage handle{VK_NULL_HANDLE};
   VkExtent2D extent{};
   VkFormat format{VK_FORMAT_UNDEFINED};
-  VkDeviceMemory memory{VK_NULL_HANDLE};
+  uint32_t mipLevels{1};
+  uint32_t arrayLayers{1};
+  VkSampleCountFlagBits sampleCount{VK_SAMPLE_COUNT_1_BIT};
+  MemoryAllocation allocation{}; // Empty for swapchain images
+  // By mip level, then array layer. Shared by the views of the image
+  std::vector<ImageSubresourceState> states{1};
+
+  ImageSubresourceState &getState(uint32_t mipLevel, uint32_t arrayLayer) {
+    return states[mipLevel * arrayLayers + arrayLayer];
+  }
 };
 
 bool createImage(Image *image, Device *device, VkImage handle,
@@ -25,3 +49,9 @@ bool createImage(Image *image, Device *device, const VkExtent2D &extent,
                  std::vector<uint32_t> queueFamilyIndices = {});
 
 void destroyImage(Image *image);
+
+// Forget how earlier submissions used the image, such as when it comes back
+// from presentation. Its next use waits for `stages`, where a semaphore wait
+// made it available, and starts from `layout`
+void resetImageState(Image *image, VkImageLayout layout,
+                     VkPipelineStageFlags2 stages);
@@ -22,8 +22,11 @@ bool createImageView(ImageView *imageView, Image *image) {
   imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
   imageViewCreateInfo.subresourceRange.layerCount = 1;
 
-  if (vkCreateImageView(image->device->handle, &imageViewCreateInfo, nullptr,
-                        &imageView->handle) != VK_SUCCESS) {
+  auto device = image->device;
+  if (vkCreateImageView(
+          device->handle, &imageViewCreateInfo,
+          device->getAllocationCallbacks(VK_OBJECT_TYPE_IMAGE_VIEW),
+          &imageView->handle) != VK_SUCCESS) {
     return false;
   }
 
@@ -33,6 +36,7 @@ bool createImageView(ImageView *imageView, Image *image) {
 }
 
 void destroyImageView(ImageView *imageView) {
-  vkDestroyImageView(imageView->image->device->handle, imageView->handle,
-                     nullptr);
+  auto device = imageView->image->device;
+  vkDestroyImageView(device->handle, imageView->handle,
+                     device->getAllocationCallbacks(VK_OBJECT_TYPE_IMAGE_VIEW));
 }
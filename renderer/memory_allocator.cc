@@ -0,0 +1,657 @@
+#include "renderer/memory_allocator.h"
+#include "renderer/device.h"
+#include <algorithm>
+#include <bit>
+#include <iostream>
+
+// Every range starts and ends on this, so alignment padding can be a range
+constexpr VkDeviceSize MIN_ALIGNMENT = 256;
+constexpr uint32_t SECOND_LEVEL_BITS = 4;
+constexpr uint32_t SECOND_LEVEL_COUNT = 1 << SECOND_LEVEL_BITS;
+constexpr uint32_t FIRST_LEVEL_COUNT = 64;
+constexpr uint32_t NO_RANGE = UINT32_MAX;
+
+VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+// The free list of ranges of `size`, the first level is its power of two and
+// the second level splits that linearly
+void mapSize(VkDeviceSize size, uint32_t &firstLevel, uint32_t &secondLevel) {
+  firstLevel = std::bit_width(size) - 1;
+  secondLevel = (size >> (firstLevel - SECOND_LEVEL_BITS)) &
+                (SECOND_LEVEL_COUNT - 1);
+}
+
+// One device memory allocation, split into ranges that are each either in use
+// or in the free list of their size. Adjacent free ranges are always merged
+struct MemoryBlock {
+public:
+  struct Range {
+    VkDeviceSize offset{0};
+    VkDeviceSize size{0};
+    uint32_t previous{NO_RANGE}; // Neighbours in memory
+    uint32_t next{NO_RANGE};
+    uint32_t previousFree{NO_RANGE};
+    uint32_t nextFree{NO_RANGE};
+    bool free{false};
+  };
+
+  MemoryBlock(VkDeviceMemory memory, void *mapped, VkDeviceSize size,
+              uint32_t poolIndex)
+      : memory{memory}, mapped{mapped}, size{size}, poolIndex{poolIndex} {
+    std::fill_n(&freeLists[0][0], FIRST_LEVEL_COUNT * SECOND_LEVEL_COUNT,
+                NO_RANGE);
+    auto range = addRange();
+    ranges[range].size = size;
+    insertFree(range);
+  }
+
+  bool allocate(VkDeviceSize allocationSize, VkDeviceSize alignment,
+                uint32_t &range, VkDeviceSize &offset);
+  void free(uint32_t range);
+
+  bool empty() const { return allocationCount == 0; }
+
+  void addStats(MemoryStats &stats) const;
+
+  VkDeviceMemory memory{VK_NULL_HANDLE};
+  void *mapped{nullptr};
+  VkDeviceSize size{0};
+  uint32_t poolIndex{0};
+
+private:
+  uint32_t addRange();
+  void removeRange(uint32_t range);
+  uint32_t findFree(VkDeviceSize minSize) const;
+  void insertFree(uint32_t range);
+  void removeFree(uint32_t range);
+
+  std::vector<Range> ranges;
+  std::vector<uint32_t> unusedRanges;
+  uint64_t firstLevelBits{0};
+  uint32_t secondLevelBits[FIRST_LEVEL_COUNT]{};
+  uint32_t freeLists[FIRST_LEVEL_COUNT][SECOND_LEVEL_COUNT];
+  size_t allocationCount{0};
+  size_t freeRangeCount{0};
+  VkDeviceSize usedBytes{0};
+};
+
+uint32_t MemoryBlock::addRange() {
+  if (unusedRanges.empty()) {
+    ranges.emplace_back();
+    return ranges.size() - 1;
+  }
+  auto range = unusedRanges.back();
+  unusedRanges.pop_back();
+  ranges[range] = {};
+  return range;
+}
+
+void MemoryBlock::removeRange(uint32_t range) {
+  auto &r = ranges[range];
+  if (r.previous != NO_RANGE) { ranges[r.previous].next = r.next; }
+  if (r.next != NO_RANGE) { ranges[r.next].previous = r.previous; }
+  unusedRanges.push_back(range);
+}
+
+// A free range of at least `minSize`, rounded up to the next list so that any
+// range of the list found fits
+uint32_t MemoryBlock::findFree(VkDeviceSize minSize) const {
+  uint32_t firstLevel{0}, secondLevel{0};
+  mapSize(minSize, firstLevel, secondLevel);
+  minSize += (VkDeviceSize{1} << (firstLevel - SECOND_LEVEL_BITS)) - 1;
+  mapSize(minSize, firstLevel, secondLevel);
+  if (firstLevel >= FIRST_LEVEL_COUNT) { return NO_RANGE; }
+
+  auto secondLevelMap = secondLevelBits[firstLevel] & (~0U << secondLevel);
+  if (!secondLevelMap) {
+    auto firstLevelMap = firstLevel + 1 < FIRST_LEVEL_COUNT
+                             ? firstLevelBits & (~0ULL << (firstLevel + 1))
+                             : 0;
+    if (!firstLevelMap) { return NO_RANGE; }
+    firstLevel = std::countr_zero(firstLevelMap);
+    secondLevelMap = secondLevelBits[firstLevel];
+  }
+  return freeLists[firstLevel][std::countr_zero(secondLevelMap)];
+}
+
+void MemoryBlock::insertFree(uint32_t range) {
+  uint32_t firstLevel{0}, secondLevel{0};
+  mapSize(ranges[range].size, firstLevel, secondLevel);
+
+  auto &r = ranges[range];
+  auto &head = freeLists[firstLevel][secondLevel];
+  r.free = true;
+  r.previousFree = NO_RANGE;
+  r.nextFree = head;
+  if (head != NO_RANGE) { ranges[head].previousFree = range; }
+  head = range;
+  secondLevelBits[firstLevel] |= 1U << secondLevel;
+  firstLevelBits |= 1ULL << firstLevel;
+  ++freeRangeCount;
+}
+
+void MemoryBlock::removeFree(uint32_t range) {
+  uint32_t firstLevel{0}, secondLevel{0};
+  mapSize(ranges[range].size, firstLevel, secondLevel);
+
+  auto &r = ranges[range];
+  if (r.previousFree != NO_RANGE) {
+    ranges[r.previousFree].nextFree = r.nextFree;
+  } else {
+    freeLists[firstLevel][secondLevel] = r.nextFree;
+    if (r.nextFree == NO_RANGE) {
+      secondLevelBits[firstLevel] &= ~(1U << secondLevel);
+      if (!secondLevelBits[firstLevel]) {
+        firstLevelBits &= ~(1ULL << firstLevel);
+      }
+    }
+  }
+  if (r.nextFree != NO_RANGE) {
+    ranges[r.nextFree].previousFree = r.previousFree;
+  }
+  r.free = false;
+  --freeRangeCount;
+}
+
+bool MemoryBlock::allocate(VkDeviceSize allocationSize, VkDeviceSize alignment,
+                           uint32_t &range, VkDeviceSize &offset) {
+  allocationSize = alignUp(allocationSize, MIN_ALIGNMENT);
+  alignment = std::max(alignment, MIN_ALIGNMENT);
+
+  // Leave room to align the start of any range found
+  auto found = findFree(allocationSize + alignment - MIN_ALIGNMENT);
+  if (found == NO_RANGE) { return false; }
+  removeFree(found);
+
+  // The neighbours of a free range are in use, the padding before and the
+  // remainder after become free ranges of their own
+  auto alignedOffset = alignUp(ranges[found].offset, alignment);
+  if (auto padding = alignedOffset - ranges[found].offset) {
+    auto before = addRange();
+    auto &r = ranges[found];
+    ranges[before].offset = r.offset;
+    ranges[before].size = padding;
+    ranges[before].previous = r.previous;
+    ranges[before].next = found;
+    if (r.previous != NO_RANGE) { ranges[r.previous].next = before; }
+    r.previous = before;
+    r.offset = alignedOffset;
+    r.size -= padding;
+    insertFree(before);
+  }
+  if (ranges[found].size > allocationSize) {
+    auto after = addRange();
+    auto &r = ranges[found];
+    ranges[after].offset = r.offset + allocationSize;
+    ranges[after].size = r.size - allocationSize;
+    ranges[after].previous = found;
+    ranges[after].next = r.next;
+    if (r.next != NO_RANGE) { ranges[r.next].previous = after; }
+    r.next = after;
+    r.size = allocationSize;
+    insertFree(after);
+  }
+
+  range = found;
+  offset = ranges[found].offset;
+  usedBytes += allocationSize;
+  ++allocationCount;
+  return true;
+}
+
+void MemoryBlock::free(uint32_t range) {
+  usedBytes -= ranges[range].size;
+  --allocationCount;
+
+  auto next = ranges[range].next;
+  if (next != NO_RANGE && ranges[next].free) {
+    removeFree(next);
+    ranges[range].size += ranges[next].size;
+    removeRange(next);
+  }
+  auto previous = ranges[range].previous;
+  if (previous != NO_RANGE && ranges[previous].free) {
+    removeFree(previous);
+    ranges[previous].size += ranges[range].size;
+    removeRange(range);
+    range = previous;
+  }
+  insertFree(range);
+}
+
+void MemoryBlock::addStats(MemoryStats &stats) const {
+  ++stats.blockCount;
+  stats.allocationCount += allocationCount;
+  stats.reservedBytes += size;
+  stats.usedBytes += usedBytes;
+  stats.freeBytes += size - usedBytes;
+  stats.freeRangeCount += freeRangeCount;
+  if (!firstLevelBits) { return; }
+
+  // The largest free range is in the highest list
+  auto firstLevel = std::bit_width(firstLevelBits) - 1;
+  auto secondLevel = std::bit_width(secondLevelBits[firstLevel]) - 1;
+  VkDeviceSize largestFreeRange{0};
+  for (auto range = freeLists[firstLevel][secondLevel]; range != NO_RANGE;
+       range = ranges[range].nextFree) {
+    largestFreeRange = std::max(largestFreeRange, ranges[range].size);
+  }
+  stats.largestFreeBytes += largestFreeRange;
+}
+
+const char *getMemoryCategoryName(MemoryCategory category) {
+  switch (category) {
+  case MemoryCategory::RenderTarget:
+    return "render target";
+  case MemoryCategory::Texture:
+    return "texture";
+  case MemoryCategory::Geometry:
+    return "geometry";
+  case MemoryCategory::Uniform:
+    return "uniform";
+  case MemoryCategory::Staging:
+    return "staging";
+  default:
+    return "other";
+  }
+}
+
+float MemoryStats::getFragmentation() const {
+  if (freeBytes == 0) { return 0.0f; }
+  return 1.0f - static_cast<float>(largestFreeBytes) /
+                    static_cast<float>(freeBytes);
+}
+
+float MemoryStats::getUtilization() const {
+  if (reservedBytes == 0) { return 1.0f; }
+  return static_cast<float>(usedBytes) / static_cast<float>(reservedBytes);
+}
+
+std::unique_ptr<MemoryAllocator> MemoryAllocator::make(Device &device,
+                                                       VkDeviceSize blockSize) {
+  VkPhysicalDeviceProperties properties{};
+  vkGetPhysicalDeviceProperties(device.physicalDevice, &properties);
+
+  auto memoryAllocator = std::make_unique<MemoryAllocator>();
+  memoryAllocator->device = &device;
+  memoryAllocator->callbacks =
+      device.getAllocationCallbacks(VK_OBJECT_TYPE_DEVICE_MEMORY);
+  vkGetPhysicalDeviceMemoryProperties(device.physicalDevice,
+                                      &memoryAllocator->memoryProperties);
+  memoryAllocator->bufferImageGranularity =
+      properties.limits.bufferImageGranularity;
+  memoryAllocator->blockSize = alignUp(blockSize, MIN_ALIGNMENT);
+
+  memoryAllocator->pools.resize(
+      memoryAllocator->memoryProperties.memoryTypeCount * 2);
+
+  const auto &memoryProperties = memoryAllocator->memoryProperties;
+  memoryAllocator->budgets.resize(memoryProperties.memoryHeapCount);
+  for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; ++i) {
+    auto &budget = memoryAllocator->budgets[i];
+    budget.size = memoryProperties.memoryHeaps[i].size;
+    budget.budget = budget.size / 10 * 8;
+  }
+  return std::move(memoryAllocator);
+}
+
+MemoryAllocator::~MemoryAllocator() {
+  auto stats = getStats();
+  if (stats.allocationCount > 0) {
+    std::cout << "[MemoryAllocator] " << stats.allocationCount
+              << " allocations still in use" << std::endl;
+  }
+  for (auto &pool : pools) {
+    for (auto &block : pool) {
+      vkFreeMemory(device->handle, block->memory, callbacks);
+    }
+  }
+}
+
+bool MemoryAllocator::getMemoryTypeIndex(const MemoryRequest &request,
+                                         uint32_t &typeIndex) {
+  auto typeBits = request.requirements.memoryTypeBits;
+  if (::getMemoryTypeIndex(device, typeBits,
+                           request.requiredProperties |
+                               request.preferredProperties,
+                           typeIndex)) {
+    return true;
+  }
+  return ::getMemoryTypeIndex(device, typeBits, request.requiredProperties,
+                              typeIndex);
+}
+
+bool MemoryAllocator::allocateMemory(const VkMemoryAllocateInfo &allocateInfo,
+                                     VkDeviceMemory &memory, void **mapped) {
+  if (vkAllocateMemory(device->handle, &allocateInfo, callbacks, &memory) !=
+      VK_SUCCESS) {
+    return false;
+  }
+
+  auto propertyFlags =
+      memoryProperties.memoryTypes[allocateInfo.memoryTypeIndex].propertyFlags;
+  *mapped = nullptr;
+  if ((propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) &&
+      vkMapMemory(device->handle, memory, 0, VK_WHOLE_SIZE, 0, mapped) !=
+          VK_SUCCESS) {
+    vkFreeMemory(device->handle, memory, callbacks);
+    return false;
+  }
+  return true;
+}
+
+// Must be called with the mutex held
+void MemoryAllocator::updateUsage(const MemoryAllocation &allocation,
+                                  bool allocated) {
+  auto &category = categories[static_cast<size_t>(allocation.category)];
+  if (allocated) {
+    ++category.allocationCount;
+    category.bytes += allocation.size;
+  } else {
+    --category.allocationCount;
+    category.bytes -= allocation.size;
+  }
+}
+
+// Small heaps, such as host visible device memory, are not filled by a few
+// blocks
+VkDeviceSize MemoryAllocator::getBlockSize(uint32_t typeIndex) const {
+  auto heapIndex = memoryProperties.memoryTypes[typeIndex].heapIndex;
+  auto heapSize = memoryProperties.memoryHeaps[heapIndex].size;
+  return std::min(blockSize, alignUp(heapSize / 8, MIN_ALIGNMENT));
+}
+
+// Must be called with the mutex held
+std::unique_ptr<MemoryBlock>
+MemoryAllocator::allocateBlock(uint32_t typeIndex, uint32_t poolIndex) {
+  VkMemoryAllocateInfo allocateInfo{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+  allocateInfo.allocationSize = getBlockSize(typeIndex);
+  allocateInfo.memoryTypeIndex = typeIndex;
+
+  VkDeviceMemory memory{VK_NULL_HANDLE};
+  void *mapped{nullptr};
+  if (!allocateMemory(allocateInfo, memory, &mapped)) { return nullptr; }
+  auto heapIndex = memoryProperties.memoryTypes[typeIndex].heapIndex;
+  budgets[heapIndex].reservedBytes += allocateInfo.allocationSize;
+  return std::make_unique<MemoryBlock>(memory, mapped,
+                                       allocateInfo.allocationSize, poolIndex);
+}
+
+bool MemoryAllocator::allocateDedicated(const MemoryRequest &request,
+                                        uint32_t typeIndex,
+                                        MemoryAllocation &allocation) {
+  VkMemoryDedicatedAllocateInfo dedicatedInfo{
+      VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO};
+  dedicatedInfo.image = request.dedicatedImage;
+  dedicatedInfo.buffer = request.dedicatedBuffer;
+
+  VkMemoryAllocateInfo allocateInfo{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+  allocateInfo.allocationSize = request.requirements.size;
+  allocateInfo.memoryTypeIndex = typeIndex;
+  if (dedicatedInfo.image || dedicatedInfo.buffer) {
+    allocateInfo.pNext = &dedicatedInfo;
+  }
+
+  VkDeviceMemory memory{VK_NULL_HANDLE};
+  void *mapped{nullptr};
+  if (!allocateMemory(allocateInfo, memory, &mapped)) { return false; }
+
+  allocation = {};
+  allocation.memory = memory;
+  allocation.size = request.requirements.size;
+  allocation.mapped = mapped;
+  allocation.memoryTypeIndex = typeIndex;
+  allocation.category = request.category;
+
+  std::lock_guard<std::mutex> guard(mutex);
+  ++dedicatedCount;
+  dedicatedBytes += allocation.size;
+  auto heapIndex = memoryProperties.memoryTypes[typeIndex].heapIndex;
+  budgets[heapIndex].reservedBytes += allocation.size;
+  updateUsage(allocation, true);
+  return true;
+}
+
+bool MemoryAllocator::allocate(const MemoryRequest &request,
+                               MemoryAllocation &allocation) {
+  uint32_t typeIndex{0};
+  if (!getMemoryTypeIndex(request, typeIndex)) {
+    std::cout << "[MemoryAllocator] No memory type for properties "
+              << request.requiredProperties << std::endl;
+    return false;
+  }
+
+  if (request.dedicated ||
+      request.requirements.size > getBlockSize(typeIndex) / 2) {
+    return allocateDedicated(request, typeIndex, allocation);
+  }
+
+  uint32_t poolIndex = typeIndex * 2;
+  if (request.linear && bufferImageGranularity > 1) { ++poolIndex; }
+
+  std::lock_guard<std::mutex> guard(mutex);
+  auto &blocks = pools[poolIndex];
+  const auto &requirements = request.requirements;
+  auto allocateFrom = [&](MemoryBlock *block) {
+    if (!block->allocate(requirements.size, requirements.alignment,
+                         allocation.range, allocation.offset)) {
+      return false;
+    }
+    allocation.memory = block->memory;
+    allocation.size = requirements.size;
+    allocation.mapped =
+        block->mapped ? static_cast<char *>(block->mapped) + allocation.offset
+                      : nullptr;
+    allocation.block = block;
+    allocation.memoryTypeIndex = typeIndex;
+    allocation.category = request.category;
+    updateUsage(allocation, true);
+    return true;
+  };
+  for (auto &block : blocks) {
+    if (allocateFrom(block.get())) { return true; }
+  }
+
+  auto block = allocateBlock(typeIndex, poolIndex);
+  if (!block) {
+    std::cout << "[MemoryAllocator] Failed to allocate a block of memory type "
+              << typeIndex << std::endl;
+    return false;
+  }
+  // A new block fits any request smaller than half of it, unless its
+  // alignment doesn't. The block is kept for later requests either way
+  auto blockPointer = block.get();
+  blocks.emplace_back(std::move(block));
+  if (!allocateFrom(blockPointer)) {
+    std::cout << "[MemoryAllocator] Failed to allocate " << requirements.size
+              << " bytes aligned to " << requirements.alignment
+              << " from a new block of memory type " << typeIndex
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool MemoryAllocator::allocateImageMemory(
+    VkImage image, bool linear, MemoryCategory category,
+    VkMemoryPropertyFlags requiredProperties,
+    VkMemoryPropertyFlags preferredProperties, MemoryAllocation &allocation) {
+  VkImageMemoryRequirementsInfo2 requirementsInfo{
+      VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2};
+  requirementsInfo.image = image;
+  VkMemoryDedicatedRequirements dedicatedRequirements{
+      VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS};
+  VkMemoryRequirements2 requirements{VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2};
+  requirements.pNext = &dedicatedRequirements;
+  vkGetImageMemoryRequirements2(device->handle, &requirementsInfo,
+                                &requirements);
+
+  MemoryRequest request{};
+  request.requirements = requirements.memoryRequirements;
+  request.requiredProperties = requiredProperties;
+  request.preferredProperties = preferredProperties;
+  request.category = category;
+  request.linear = linear;
+  request.dedicated = dedicatedRequirements.requiresDedicatedAllocation ||
+                      dedicatedRequirements.prefersDedicatedAllocation;
+  request.dedicatedImage = image;
+
+  if (!allocate(request, allocation)) { return false; }
+  if (vkBindImageMemory(device->handle, image, allocation.memory,
+                        allocation.offset) != VK_SUCCESS) {
+    free(allocation);
+    return false;
+  }
+  return true;
+}
+
+bool MemoryAllocator::allocateBufferMemory(
+    VkBuffer buffer, MemoryCategory category,
+    VkMemoryPropertyFlags requiredProperties,
+    VkMemoryPropertyFlags preferredProperties, MemoryAllocation &allocation) {
+  VkBufferMemoryRequirementsInfo2 requirementsInfo{
+      VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2};
+  requirementsInfo.buffer = buffer;
+  VkMemoryDedicatedRequirements dedicatedRequirements{
+      VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS};
+  VkMemoryRequirements2 requirements{VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2};
+  requirements.pNext = &dedicatedRequirements;
+  vkGetBufferMemoryRequirements2(device->handle, &requirementsInfo,
+                                 &requirements);
+
+  MemoryRequest request{};
+  request.requirements = requirements.memoryRequirements;
+  request.requiredProperties = requiredProperties;
+  request.preferredProperties = preferredProperties;
+  request.category = category;
+  request.linear = true;
+  request.dedicated = dedicatedRequirements.requiresDedicatedAllocation ||
+                      dedicatedRequirements.prefersDedicatedAllocation;
+  request.dedicatedBuffer = buffer;
+
+  if (!allocate(request, allocation)) { return false; }
+  if (vkBindBufferMemory(device->handle, buffer, allocation.memory,
+                         allocation.offset) != VK_SUCCESS) {
+    free(allocation);
+    return false;
+  }
+  return true;
+}
+
+void MemoryAllocator::free(MemoryAllocation &allocation) {
+  if (!allocation.memory) { return; }
+
+  if (!allocation.block) {
+    vkFreeMemory(device->handle, allocation.memory, callbacks);
+    std::lock_guard<std::mutex> guard(mutex);
+    --dedicatedCount;
+    dedicatedBytes -= allocation.size;
+    auto heapIndex =
+        memoryProperties.memoryTypes[allocation.memoryTypeIndex].heapIndex;
+    budgets[heapIndex].reservedBytes -= allocation.size;
+    updateUsage(allocation, false);
+    allocation = {};
+    return;
+  }
+
+  std::lock_guard<std::mutex> guard(mutex);
+  auto block = allocation.block;
+  block->free(allocation.range);
+  updateUsage(allocation, false);
+  allocation = {};
+
+  // Keep one empty block per pool so that a resource recreated every frame
+  // does not allocate a block each time
+  if (!block->empty()) { return; }
+  auto &blocks = pools[block->poolIndex];
+  auto emptyCount = std::count_if(blocks.begin(), blocks.end(),
+                                  [](auto &b) { return b->empty(); });
+  if (emptyCount < 2) { return; }
+  vkFreeMemory(device->handle, block->memory, callbacks);
+  auto typeIndex = block->poolIndex / 2;
+  auto heapIndex = memoryProperties.memoryTypes[typeIndex].heapIndex;
+  budgets[heapIndex].reservedBytes -= block->size;
+  std::erase_if(blocks, [&](auto &b) { return b.get() == block; });
+}
+
+MemoryStats MemoryAllocator::getStats() {
+  std::lock_guard<std::mutex> guard(mutex);
+  MemoryStats stats{};
+  for (const auto &pool : pools) {
+    for (const auto &block : pool) { block->addStats(stats); }
+  }
+  stats.dedicatedCount = dedicatedCount;
+  stats.allocationCount += dedicatedCount;
+  stats.reservedBytes += dedicatedBytes;
+  stats.usedBytes += dedicatedBytes;
+  stats.categories = categories;
+  return stats;
+}
+
+void MemoryAllocator::update() {
+  VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT};
+  VkPhysicalDeviceMemoryProperties2 properties{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2};
+  if (device->features.memoryBudget) {
+    properties.pNext = &budgetProperties;
+    vkGetPhysicalDeviceMemoryProperties2(device->physicalDevice, &properties);
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    for (uint32_t i = 0; i < budgets.size(); ++i) {
+      auto &budget = budgets[i];
+      auto overBudget = budget.usage > budget.budget;
+      if (device->features.memoryBudget) {
+        budget.budget = budgetProperties.heapBudget[i];
+        budget.usage = budgetProperties.heapUsage[i];
+      } else {
+        budget.usage = budget.reservedBytes;
+      }
+      if (!overBudget && budget.usage > budget.budget) {
+        std::cout << "[MemoryAllocator] Heap " << i << " over budget, "
+                  << budget.usage / (1024 * 1024) << " of "
+                  << budget.budget / (1024 * 1024) << " MiB" << std::endl;
+      }
+    }
+  }
+
+  ++frameCount;
+  if (reportInterval > 0 && frameCount % reportInterval == 0) { report(); }
+}
+
+std::vector<MemoryHeapBudget> MemoryAllocator::getBudgets() {
+  std::lock_guard<std::mutex> guard(mutex);
+  return budgets;
+}
+
+void MemoryAllocator::report() {
+  constexpr VkDeviceSize MiB = 1024 * 1024;
+  auto stats = getStats();
+  std::cout << "[MemoryAllocator] " << stats.allocationCount
+            << " allocations in " << stats.blockCount << " blocks and "
+            << stats.dedicatedCount << " dedicated, "
+            << stats.reservedBytes / MiB << " MiB reserved, "
+            << stats.getUtilization() * 100.0f << "% used, "
+            << stats.getFragmentation() * 100.0f << "% fragmented"
+            << std::endl;
+  for (size_t i = 0; i < stats.categories.size(); ++i) {
+    const auto &category = stats.categories[i];
+    if (category.allocationCount == 0) { continue; }
+    std::cout << "[MemoryAllocator]   "
+              << getMemoryCategoryName(static_cast<MemoryCategory>(i)) << " "
+              << category.allocationCount << " allocations, "
+              << category.bytes / MiB << " MiB" << std::endl;
+  }
+  auto heapBudgets = getBudgets();
+  for (size_t i = 0; i < heapBudgets.size(); ++i) {
+    const auto &budget = heapBudgets[i];
+    std::cout << "[MemoryAllocator]   heap " << i << " "
+              << budget.usage / MiB << " of " << budget.budget / MiB
+              << " MiB budget, " << budget.reservedBytes / MiB
+              << " MiB reserved" << std::endl;
+  }
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+struct Device;
+struct MemoryBlock;
+
+// What an allocation is for, to see where the memory goes
+enum class MemoryCategory {
+  Other,
+  RenderTarget,
+  Texture,
+  Geometry,
+  Uniform,
+  Staging,
+  Count,
+};
+
+const char *getMemoryCategoryName(MemoryCategory category);
+
+// A range of device memory, part of a block or a dedicated allocation
+struct MemoryAllocation {
+  VkDeviceMemory memory{VK_NULL_HANDLE};
+  VkDeviceSize offset{0};
+  VkDeviceSize size{0};
+  void *mapped{nullptr};       // Host visible memory stays mapped
+  MemoryBlock *block{nullptr}; // Null for dedicated allocations
+  uint32_t range{0};
+  uint32_t memoryTypeIndex{0};
+  MemoryCategory category{MemoryCategory::Other};
+};
+
+struct MemoryRequest {
+  VkMemoryRequirements requirements{};
+  VkMemoryPropertyFlags requiredProperties{0};
+  VkMemoryPropertyFlags preferredProperties{0};
+  MemoryCategory category{MemoryCategory::Other};
+  bool linear{false}; // Buffers and linear images
+  // Set when the driver requires or prefers memory of its own for a resource
+  bool dedicated{false};
+  VkImage dedicatedImage{VK_NULL_HANDLE};
+  VkBuffer dedicatedBuffer{VK_NULL_HANDLE};
+};
+
+struct MemoryCategoryStats {
+  size_t allocationCount{0};
+  VkDeviceSize bytes{0};
+};
+
+struct MemoryStats {
+  size_t blockCount{0};
+  size_t dedicatedCount{0};
+  size_t allocationCount{0};   // Sub-allocations and dedicated allocations
+  VkDeviceSize reservedBytes{0}; // Allocated from the device
+  VkDeviceSize usedBytes{0};
+  VkDeviceSize freeBytes{0}; // Unused in blocks
+  size_t freeRangeCount{0};
+  VkDeviceSize largestFreeBytes{0}; // Summed over the blocks
+  std::array<MemoryCategoryStats, static_cast<size_t>(MemoryCategory::Count)>
+      categories{};
+
+  // 0 while the free memory of each block is one range, towards 1 as it is
+  // split into many small ones
+  float getFragmentation() const;
+  // Share of the reserved memory in use
+  float getUtilization() const;
+};
+
+struct MemoryHeapBudget {
+  VkDeviceSize size{0};
+  // What the process can use before the driver may start paging, and what it
+  // uses, including allocations not made by the allocator. Without
+  // VK_EXT_memory_budget these are estimated from the heap size and the
+  // reserved bytes
+  VkDeviceSize budget{0};
+  VkDeviceSize usage{0};
+  VkDeviceSize reservedBytes{0}; // Blocks and dedicated allocations
+};
+
+// Sub-allocates device memory from large blocks per memory type, using a
+// two level segregated fit of the free ranges of each block. Resources the
+// driver wants dedicated memory for, or that take a large part of a block,
+// get allocations of their own
+struct MemoryAllocator {
+public:
+  static std::unique_ptr<MemoryAllocator>
+  make(Device &device, VkDeviceSize blockSize = 64 * 1024 * 1024);
+
+  ~MemoryAllocator();
+
+  bool allocate(const MemoryRequest &request, MemoryAllocation &allocation);
+
+  // Allocate and bind memory for the image
+  bool allocateImageMemory(VkImage image, bool linear,
+                           MemoryCategory category,
+                           VkMemoryPropertyFlags requiredProperties,
+                           VkMemoryPropertyFlags preferredProperties,
+                           MemoryAllocation &allocation);
+
+  // Allocate and bind memory for the buffer
+  bool allocateBufferMemory(VkBuffer buffer, MemoryCategory category,
+                            VkMemoryPropertyFlags requiredProperties,
+                            VkMemoryPropertyFlags preferredProperties,
+                            MemoryAllocation &allocation);
+
+  void free(MemoryAllocation &allocation);
+
+  MemoryStats getStats();
+
+  // Call once per frame to query the heap budgets, which are logged when the
+  // usage of a heap goes over its budget, and to report the stats every
+  // report interval
+  void update();
+
+  std::vector<MemoryHeapBudget> getBudgets();
+
+  void setReportInterval(uint64_t frames) { reportInterval = frames; }
+  void report();
+
+private:
+  using MemoryPool = std::vector<std::unique_ptr<MemoryBlock>>;
+
+  bool getMemoryTypeIndex(const MemoryRequest &request, uint32_t &typeIndex);
+  bool allocateDedicated(const MemoryRequest &request, uint32_t typeIndex,
+                         MemoryAllocation &allocation);
+  VkDeviceSize getBlockSize(uint32_t typeIndex) const;
+  std::unique_ptr<MemoryBlock> allocateBlock(uint32_t typeIndex,
+                                             uint32_t poolIndex);
+  bool allocateMemory(const VkMemoryAllocateInfo &allocateInfo,
+                      VkDeviceMemory &memory, void **mapped);
+  void updateUsage(const MemoryAllocation &allocation, bool allocated);
+
+  Device *device{nullptr};
+  const VkAllocationCallbacks *callbacks{nullptr};
+  VkPhysicalDeviceMemoryProperties memoryProperties{};
+  VkDeviceSize bufferImageGranularity{1};
+  VkDeviceSize blockSize{0};
+
+  std::mutex mutex;
+  // Two per memory type, linear resources are kept apart from optimal tiling
+  // images when the device needs them a granularity page apart
+  std::vector<MemoryPool> pools;
+  size_t dedicatedCount{0};
+  VkDeviceSize dedicatedBytes{0};
+  std::array<MemoryCategoryStats, static_cast<size_t>(MemoryCategory::Count)>
+      categories{};
+  std::vector<MemoryHeapBudget> budgets; // One per heap
+
+  uint64_t frameCount{0};
+  uint64_t reportInterval{0}; // Frames, never when 0
+};
@@ -0,0 +1,158 @@
+#include "renderer/pipeline.h"
+#include "renderer/device.h"
+#include "renderer/pipeline_layout.h"
+#include "renderer/render_pass.h"
+#include "renderer/shader_module.h"
+
+std::unique_ptr<GraphicsPipeline>
+GraphicsPipeline::make(Device &device, VkPipelineCache pipelineCache,
+                       const PipelineState &pipelineState) {
+  auto pipelineLayout = pipelineState.pipelineLayout;
+  auto renderPass = pipelineState.renderPass;
+  if (!pipelineLayout || !renderPass) { return nullptr; }
+
+  // Vulkan shader modules are only needed while creating the pipeline
+  std::vector<VkShaderModule> handles;
+  std::vector<VkPipelineShaderStageCreateInfo> stages;
+  auto shaderModuleCallbacks =
+      device.getAllocationCallbacks(VK_OBJECT_TYPE_SHADER_MODULE);
+  auto destroyShaderModules = [&]() {
+    for (auto handle : handles) {
+      vkDestroyShaderModule(device.handle, handle, shaderModuleCallbacks);
+    }
+  };
+  for (auto shaderModule : pipelineState.shaderModules) {
+    if (!shaderModule) {
+      destroyShaderModules();
+      return nullptr;
+    }
+    const auto &spirv = shaderModule->getSpirv();
+    VkShaderModuleCreateInfo shaderModuleCreateInfo{
+        VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO};
+    shaderModuleCreateInfo.codeSize = spirv.size() * sizeof(uint32_t);
+    shaderModuleCreateInfo.pCode = spirv.data();
+
+    VkShaderModule handle{VK_NULL_HANDLE};
+    if (vkCreateShaderModule(device.handle, &shaderModuleCreateInfo,
+                             shaderModuleCallbacks, &handle) != VK_SUCCESS) {
+      destroyShaderModules();
+      return nullptr;
+    }
+    handles.push_back(handle);
+
+    VkPipelineShaderStageCreateInfo stage{
+        VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
+    stage.stage = shaderModule->getStage();
+    stage.module = handle;
+    stage.pName = shaderModule->getEntry().c_str();
+    stages.push_back(stage);
+  }
+
+  const auto &vertexInput = pipelineState.vertexInput;
+  VkPipelineVertexInputStateCreateInfo vertexInputState{
+      VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO};
+  vertexInputState.vertexBindingDescriptionCount = vertexInput.bindings.size();
+  vertexInputState.pVertexBindingDescriptions = vertexInput.bindings.data();
+  vertexInputState.vertexAttributeDescriptionCount =
+      vertexInput.attributes.size();
+  vertexInputState.pVertexAttributeDescriptions = vertexInput.attributes.data();
+
+  VkPipelineInputAssemblyStateCreateInfo inputAssemblyState{
+      VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO};
+  inputAssemblyState.topology = pipelineState.inputAssembly.topology;
+  inputAssemblyState.primitiveRestartEnable =
+      pipelineState.inputAssembly.primitiveRestartEnable;
+
+  VkPipelineViewportStateCreateInfo viewportState{
+      VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO};
+  viewportState.viewportCount = 1;
+  viewportState.scissorCount = 1;
+
+  const auto &rasterization = pipelineState.rasterization;
+  VkPipelineRasterizationStateCreateInfo rasterizationState{
+      VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO};
+  rasterizationState.polygonMode = rasterization.polygonMode;
+  rasterizationState.cullMode = rasterization.cullMode;
+  rasterizationState.frontFace = rasterization.frontFace;
+  rasterizationState.depthBiasEnable = rasterization.depthBiasEnable;
+  rasterizationState.lineWidth = 1.0f;
+
+  VkPipelineMultisampleStateCreateInfo multisampleState{
+      VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO};
+  multisampleState.rasterizationSamples =
+      pipelineState.multisample.rasterizationSamples;
+
+  const auto &depthStencil = pipelineState.depthStencil;
+  VkPipelineDepthStencilStateCreateInfo depthStencilState{
+      VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO};
+  depthStencilState.depthTestEnable = depthStencil.depthTestEnable;
+  depthStencilState.depthWriteEnable = depthStencil.depthWriteEnable;
+  depthStencilState.depthCompareOp = depthStencil.depthCompareOp;
+  depthStencilState.stencilTestEnable = depthStencil.stencilTestEnable;
+
+  auto blendAttachments = pipelineState.colorBlend.attachments;
+  if (blendAttachments.empty()) {
+    blendAttachments.resize(
+        renderPass->getColorAttachmentCount(pipelineState.subpassIndex));
+  }
+  std::vector<VkPipelineColorBlendAttachmentState> attachments;
+  for (const auto &blend : blendAttachments) {
+    VkPipelineColorBlendAttachmentState attachment{};
+    attachment.blendEnable = blend.blendEnable;
+    attachment.srcColorBlendFactor = blend.srcColorBlendFactor;
+    attachment.dstColorBlendFactor = blend.dstColorBlendFactor;
+    attachment.colorBlendOp = blend.colorBlendOp;
+    attachment.srcAlphaBlendFactor = blend.srcAlphaBlendFactor;
+    attachment.dstAlphaBlendFactor = blend.dstAlphaBlendFactor;
+    attachment.alphaBlendOp = blend.alphaBlendOp;
+    attachment.colorWriteMask = blend.colorWriteMask;
+    attachments.push_back(attachment);
+  }
+  VkPipelineColorBlendStateCreateInfo colorBlendState{
+      VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO};
+  colorBlendState.attachmentCount = attachments.size();
+  colorBlendState.pAttachments = attachments.data();
+
+  std::vector<VkDynamicState> dynamicStates{
+      VK_DYNAMIC_STATE_VIEWPORT,
+      VK_DYNAMIC_STATE_SCISSOR,
+  };
+  VkPipelineDynamicStateCreateInfo dynamicState{
+      VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO};
+  dynamicState.dynamicStateCount = dynamicStates.size();
+  dynamicState.pDynamicStates = dynamicStates.data();
+
+  VkGraphicsPipelineCreateInfo createInfo{
+      VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO};
+  createInfo.stageCount = stages.size();
+  createInfo.pStages = stages.data();
+  createInfo.pVertexInputState = &vertexInputState;
+  createInfo.pInputAssemblyState = &inputAssemblyState;
+  createInfo.pViewportState = &viewportState;
+  createInfo.pRasterizationState = &rasterizationState;
+  createInfo.pMultisampleState = &multisampleState;
+  createInfo.pDepthStencilState = &depthStencilState;
+  createInfo.pColorBlendState = &colorBlendState;
+  createInfo.pDynamicState = &dynamicState;
+  createInfo.layout = pipelineLayout->handle;
+  createInfo.renderPass = renderPass->handle;
+  createInfo.subpass = pipelineState.subpassIndex;
+
+  VkPipeline handle{VK_NULL_HANDLE};
+  auto result = vkCreateGraphicsPipelines(
+      device.handle, pipelineCache, 1, &createInfo,
+      device.getAllocationCallbacks(VK_OBJECT_TYPE_PIPELINE), &handle);
+  destroyShaderModules();
+  if (result != VK_SUCCESS) { return nullptr; }
+
+  auto pipeline = std::make_unique<GraphicsPipeline>();
+  pipeline->device = &device;
+  pipeline->handle = handle;
+  return std::move(pipeline);
+}
+
+GraphicsPipeline::~GraphicsPipeline() {
+  if (!handle) { return; }
+  vkDestroyPipeline(device->handle, handle,
+                    device->getAllocationCallbacks(VK_OBJECT_TYPE_PIPELINE));
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "renderer/pipeline_state.h"
+#include "renderer/resource.h"
+#include <memory>
+
+struct Device;
+
+struct GraphicsPipeline : public Resource {
+public:
+  static std::unique_ptr<GraphicsPipeline>
+  make(Device &device, VkPipelineCache pipelineCache,
+       const PipelineState &pipelineState);
+
+  ~GraphicsPipeline() override;
+
+  Device *device{nullptr};
+  VkPipeline handle{VK_NULL_HANDLE};
+};
@@ -0,0 +1,139 @@
+#include "renderer/pipeline_cache.h"
+#include "core/file_system.h"
+#include "core/hash.h"
+#include "renderer/device.h"
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+constexpr uint32_t PIPELINE_CACHE_MAGIC = 0x4350454e; // "NEPC"
+constexpr uint32_t PIPELINE_CACHE_VERSION = 1;
+
+struct PipelineCacheFileHeader {
+  uint32_t magic{PIPELINE_CACHE_MAGIC};
+  uint32_t version{PIPELINE_CACHE_VERSION};
+  uint64_t size{0};     // Bytes of driver data following the header
+  uint64_t checksum{0}; // Stable hash of the driver data
+};
+
+// The driver rejects foreign data itself, but not every driver does it
+// gracefully, so check the header the data starts with
+bool isCompatible(const std::string &data,
+                  const VkPhysicalDeviceProperties &properties) {
+  VkPipelineCacheHeaderVersionOne header{};
+  if (data.size() < sizeof(header)) { return false; }
+  memcpy(&header, data.data(), sizeof(header));
+  return header.headerSize >= sizeof(header) &&
+         header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+         header.vendorID == properties.vendorID &&
+         header.deviceID == properties.deviceID &&
+         memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID,
+                VK_UUID_SIZE) == 0;
+}
+
+// Return the driver data stored at filepath, empty if missing or invalid
+std::string
+loadPipelineCacheData(const std::string &filepath,
+                      const VkPhysicalDeviceProperties &properties) {
+  std::ifstream fs(filepath, std::ios::binary | std::ios::ate);
+  if (!fs.is_open()) { return {}; }
+
+  auto fileSize = static_cast<uint64_t>(fs.tellg());
+  fs.seekg(0);
+
+  PipelineCacheFileHeader header{};
+  std::string data;
+  bool valid = fileSize >= sizeof(header) &&
+               fs.read(reinterpret_cast<char *>(&header), sizeof(header)) &&
+               header.magic == PIPELINE_CACHE_MAGIC &&
+               header.version == PIPELINE_CACHE_VERSION &&
+               fileSize == sizeof(header) + header.size;
+  if (valid) {
+    data.resize(header.size);
+    valid = fs.read(data.data(), static_cast<std::streamsize>(data.size())) &&
+            stableHash(data.data(), data.size()) == header.checksum;
+  }
+  if (!valid) {
+    std::cout << "[PipelineCache] Discard corrupted " << filepath << std::endl;
+    return {};
+  }
+  if (!isCompatible(data, properties)) {
+    std::cout << "[PipelineCache] Discard " << filepath
+              << " created by another device or driver" << std::endl;
+    return {};
+  }
+  return data;
+}
+
+std::unique_ptr<PipelineCache>
+PipelineCache::make(Device &device, const std::string &filepath) {
+  std::error_code error{};
+  auto directory = std::filesystem::path(filepath).parent_path();
+  if (!directory.empty()) {
+    std::filesystem::create_directories(directory, error);
+  }
+
+  VkPhysicalDeviceProperties properties{};
+  vkGetPhysicalDeviceProperties(device.physicalDevice, &properties);
+  auto data = loadPipelineCacheData(filepath, properties);
+
+  VkPipelineCacheCreateInfo createInfo{
+      VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO};
+  createInfo.initialDataSize = data.size();
+  createInfo.pInitialData = data.data();
+
+  VkPipelineCache handle{VK_NULL_HANDLE};
+  auto callbacks =
+      device.getAllocationCallbacks(VK_OBJECT_TYPE_PIPELINE_CACHE);
+  if (vkCreatePipelineCache(device.handle, &createInfo, callbacks, &handle) !=
+      VK_SUCCESS) {
+    // Still usable when the driver refuses the data, start over empty
+    createInfo.initialDataSize = 0;
+    createInfo.pInitialData = nullptr;
+    if (vkCreatePipelineCache(device.handle, &createInfo, callbacks,
+                              &handle) != VK_SUCCESS) {
+      return nullptr;
+    }
+  }
+
+  auto pipelineCache = std::make_unique<PipelineCache>();
+  pipelineCache->device = &device;
+  pipelineCache->handle = handle;
+  pipelineCache->filepath = filepath;
+  return std::move(pipelineCache);
+}
+
+PipelineCache::~PipelineCache() {
+  if (!handle) { return; }
+  save();
+  vkDestroyPipelineCache(
+      device->handle, handle,
+      device->getAllocationCallbacks(VK_OBJECT_TYPE_PIPELINE_CACHE));
+}
+
+bool PipelineCache::save() const {
+  size_t size{0};
+  if (vkGetPipelineCacheData(device->handle, handle, &size, nullptr) !=
+      VK_SUCCESS) {
+    return false;
+  }
+
+  std::vector<uint8_t> bytes(sizeof(PipelineCacheFileHeader) + size);
+  auto data = bytes.data() + sizeof(PipelineCacheFileHeader);
+  if (vkGetPipelineCacheData(device->handle, handle, &size, data) !=
+      VK_SUCCESS) {
+    return false;
+  }
+  bytes.resize(sizeof(PipelineCacheFileHeader) + size);
+
+  PipelineCacheFileHeader header{};
+  header.size = size;
+  header.checksum = stableHash(data, size);
+  memcpy(bytes.data(), &header, sizeof(header));
+
+  if (!writeFileAtomic(filepath, bytes.data(), bytes.size())) {
+    std::cout << "[PipelineCache] Failed to write " << filepath << std::endl;
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vulkan/vulkan.h>
+
+struct Device;
+
+// VkPipelineCache persisted at `filepath`. Data written by another driver or
+// device is discarded on load, the cache is saved back when destroyed
+struct PipelineCache {
+public:
+  static std::unique_ptr<PipelineCache> make(Device &device,
+                                             const std::string &filepath);
+
+  ~PipelineCache();
+
+  bool save() const;
+
+  Device *device{nullptr};
+  VkPipelineCache handle{VK_NULL_HANDLE};
+
+private:
+  std::string filepath;
+};
@@ -0,0 +1,42 @@
+#include "renderer/pipeline_layout.h"
+#include "renderer/descriptor_set_layout.h"
+#include "renderer/device.h"
+
+std::unique_ptr<PipelineLayout> PipelineLayout::make(
+    Device &device, const std::vector<DescriptorSetLayout *> &setLayouts,
+    const std::vector<VkPushConstantRange> &pushConstantRanges) {
+  std::vector<VkDescriptorSetLayout> handles;
+  for (auto setLayout : setLayouts) {
+    if (!setLayout) { return nullptr; }
+    handles.push_back(setLayout->handle);
+  }
+
+  VkPipelineLayoutCreateInfo createInfo{
+      VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+  createInfo.setLayoutCount = handles.size();
+  createInfo.pSetLayouts = handles.data();
+  createInfo.pushConstantRangeCount = pushConstantRanges.size();
+  createInfo.pPushConstantRanges = pushConstantRanges.data();
+
+  VkPipelineLayout handle{VK_NULL_HANDLE};
+  auto callbacks =
+      device.getAllocationCallbacks(VK_OBJECT_TYPE_PIPELINE_LAYOUT);
+  if (vkCreatePipelineLayout(device.handle, &createInfo, callbacks, &handle) !=
+      VK_SUCCESS) {
+    return nullptr;
+  }
+
+  auto pipelineLayout = std::make_unique<PipelineLayout>();
+  pipelineLayout->device = &device;
+  pipelineLayout->handle = handle;
+  pipelineLayout->setLayouts = setLayouts;
+  pipelineLayout->pushConstantRanges = pushConstantRanges;
+  return std::move(pipelineLayout);
+}
+
+PipelineLayout::~PipelineLayout() {
+  if (!handle) { return; }
+  vkDestroyPipelineLayout(
+      device->handle, handle,
+      device->getAllocationCallbacks(VK_OBJECT_TYPE_PIPELINE_LAYOUT));
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "renderer/resource.h"
+#include <memory>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+inline bool operator==(const VkPushConstantRange &a,
+                       const VkPushConstantRange &b) {
+  return a.stageFlags == b.stageFlags && a.offset == b.offset &&
+         a.size == b.size;
+}
+
+struct DescriptorSetLayout;
+struct Device;
+
+struct PipelineLayout : public Resource {
+public:
+  // `setLayouts` is indexed by set number
+  static std::unique_ptr<PipelineLayout>
+  make(Device &device, const std::vector<DescriptorSetLayout *> &setLayouts,
+       const std::vector<VkPushConstantRange> &pushConstantRanges);
+
+  ~PipelineLayout() override;
+
+  const std::vector<DescriptorSetLayout *> &getSetLayouts() const {
+    return setLayouts;
+  }
+  const std::vector<VkPushConstantRange> &getPushConstantRanges() const {
+    return pushConstantRanges;
+  }
+
+  Device *device{nullptr};
+  VkPipelineLayout handle{VK_NULL_HANDLE};
+
+private:
+  std::vector<DescriptorSetLayout *> setLayouts;
+  std::vector<VkPushConstantRange> pushConstantRanges;
+};
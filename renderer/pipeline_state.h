@@ -0,0 +1,97 @@
+#pragma once
+
+#include <vector>
+#include <vulkan/vulkan.h>
+
+struct PipelineLayout;
+struct RenderPass;
+struct ShaderModule;
+
+inline bool operator==(const VkVertexInputBindingDescription &a,
+                       const VkVertexInputBindingDescription &b) {
+  return a.binding == b.binding && a.stride == b.stride &&
+         a.inputRate == b.inputRate;
+}
+
+inline bool operator==(const VkVertexInputAttributeDescription &a,
+                       const VkVertexInputAttributeDescription &b) {
+  return a.location == b.location && a.binding == b.binding &&
+         a.format == b.format && a.offset == b.offset;
+}
+
+struct VertexInputState {
+  std::vector<VkVertexInputBindingDescription> bindings;
+  std::vector<VkVertexInputAttributeDescription> attributes;
+
+  bool operator==(const VertexInputState &) const = default;
+};
+
+struct InputAssemblyState {
+  VkPrimitiveTopology topology{VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST};
+  VkBool32 primitiveRestartEnable{VK_FALSE};
+
+  bool operator==(const InputAssemblyState &) const = default;
+};
+
+struct RasterizationState {
+  VkPolygonMode polygonMode{VK_POLYGON_MODE_FILL};
+  VkCullModeFlags cullMode{VK_CULL_MODE_BACK_BIT};
+  VkFrontFace frontFace{VK_FRONT_FACE_COUNTER_CLOCKWISE};
+  VkBool32 depthBiasEnable{VK_FALSE};
+
+  bool operator==(const RasterizationState &) const = default;
+};
+
+struct MultisampleState {
+  VkSampleCountFlagBits rasterizationSamples{VK_SAMPLE_COUNT_1_BIT};
+
+  bool operator==(const MultisampleState &) const = default;
+};
+
+// Depth is cleared to 0, nearer fragments have greater depth
+struct DepthStencilState {
+  VkBool32 depthTestEnable{VK_TRUE};
+  VkBool32 depthWriteEnable{VK_TRUE};
+  VkCompareOp depthCompareOp{VK_COMPARE_OP_GREATER};
+  VkBool32 stencilTestEnable{VK_FALSE};
+
+  bool operator==(const DepthStencilState &) const = default;
+};
+
+struct ColorBlendAttachmentState {
+  VkBool32 blendEnable{VK_FALSE};
+  VkBlendFactor srcColorBlendFactor{VK_BLEND_FACTOR_ONE};
+  VkBlendFactor dstColorBlendFactor{VK_BLEND_FACTOR_ZERO};
+  VkBlendOp colorBlendOp{VK_BLEND_OP_ADD};
+  VkBlendFactor srcAlphaBlendFactor{VK_BLEND_FACTOR_ONE};
+  VkBlendFactor dstAlphaBlendFactor{VK_BLEND_FACTOR_ZERO};
+  VkBlendOp alphaBlendOp{VK_BLEND_OP_ADD};
+  VkColorComponentFlags colorWriteMask{
+      VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+      VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT};
+
+  bool operator==(const ColorBlendAttachmentState &) const = default;
+};
+
+// Empty attachments means default blending for every color attachment of the
+// subpass
+struct ColorBlendState {
+  std::vector<ColorBlendAttachmentState> attachments;
+
+  bool operator==(const ColorBlendState &) const = default;
+};
+
+// Everything a graphics pipeline is created from. Viewport and scissor are
+// dynamic so they are not part of it
+struct PipelineState {
+  std::vector<ShaderModule *> shaderModules;
+  PipelineLayout *pipelineLayout{nullptr};
+  RenderPass *renderPass{nullptr};
+  uint32_t subpassIndex{0U};
+  VertexInputState vertexInput{};
+  InputAssemblyState inputAssembly{};
+  RasterizationState rasterization{};
+  MultisampleState multisample{};
+  DepthStencilState depthStencil{};
+  ColorBlendState colorBlend{};
+};
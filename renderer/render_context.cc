@@ -2,9 +2,12 @@
 #include "renderer/device.h"
 
 std::unique_ptr<RenderContext>
-RenderContext::make(std::unique_ptr<Swapchain> &&swapchain) {
+RenderContext::make(std::unique_ptr<Swapchain> &&swapchain,
+                    size_t threadCount) {
+  threadCount = std::max<size_t>(threadCount, 1);
   std::vector<std::unique_ptr<RenderFrame>> renderFrames(
       swapchain->images.size());
+  auto attachmentPool = std::make_unique<AttachmentPool>(*swapchain->device);
 
   for (uint32_t i = 0; i < swapchain->images.size(); ++i) {
     Image image{};
@@ -14,11 +17,12 @@ RenderContext::make(std::unique_ptr<Swapchain> &&swapchain) {
       return nullptr;
     }
 
-    auto renderTarget = RenderTarget::DEFAULT_CREATE_FUNC(image);
+    auto renderTarget =
+        RenderTarget::DEFAULT_CREATE_FUNC(image, *attachmentPool);
     if (!renderTarget) { return nullptr; }
 
-    auto renderFrame = std::make_unique<RenderFrame>(*swapchain->device,
-                                                     std::move(renderTarget));
+    auto renderFrame = std::make_unique<RenderFrame>(
+        *swapchain->device, std::move(renderTarget), threadCount);
     renderFrames[i] = std::move(renderFrame);
   }
 
@@ -28,13 +32,52 @@ RenderContext::make(std::unique_ptr<Swapchain> &&swapchain) {
   auto renderContext = std::make_unique<RenderContext>();
   renderContext->device = swapchain->device;
   renderContext->swapchain = std::move(swapchain);
+  renderContext->attachmentPool = std::move(attachmentPool);
   renderContext->frames = std::move(renderFrames);
   renderContext->queue = queue;
+  renderContext->jobSystem = JobSystem::make();
+  renderContext->resourceCache = std::make_unique<ResourceCache>(
+      *renderContext->device, renderContext->jobSystem.get());
+  renderContext->uploader = Uploader::make(*renderContext->device, *queue);
+  renderContext->threadCount = renderContext->jobSystem ? threadCount : 1;
+
+  // Frames wait on the values their submissions signal, rather than on fences
+  // that have to be reset every frame
+  if (renderContext->device->features.timelineSemaphore &&
+      !createTimelineSemaphore(*renderContext->device,
+                               renderContext->timelineSemaphore)) {
+    return nullptr;
+  }
+
+  // Reset one by one, whenever a static command buffer is recorded again
+  const Queue *graphicsQueue{nullptr};
+  if (!renderContext->device->getQueue(VK_QUEUE_GRAPHICS_BIT, 0,
+                                       &graphicsQueue)) {
+    return nullptr;
+  }
+  renderContext->staticCommandPools.resize(renderContext->threadCount);
+  for (size_t i = 0; i < renderContext->threadCount; ++i) {
+    auto &pool = renderContext->staticCommandPools[i];
+    pool.commandPool = CommandPool::make(
+        *renderContext->device, graphicsQueue->familyIndex,
+        CommandBufferResetMode::ResetIndividually, i);
+    if (!pool.commandPool) { return nullptr; }
+  }
   return std::move(renderContext);
 }
 
 RenderContext::~RenderContext() {
+  wait(submittedValue);
+  staticCommandPools.clear();
+  uploader.reset();
+  resourceCache.reset();
+  jobSystem.reset();
   frames.clear();
+  attachmentPool.reset();
+  if (timelineSemaphore) {
+    auto callbacks = device->getAllocationCallbacks(VK_OBJECT_TYPE_SEMAPHORE);
+    vkDestroySemaphore(device->handle, timelineSemaphore, callbacks);
+  }
   swapchain.reset();
 }
 
@@ -44,13 +87,45 @@ bool RenderContext::begin(CommandBuffer **commandBuffer) {
   if (!device->getQueue(VK_QUEUE_GRAPHICS_BIT, 0, &graphicsQueue)) {
     return false;
   }
-  bool ok =
-      getActiveFrame()->requestCommandBuffer(commandBuffer, graphicsQueue);
+  bool ok = getActiveFrame()->requestCommandBuffer(commandBuffer,
+                                                   graphicsQueue, resetMode);
   if (!ok) { return false; }
   return true;
 }
 
+bool RenderContext::requestSecondaryCommandBuffer(CommandBuffer **commandBuffer,
+                                                  size_t threadIndex) {
+  const Queue *graphicsQueue{nullptr};
+  if (!device->getQueue(VK_QUEUE_GRAPHICS_BIT, 0, &graphicsQueue)) {
+    return false;
+  }
+  return getActiveFrame()->requestCommandBuffer(
+      commandBuffer, graphicsQueue, resetMode,
+      VK_COMMAND_BUFFER_LEVEL_SECONDARY, threadIndex);
+}
+
+bool RenderContext::requestStaticCommandBuffer(CommandBuffer **commandBuffer,
+                                               size_t threadIndex) {
+  if (threadIndex >= staticCommandPools.size()) { return false; }
+  auto &pool = staticCommandPools[threadIndex];
+  if (pool.freeCommandBuffers.empty()) {
+    return pool.commandPool->requestCommandBuffer(
+        commandBuffer, VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+  }
+  *commandBuffer = pool.freeCommandBuffers.back();
+  pool.freeCommandBuffers.pop_back();
+  return (*commandBuffer)->reset(CommandBufferResetMode::ResetIndividually);
+}
+
+void RenderContext::releaseStaticCommandBuffer(CommandBuffer *commandBuffer,
+                                               size_t threadIndex) {
+  staticCommandPools[threadIndex].releasedCommandBuffers.emplace_back(
+      submittedValue + 1, commandBuffer);
+}
+
 bool RenderContext::submit(CommandBuffer *commandBuffer) {
+  frameCommandStats.add(commandBuffer->stats);
+
   VkSemaphore renderCompleteSemaphore{VK_NULL_HANDLE};
   if (!submit(*queue, {commandBuffer}, acquiredSemaphore,
               VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
@@ -70,29 +145,115 @@ bool RenderContext::beginFrame() {
   auto result = swapchain->acquireImage(activeFrameIndex, acquiredSemaphore);
   if (result != VK_SUCCESS) { return false; }
 
-  waitFrame();
+  // The frame's submit waits for the acquire at the color attachment output
+  // stage, the first use of the image has to wait for that stage
+  auto &image = *getActiveFrame()->getRenderTarget()->images[0];
+  resetImageState(&image, image.states.front().layout,
+                  VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT);
+
+  if (!waitFrame()) { return false; }
+
+  // A released command buffer may have been executed up to the submission of
+  // the frame it was released in
+  auto completed = getCompletedValue();
+  for (auto &pool : staticCommandPools) {
+    std::erase_if(pool.releasedCommandBuffers, [&](const auto &released) {
+      if (released.first > completed) { return false; }
+      pool.freeCommandBuffers.push_back(released.second);
+      return true;
+    });
+  }
+
+  commandStats = frameCommandStats;
+  frameCommandStats = {};
+
+  resourceCache->update(submittedValue, completed);
+  device->allocator->update();
+  if (device->hostAllocator) { device->hostAllocator->update(); }
+
+  if (uploader && !uploader->update()) { return false; }
 
   return true;
 }
 
 bool RenderContext::endFrame(VkSemaphore waitSemaphore) {
-  VkPresentInfoKHR presentInfo{VK_STRUCTURE_TYPE_PRESENT_INFO_KHR};
+  auto present = [this, waitSemaphore, frame = getActiveFrame(),
+                  semaphore = acquiredSemaphore,
+                  imageIndex = activeFrameIndex]() {
+    VkPresentInfoKHR presentInfo{VK_STRUCTURE_TYPE_PRESENT_INFO_KHR};
+
+    presentInfo.waitSemaphoreCount = 1;
+    presentInfo.pWaitSemaphores = &waitSemaphore;
+    presentInfo.swapchainCount = 1;
+    presentInfo.pSwapchains = &swapchain->handle;
+    presentInfo.pImageIndices = &imageIndex;
+
+    if (!queue->present(presentInfo)) {
+      presentFailed.store(true, std::memory_order_relaxed);
+    }
 
-  presentInfo.waitSemaphoreCount = 1;
-  presentInfo.pWaitSemaphores = &waitSemaphore;
-  presentInfo.swapchainCount = 1;
-  presentInfo.pSwapchains = &swapchain->handle;
-  presentInfo.pImageIndices = &activeFrameIndex;
+    // frame is not active anymore, release owned semaphore
+    frame->releaseSemaphore(semaphore);
+  };
+  acquiredSemaphore = VK_NULL_HANDLE;
 
-  if (!queue->present(presentInfo)) { return false; }
+  // Presenting belongs to the main thread, a frame ended on another thread is
+  // presented by the next main thread jobs run there
+  if (!jobSystem) {
+    present();
+  } else {
+    jobSystem->runOnMainThread(std::move(present));
+    if (jobSystem->isMainThread()) { jobSystem->runMainThreadJobs(); }
+  }
+  return !presentFailed.exchange(false, std::memory_order_relaxed);
+}
 
-  // frame is not active anymore, release owned semaphore
-  getActiveFrame()->releaseSemaphore(acquiredSemaphore);
-  acquiredSemaphore = VK_NULL_HANDLE;
+bool RenderContext::waitFrame() {
+  auto frame = getActiveFrame();
+  if (!wait(frame->getSubmittedValue())) { return false; }
+  frame->reset();
   return true;
 }
 
-void RenderContext::waitFrame() { getActiveFrame()->reset(); }
+uint64_t RenderContext::getCompletedValue() {
+  if (!timelineSemaphore) { return completedValue; }
+  uint64_t value{0};
+  if (device->functions.getSemaphoreCounterValue(
+          device->handle, timelineSemaphore, &value) == VK_SUCCESS) {
+    completedValue = std::max(completedValue, value);
+  }
+  return completedValue;
+}
+
+bool RenderContext::wait(uint64_t value) {
+  if (value <= completedValue) { return true; }
+  if (value > submittedValue) { return false; }
+  if (timelineSemaphore) {
+    VkSemaphoreWaitInfo waitInfo{VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO};
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &timelineSemaphore;
+    waitInfo.pValues = &value;
+    if (device->functions.waitSemaphores(device->handle, &waitInfo,
+                                         UINT64_MAX) != VK_SUCCESS) {
+      return false;
+    }
+  } else {
+    // A fence signals once the submissions made to the queue before it have
+    // completed, those of the first frame that submitted the value or a later
+    // one cover it
+    RenderFrame *coveringFrame{nullptr};
+    for (auto &frame : frames) {
+      auto frameValue = frame->getSubmittedValue();
+      if (frameValue >= value &&
+          (!coveringFrame || frameValue < coveringFrame->getSubmittedValue())) {
+        coveringFrame = frame.get();
+      }
+    }
+    if (coveringFrame && !coveringFrame->wait()) { return false; }
+  }
+  completedValue = value;
+  return true;
+}
 
 bool RenderContext::submit(const Queue &graphicsQueue,
                            const std::vector<CommandBuffer *> &commandBuffers,
@@ -121,14 +282,27 @@ bool RenderContext::submit(const Queue &graphicsQueue,
     submitInfo.pWaitDstStageMask = &waitPipelineStage;
   }
 
+  // The binary semaphore is only there for the present to wait on
+  VkSemaphore signalSemaphores[] = {signalSemaphore, timelineSemaphore};
+  uint64_t signalValues[] = {0, submittedValue + 1};
   submitInfo.signalSemaphoreCount = 1;
-  submitInfo.pSignalSemaphores = &signalSemaphore;
+  submitInfo.pSignalSemaphores = signalSemaphores;
 
+  VkTimelineSemaphoreSubmitInfo timelineInfo{
+      VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO};
   VkFence fence{VK_NULL_HANDLE};
-  if (!frame->requestFence(fence)) { return false; }
+  if (timelineSemaphore) {
+    timelineInfo.signalSemaphoreValueCount = 2;
+    timelineInfo.pSignalSemaphoreValues = signalValues;
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.signalSemaphoreCount = 2;
+  } else if (!frame->requestFence(fence)) {
+    return false;
+  }
 
   if (!graphicsQueue.submit({submitInfo}, fence)) { return false; }
 
+  frame->setSubmittedValue(++submittedValue);
   *renderCompleteSemaphore = signalSemaphore;
 
   return true;
@@ -146,7 +320,7 @@ bool RenderContext::handleSurfaceChanges() {
     return true;
   }
   if (!device->waitIdle()) { return false; }
-  resourceCache.clearFramebuffers();
+  resourceCache->clearFramebuffers();
   swapchain = Swapchain::make(*swapchain, currentExtent);
   auto it = frames.begin();
   for (auto imageHandle : swapchain->images) {
@@ -156,19 +330,21 @@ bool RenderContext::handleSurfaceChanges() {
       return false;
     }
 
-    auto renderTarget = RenderTarget::DEFAULT_CREATE_FUNC(image);
+    auto renderTarget =
+        RenderTarget::DEFAULT_CREATE_FUNC(image, *attachmentPool);
     if (!renderTarget) { return false; }
 
     if (it != frames.end()) {
       (*it)->updateRenderTarget(std::move(renderTarget));
     } else {
-      auto renderFrame = std::make_unique<RenderFrame>(*swapchain->device,
-                                                       std::move(renderTarget));
+      auto renderFrame = std::make_unique<RenderFrame>(
+          *swapchain->device, std::move(renderTarget), threadCount);
       frames.emplace_back(std::move(renderFrame));
     }
 
     ++it;
   }
+  attachmentPool->trim();
   return true;
 }
 
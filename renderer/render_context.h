@@ -1,29 +1,75 @@
 #pragma once
 
+#include "core/job_system.h"
 #include "renderer/command_buffer.h"
 #include "renderer/render_frame.h"
 #include "renderer/resource_cache.h"
 #include "renderer/swapchain.h"
+#include "renderer/uploader.h"
 
 struct RenderContext {
 public:
+  // Command buffers of a frame can be recorded on up to `threadCount`
+  // threads, the calling thread and workers of the job system
   static std::unique_ptr<RenderContext>
-  make(std::unique_ptr<Swapchain> &&swapchain);
+  make(std::unique_ptr<Swapchain> &&swapchain, size_t threadCount = 1);
 
   ~RenderContext();
 
   bool begin(CommandBuffer **commandBuffer);
   bool submit(CommandBuffer *commandBuffer);
 
-  ResourceCache &getResourceCache() { return resourceCache; }
+  // A secondary command buffer of the active frame, to be executed from the
+  // primary begin() hands out and recorded on `threadIndex`
+  bool requestSecondaryCommandBuffer(CommandBuffer **commandBuffer,
+                                     size_t threadIndex);
+
+  Device &getDevice() { return *device; }
+  // A secondary command buffer kept across frames, for commands recorded once
+  // and executed by every frame, recorded on `threadIndex`. It isn't reset
+  // with the pools of the frames. Once released, it is reused after the
+  // frames in flight that may still execute it have completed
+  bool requestStaticCommandBuffer(CommandBuffer **commandBuffer,
+                                  size_t threadIndex);
+  void releaseStaticCommandBuffer(CommandBuffer *commandBuffer,
+                                  size_t threadIndex);
+
+  ResourceCache &getResourceCache() { return *resourceCache; }
+
+  // Null when the device has no timeline semaphores
+  Uploader *getUploader() { return uploader.get(); }
 
   RenderFrame *getActiveFrame();
 
+  // Every submission of the context signals the next value of a timeline.
+  // Resources used by a frame can be reused once the value of its submission
+  // has completed. Without timeline semaphores, values complete as the fences
+  // of the frames that submitted them are waited for
+  uint64_t getSubmittedValue() const { return submittedValue; }
+  uint64_t getCompletedValue();
+  bool wait(uint64_t value);
+  // For submissions to other queues to wait on values of the timeline, null
+  // when the device has no timeline semaphores
+  VkSemaphore getTimelineSemaphore() const { return timelineSemaphore; }
+
+  // State commands of the command buffers submitted in the last frame, with
+  // those of the secondaries they executed
+  const CommandBufferStats &getCommandStats() const { return commandStats; }
+
+  // How the command buffers of a frame are recycled, taking effect for each
+  // frame the next time it begins
+  void setResetMode(CommandBufferResetMode mode) { resetMode = mode; }
+
+  size_t getThreadCount() const { return threadCount; }
+  // Shared by the renderer for work off the main thread, null when no worker
+  // thread could be started
+  JobSystem *getJobSystem() { return jobSystem.get(); }
+
 private:
   bool beginFrame();
   bool endFrame(VkSemaphore waitSemaphore);
 
-  void waitFrame();
+  bool waitFrame();
 
   bool submit(const Queue &graphicsQueue,
               const std::vector<CommandBuffer *> &commandBuffers,
@@ -34,11 +80,35 @@ private:
 
   Device *device;
   std::unique_ptr<Swapchain> swapchain;
+  // Declared before the frames, whose render targets return images to it
+  std::unique_ptr<AttachmentPool> attachmentPool;
   std::vector<std::unique_ptr<RenderFrame>> frames;
   const Queue *queue{nullptr}; // a present supported queue
 
-  ResourceCache resourceCache{};
+  std::unique_ptr<ResourceCache> resourceCache;
+  std::unique_ptr<Uploader> uploader;
 
   VkSemaphore acquiredSemaphore{VK_NULL_HANDLE};
   uint32_t activeFrameIndex{0U};
+  std::atomic<bool> presentFailed{false}; // Since the last frame ended
+
+  CommandBufferResetMode resetMode{CommandBufferResetMode::ResetPool};
+
+  VkSemaphore timelineSemaphore{VK_NULL_HANDLE};
+  uint64_t submittedValue{0};
+  uint64_t completedValue{0};
+
+  // Per thread index
+  struct StaticCommandPool {
+    std::unique_ptr<CommandPool> commandPool;
+    std::vector<CommandBuffer *> freeCommandBuffers;
+    // With the timeline value of the frame they were released in
+    std::vector<std::pair<uint64_t, CommandBuffer *>> releasedCommandBuffers;
+  };
+  std::vector<StaticCommandPool> staticCommandPools;
+  CommandBufferStats commandStats{};
+  CommandBufferStats frameCommandStats{}; // Of the frame being recorded
+
+  size_t threadCount{1};
+  std::unique_ptr<JobSystem> jobSystem;
 };
@@ -5,7 +5,16 @@ RenderFrame::RenderFrame(Device &device,
                          std::unique_ptr<RenderTarget> &&renderTarget,
                          size_t threadCount)
     : device{device}, semaphorePool{device}, fencePool{device},
-      renderTarget{std::move(renderTarget)}, threadCount{threadCount} {}
+      renderTarget{std::move(renderTarget)}, threadCount{threadCount} {
+  for (VkBufferUsageFlags usage : {VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                                   VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                                   VK_BUFFER_USAGE_INDEX_BUFFER_BIT}) {
+    auto &pools = bufferPools[usage];
+    for (size_t i = 0; i < threadCount; ++i) {
+      pools.emplace_back(device, usage);
+    }
+  }
+}
 
 RenderFrame::~RenderFrame() { renderTarget.reset(); }
 
@@ -34,6 +43,7 @@ bool RenderFrame::requestCommandBuffer(CommandBuffer **commandBuffer,
                    [&threadIndex](std::unique_ptr<CommandPool> &commandPool) {
                      return commandPool->threadIndex == threadIndex;
                    });
+  if (it == commandPool->end()) { return false; }
   return (*it)->requestCommandBuffer(commandBuffer, level);
 }
 
@@ -41,9 +51,26 @@ bool RenderFrame::requestFence(VkFence &fence) {
   return fencePool.requestFence(fence);
 }
 
+bool RenderFrame::wait() { return fencePool.wait(); }
+
+bool RenderFrame::requestBufferAllocation(VkBufferUsageFlags usage,
+                                          VkDeviceSize size,
+                                          BufferAllocation &allocation,
+                                          size_t threadIndex) {
+  auto it = bufferPools.find(usage);
+  if (it == bufferPools.end() || threadIndex >= it->second.size()) {
+    return false;
+  }
+  return it->second[threadIndex].allocate(size, allocation);
+}
+
 void RenderFrame::reset() {
   fencePool.wait();
   fencePool.reset();
+  retiredCommandPools.clear();
+  for (auto &[usage, pools] : bufferPools) {
+    for (auto &pool : pools) { pool.reset(); }
+  }
   for (auto &queueCommandPools : commandPools) {
     for (auto &commandPool : queueCommandPools.second) {
       commandPool->resetPool();
@@ -58,8 +85,12 @@ bool RenderFrame::getCommandPool(
   if (auto it = commandPools.find(queue->familyIndex);
       it != commandPools.end()) {
     if (it->second.front()->resetMode != resetMode) {
-      device.waitIdle();
-      commandPools.erase(it); // Delete pools
+      // Command buffers of the pools may still be pending, they are
+      // destroyed once the frame's fences have been waited for
+      for (auto &pool : it->second) {
+        retiredCommandPools.emplace_back(std::move(pool));
+      }
+      commandPools.erase(it);
     } else {
       *commandPool = &(it->second);
       return true;
@@ -67,7 +98,7 @@ bool RenderFrame::getCommandPool(
   }
   std::vector<std::unique_ptr<CommandPool>> queueCommandPools;
   for (size_t i = 0; i < threadCount; ++i) {
-    auto pool = CommandPool::make(device, queue->familyIndex, resetMode);
+    auto pool = CommandPool::make(device, queue->familyIndex, resetMode, i);
     if (!pool) { return false; }
     queueCommandPools.emplace_back(std::move(pool));
   }
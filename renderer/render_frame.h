@@ -1,5 +1,6 @@
 #pragma once
 
+#include "renderer/buffer_pool.h"
 #include "renderer/command_pool.h"
 #include "renderer/fence_pool.h"
 #include "renderer/render_target.h"
@@ -18,16 +19,33 @@ struct RenderFrame {
   bool requestSemaphore(VkSemaphore &semaphore);
   void releaseSemaphore(VkSemaphore semaphore);
 
+  // Each thread index has pools of its own. Request from one thread, command
+  // buffers of different indices can then be recorded concurrently
   bool requestCommandBuffer(
       CommandBuffer **commandBuffer, const Queue *queue,
       CommandBufferResetMode resetMode = CommandBufferResetMode::ResetPool,
       VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
       size_t threadIndex = 0);
 
+  // Only without timeline semaphores, which frames otherwise wait on
   bool requestFence(VkFence &fence);
+  // Block until the fences of the frame have signalled
+  bool wait();
+
+  // Timeline value of the frame's last submission
+  uint64_t getSubmittedValue() const { return submittedValue; }
+  void setSubmittedValue(uint64_t value) { submittedValue = value; }
+
+  // Per frame data, such as uniforms and streamed vertices, written straight
+  // into mapped memory. Valid until the frame is reset
+  bool requestBufferAllocation(VkBufferUsageFlags usage, VkDeviceSize size,
+                               BufferAllocation &allocation,
+                               size_t threadIndex = 0);
+
   void reset();
 
   RenderTarget *getRenderTarget() { return renderTarget.get(); }
+  size_t getThreadCount() const { return threadCount; }
   void updateRenderTarget(std::unique_ptr<RenderTarget> &&renderTarget);
 
 private:
@@ -39,6 +57,12 @@ private:
   size_t threadCount{1};
   SemaphorePool semaphorePool;
   FencePool fencePool;
+  uint64_t submittedValue{0};
   std::unordered_map<uint32_t, std::vector<std::unique_ptr<CommandPool>>>
       commandPools; // Key is queue family index
+  // Pools of another reset mode, kept until the frame's work is done
+  std::vector<std::unique_ptr<CommandPool>> retiredCommandPools;
+  // One pool per usage and thread, made up front so that threads only read
+  // the map
+  std::unordered_map<VkBufferUsageFlags, std::vector<BufferPool>> bufferPools;
 };
@@ -0,0 +1,639 @@
+#include "renderer/render_graph.h"
+#include "renderer/buffer.h"
+#include "renderer/device.h"
+#include "renderer/framebuffer.h"
+#include "renderer/render_context.h"
+#include "renderer/render_pass.h"
+#include <algorithm>
+#include <iostream>
+#include <optional>
+
+static bool isAttachment(const RenderGraphUse &use) {
+  return use.usage == RenderGraphUsage::ColorAttachment ||
+         use.usage == RenderGraphUsage::DepthAttachment ||
+         use.usage == RenderGraphUsage::InputAttachment;
+}
+
+static bool isWrite(const RenderGraphUse &use) {
+  return use.usage == RenderGraphUsage::ColorAttachment ||
+         use.usage == RenderGraphUsage::DepthAttachment ||
+         use.usage == RenderGraphUsage::BufferWrite;
+}
+
+// Attachments that are loaded rather than cleared read what was there
+static bool isRead(const RenderGraphUse &use) {
+  return !isWrite(use) || !use.clear;
+}
+
+static VkImageUsageFlags getImageUsage(const RenderGraphUse &use) {
+  switch (use.usage) {
+  case RenderGraphUsage::ColorAttachment:
+    return VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+  case RenderGraphUsage::DepthAttachment:
+    return VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+  case RenderGraphUsage::InputAttachment:
+    return VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+  case RenderGraphUsage::Sampled:
+    return VK_IMAGE_USAGE_SAMPLED_BIT;
+  default:
+    return 0;
+  }
+}
+
+static VkImageLayout getLayout(const RenderGraphUse &use, VkFormat format) {
+  switch (use.usage) {
+  case RenderGraphUsage::ColorAttachment:
+    return VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  case RenderGraphUsage::DepthAttachment:
+    return VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+  case RenderGraphUsage::InputAttachment:
+    return isDepthStencilFormat(format)
+               ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+               : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  default:
+    return VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  }
+}
+
+// Where the render pass, or the pass, touches the resource
+static void getAccess(const RenderGraphUse &use, VkPipelineStageFlags2 &stages,
+                      VkAccessFlags2 &access) {
+  switch (use.usage) {
+  case RenderGraphUsage::ColorAttachment:
+    stages |= VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+    access |= VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT |
+              VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
+    break;
+  case RenderGraphUsage::DepthAttachment:
+    stages |= VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT |
+              VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT;
+    access |= VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+              VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    break;
+  case RenderGraphUsage::InputAttachment:
+    stages |= VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+    access |= VK_ACCESS_2_INPUT_ATTACHMENT_READ_BIT;
+    break;
+  case RenderGraphUsage::Sampled:
+    stages |= use.stages;
+    access |= VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+    break;
+  default:
+    stages |= use.stages;
+    access |= use.access;
+    break;
+  }
+}
+
+RenderGraph::RenderGraph(RenderContext *renderContext)
+    : renderContext{renderContext} {}
+
+RenderGraph::~RenderGraph() {
+  destroyTransientImages();
+  destroyRetiredImages(true);
+}
+
+void RenderGraph::reset() {
+  resources.clear();
+  passes.clear();
+  groups.clear();
+}
+
+RenderGraphResource RenderGraph::importImage(const ImageView &imageView,
+                                             bool preserve) {
+  Resource resource{.imageView = &imageView, .preserve = preserve};
+  const auto &image = *imageView.image;
+  resource.info = {image.extent, image.format, image.sampleCount};
+  resources.push_back(resource);
+  return resources.size() - 1;
+}
+
+RenderGraphResource RenderGraph::importBuffer(Buffer &buffer) {
+  resources.push_back({.buffer = &buffer});
+  return resources.size() - 1;
+}
+
+RenderGraphResource RenderGraph::createImage(const RenderGraphImageInfo &info) {
+  resources.push_back({.info = info, .transient = true, .preserve = false});
+  return resources.size() - 1;
+}
+
+void RenderGraph::addPass(RenderGraphPass &&pass) {
+  passes.emplace_back(std::move(pass));
+}
+
+const ImageView *RenderGraph::getImageView(RenderGraphResource resource) const {
+  return resources[resource].imageView;
+}
+
+bool RenderGraph::isRaster(const RenderGraphPass &pass) const {
+  return std::any_of(pass.uses.begin(), pass.uses.end(), isAttachment);
+}
+
+void RenderGraph::cull(std::vector<bool> &needed) const {
+  for (uint32_t i = 0; i < passes.size(); ++i) {
+    needed[i] = passes[i].sideEffects ||
+                std::any_of(passes[i].uses.begin(), passes[i].uses.end(),
+                            [&](const RenderGraphUse &use) {
+                              const auto &resource = resources[use.resource];
+                              return isWrite(use) && !resource.transient &&
+                                     resource.preserve;
+                            });
+  }
+  // Passes only depend on passes declared before them. A needed pass needs
+  // the last writer of what it reads, which needs what that one reads
+  for (auto i = static_cast<int32_t>(passes.size()) - 1; i >= 0; --i) {
+    if (!needed[i]) { continue; }
+    for (const auto &use : passes[i].uses) {
+      if (!isRead(use)) { continue; }
+      for (auto j = i - 1; j >= 0; --j) {
+        const auto &uses = passes[j].uses;
+        if (std::any_of(uses.begin(), uses.end(), [&](const auto &other) {
+              return other.resource == use.resource && isWrite(other);
+            })) {
+          needed[j] = true;
+          break;
+        }
+      }
+    }
+  }
+}
+
+bool RenderGraph::canMerge(const PassGroup &group,
+                           const RenderGraphPass &pass) const {
+  if (!group.raster || !isRaster(pass)) { return false; }
+
+  // One framebuffer, with at most one depth image for the subpasses to share
+  const RenderGraphImageInfo *target{nullptr};
+  std::vector<RenderGraphResource> depthImages;
+  auto addAttachment = [&](const RenderGraphUse &use) {
+    const auto &info = resources[use.resource].info;
+    if (target && (info.extent.width != target->extent.width ||
+                   info.extent.height != target->extent.height ||
+                   info.sampleCount != target->sampleCount)) {
+      return false;
+    }
+    target = &info;
+    if (isDepthStencilFormat(info.format) &&
+        std::find(depthImages.begin(), depthImages.end(), use.resource) ==
+            depthImages.end()) {
+      depthImages.push_back(use.resource);
+    }
+    return depthImages.size() <= 1;
+  };
+
+  for (auto index : group.passes) {
+    for (const auto &use : passes[index].uses) {
+      if (isAttachment(use) && !addAttachment(use)) { return false; }
+    }
+  }
+  for (const auto &use : pass.uses) {
+    if (isAttachment(use) && !addAttachment(use)) { return false; }
+    // Only attachments can depend on each other within a render pass, and
+    // only at the same pixel. Anything else needs a barrier between them
+    for (auto index : group.passes) {
+      for (const auto &other : passes[index].uses) {
+        if (other.resource != use.resource) { continue; }
+        if (isAttachment(use) != isAttachment(other)) { return false; }
+        if (!isAttachment(use) && (isWrite(use) || isWrite(other))) {
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+void RenderGraph::buildGroups(const std::vector<bool> &needed) {
+  // Passes wait for the earlier passes that write what they use, or use what
+  // they write
+  std::vector<std::vector<uint32_t>> dependencies(passes.size());
+  for (uint32_t i = 0; i < passes.size(); ++i) {
+    if (!needed[i]) { continue; }
+    for (uint32_t j = 0; j < i; ++j) {
+      if (!needed[j]) { continue; }
+      bool dependent = false;
+      for (const auto &use : passes[i].uses) {
+        for (const auto &other : passes[j].uses) {
+          dependent |= use.resource == other.resource &&
+                       (isWrite(use) || isWrite(other));
+        }
+      }
+      if (dependent) { dependencies[i].push_back(j); }
+    }
+  }
+
+  // In declaration order, except that a pass that can join the render pass
+  // being built goes first
+  std::vector<bool> scheduled(passes.size(), false);
+  auto isReady = [&](uint32_t i) {
+    return needed[i] && !scheduled[i] &&
+           std::all_of(dependencies[i].begin(), dependencies[i].end(),
+                       [&](uint32_t j) { return scheduled[j]; });
+  };
+  auto remaining = std::count(needed.begin(), needed.end(), true);
+  for (; remaining > 0; --remaining) {
+    std::optional<uint32_t> next;
+    bool merge = false;
+    for (uint32_t i = 0; i < passes.size(); ++i) {
+      if (!isReady(i)) { continue; }
+      if (!groups.empty() && canMerge(groups.back(), passes[i])) {
+        next = i;
+        merge = true;
+        break;
+      }
+      if (!next) { next = i; }
+    }
+    if (!merge) { groups.push_back({.raster = isRaster(passes[*next])}); }
+    groups.back().passes.push_back(*next);
+    scheduled[*next] = true;
+  }
+}
+
+bool RenderGraph::compile() {
+  groups.clear();
+  stats = {.passCount = passes.size()};
+
+  std::vector<bool> needed(passes.size(), false);
+  cull(needed);
+  stats.culledPassCount = std::count(needed.begin(), needed.end(), false);
+  buildGroups(needed);
+
+  for (uint32_t g = 0; g < groups.size(); ++g) {
+    if (groups[g].raster) { ++stats.renderPassCount; }
+    for (auto index : groups[g].passes) {
+      for (const auto &use : passes[index].uses) {
+        auto &resource = resources[use.resource];
+        resource.firstGroup = std::min(resource.firstGroup, g);
+        resource.lastGroup = std::max(resource.lastGroup, g);
+        resource.usage |= getImageUsage(use);
+      }
+    }
+  }
+  return allocateTransientImages();
+}
+
+bool RenderGraph::allocateTransientImages() {
+  destroyRetiredImages(false);
+
+  std::vector<TransientImage> plan;
+  for (auto &resource : resources) {
+    if (!resource.transient || resource.firstGroup == ~0U) { continue; }
+    resource.transientIndex = plan.size();
+    plan.push_back({.info = resource.info,
+                    .usage = resource.usage,
+                    .firstGroup = resource.firstGroup,
+                    .lastGroup = resource.lastGroup});
+  }
+
+  auto samePlan =
+      plan.size() == transientImages.size() &&
+      std::equal(plan.begin(), plan.end(), transientImages.begin(),
+                 [](const auto &a, const auto &b) { return a.isSamePlan(b); });
+  if (!samePlan) {
+    auto &device = renderContext->getDevice();
+    retireTransientImages();
+    transientImages = std::move(plan);
+
+    // Made without memory, to place images whose lifetimes don't overlap in
+    // the same slot
+    auto callbacks = device.getAllocationCallbacks(VK_OBJECT_TYPE_IMAGE);
+    std::vector<VkMemoryRequirements> requirements(transientImages.size());
+    for (size_t i = 0; i < transientImages.size(); ++i) {
+      auto &transient = transientImages[i];
+      VkImageCreateInfo imageCreateInfo{VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
+      imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+      imageCreateInfo.format = transient.info.format;
+      imageCreateInfo.extent = {transient.info.extent.width,
+                                transient.info.extent.height, 1};
+      imageCreateInfo.mipLevels = 1;
+      imageCreateInfo.arrayLayers = 1;
+      imageCreateInfo.samples = transient.info.sampleCount;
+      imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+      imageCreateInfo.usage = transient.usage;
+
+      VkImage handle{VK_NULL_HANDLE};
+      if (vkCreateImage(device.handle, &imageCreateInfo, callbacks, &handle) !=
+          VK_SUCCESS) {
+        destroyTransientImages();
+        return false;
+      }
+      ::createImage(&transient.image, &device, handle, transient.info.extent,
+                  transient.info.format);
+      transient.image.sampleCount = transient.info.sampleCount;
+      vkGetImageMemoryRequirements(device.handle, handle, &requirements[i]);
+      transient.size = requirements[i].size;
+    }
+
+    // Images in order of first use, each in the first slot that is free by
+    // then and has a memory type it can live in
+    std::vector<uint32_t> order(transientImages.size());
+    for (uint32_t i = 0; i < order.size(); ++i) { order[i] = i; }
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+      return transientImages[a].firstGroup < transientImages[b].firstGroup;
+    });
+    std::vector<VkMemoryRequirements> slots;
+    std::vector<uint32_t> slotLastGroups;
+    for (auto i : order) {
+      auto &transient = transientImages[i];
+      const auto &requirement = requirements[i];
+      uint32_t slot = 0;
+      for (; slot < slots.size(); ++slot) {
+        if (slotLastGroups[slot] < transient.firstGroup &&
+            (slots[slot].memoryTypeBits & requirement.memoryTypeBits)) {
+          break;
+        }
+      }
+      if (slot == slots.size()) {
+        slots.push_back(requirement);
+        slotLastGroups.push_back(transient.lastGroup);
+        slotImages.emplace_back();
+      } else {
+        auto &memory = slots[slot];
+        memory.size = std::max(memory.size, requirement.size);
+        memory.alignment = std::max(memory.alignment, requirement.alignment);
+        memory.memoryTypeBits &= requirement.memoryTypeBits;
+        slotLastGroups[slot] = transient.lastGroup;
+      }
+      transient.slot = slot;
+      slotImages[slot].push_back(i);
+    }
+
+    for (const auto &slot : slots) {
+      MemoryRequest request{
+          .requirements = slot,
+          .requiredProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+          .category = MemoryCategory::RenderTarget,
+      };
+      MemoryAllocation allocation{};
+      if (!device.allocator->allocate(request, allocation)) {
+        destroyTransientImages();
+        return false;
+      }
+      memorySlots.push_back(allocation);
+    }
+    for (auto &transient : transientImages) {
+      const auto &allocation = memorySlots[transient.slot];
+      if (vkBindImageMemory(device.handle, transient.image.handle,
+                            allocation.memory,
+                            allocation.offset) != VK_SUCCESS ||
+          !createImageView(&transient.imageView, &transient.image)) {
+        destroyTransientImages();
+        return false;
+      }
+    }
+
+    if (!transientImages.empty()) {
+      std::cout << "[RenderGraph] " << transientImages.size()
+                << " transient images in " << slots.size()
+                << " memory slots" << std::endl;
+    }
+  }
+
+  for (auto &resource : resources) {
+    if (!resource.transient || resource.firstGroup == ~0U) { continue; }
+    resource.imageView = &transientImages[resource.transientIndex].imageView;
+  }
+
+  stats.transientImageCount = transientImages.size();
+  stats.memorySlotCount = memorySlots.size();
+  stats.transientBytes = 0;
+  stats.unaliasedBytes = 0;
+  for (const auto &slot : memorySlots) { stats.transientBytes += slot.size; }
+  for (const auto &transient : transientImages) {
+    stats.unaliasedBytes += transient.size;
+  }
+  return true;
+}
+
+void RenderGraph::destroyTransientImages() {
+  destroyImages(transientImages, memorySlots);
+  slotImages.clear();
+}
+
+void RenderGraph::destroyImages(std::vector<TransientImage> &images,
+                                std::vector<MemoryAllocation> &memory) {
+  if (images.empty() && memory.empty()) { return; }
+  auto &device = renderContext->getDevice();
+  for (auto &transient : images) {
+    if (transient.imageView.handle) { destroyImageView(&transient.imageView); }
+    if (transient.image.handle) {
+      vkDestroyImage(device.handle, transient.image.handle,
+                     device.getAllocationCallbacks(VK_OBJECT_TYPE_IMAGE));
+    }
+  }
+  for (auto &allocation : memory) { device.allocator->free(allocation); }
+  images.clear();
+  memory.clear();
+}
+
+void RenderGraph::retireTransientImages() {
+  if (transientImages.empty() && memorySlots.empty()) { return; }
+
+  // Cached framebuffers must not outlive the views, whose handles may be
+  // reused by the next plan
+  std::vector<VkImageView> imageViews;
+  for (const auto &transient : transientImages) {
+    if (transient.imageView.handle) {
+      imageViews.push_back(transient.imageView.handle);
+    }
+  }
+  renderContext->getResourceCache().evictFramebuffers(imageViews);
+
+  // Frames in flight and the frame being recorded may still use them
+  retiredImages.push_back({.value = renderContext->getSubmittedValue() + 1,
+                           .images = std::move(transientImages),
+                           .memorySlots = std::move(memorySlots)});
+  transientImages.clear();
+  memorySlots.clear();
+  slotImages.clear();
+}
+
+void RenderGraph::destroyRetiredImages(bool force) {
+  if (retiredImages.empty()) { return; }
+  auto completed = renderContext->getCompletedValue();
+  std::erase_if(retiredImages, [&](RetiredImages &retired) {
+    if (!force && retired.value > completed) { return false; }
+    destroyImages(retired.images, retired.memorySlots);
+    return true;
+  });
+}
+
+bool RenderGraph::isDefined(RenderGraphResource resource) const {
+  const auto &info = resources[resource];
+  return written[resource] || (!info.transient && info.preserve);
+}
+
+void RenderGraph::handOverMemory(uint32_t groupIndex) {
+  // The image taking over the memory of a slot waits for the last use of the
+  // image before it, which for the first one was in the previous frame
+  for (const auto &images : slotImages) {
+    if (images.size() < 2) { continue; }
+    for (size_t i = 0; i < images.size(); ++i) {
+      auto &transient = transientImages[images[i]];
+      if (transient.firstGroup != groupIndex) { continue; }
+      const auto &previous =
+          transientImages[images[(i + images.size() - 1) % images.size()]]
+              .image.getState(0, 0);
+      transient.image.getState(0, 0) = {
+          .writeStages = previous.writeStages | previous.readStages,
+          .writeAccess = previous.writeAccess,
+      };
+    }
+  }
+}
+
+void RenderGraph::useResources(CommandBuffer &commandBuffer,
+                               const PassGroup &group) {
+  // How the group uses each resource, taken from the first use for layouts
+  // and whether the contents are needed
+  struct GroupUse {
+    RenderGraphResource resource{0};
+    VkImageLayout layout{VK_IMAGE_LAYOUT_UNDEFINED};
+    VkPipelineStageFlags2 stages{VK_PIPELINE_STAGE_2_NONE};
+    VkAccessFlags2 access{VK_ACCESS_2_NONE};
+    bool discard{false};
+  };
+  std::vector<GroupUse> groupUses;
+  for (auto index : group.passes) {
+    for (const auto &use : passes[index].uses) {
+      auto groupUse = std::find_if(
+          groupUses.begin(), groupUses.end(),
+          [&](const auto &other) { return other.resource == use.resource; });
+      if (groupUse == groupUses.end()) {
+        const auto &resource = resources[use.resource];
+        groupUses.push_back({
+            .resource = use.resource,
+            .layout = getLayout(use, resource.info.format),
+            .discard = !isDefined(use.resource) || !isRead(use),
+        });
+        groupUse = groupUses.end() - 1;
+      }
+      getAccess(use, groupUse->stages, groupUse->access);
+    }
+  }
+
+  for (const auto &groupUse : groupUses) {
+    const auto &resource = resources[groupUse.resource];
+    if (resource.buffer) {
+      commandBuffer.useBuffer(*resource.buffer,
+                              {groupUse.stages, groupUse.access});
+    } else {
+      commandBuffer.useImage(*resource.imageView,
+                             {
+                                 .layout = groupUse.layout,
+                                 .stages = groupUse.stages,
+                                 .access = groupUse.access,
+                                 .discard = groupUse.discard,
+                             });
+    }
+  }
+}
+
+bool RenderGraph::executeRenderPass(CommandBuffer &commandBuffer,
+                                    uint32_t groupIndex) {
+  const auto &group = groups[groupIndex];
+
+  // Attachments by first use. Each starts and ends the render pass in the
+  // layout of its first use, the subpasses transition it in between
+  std::vector<RenderGraphResource> attachmentResources;
+  std::vector<Attachment> attachments;
+  std::vector<VkImageView> imageViews;
+  std::vector<VkClearValue> clearValues;
+  std::vector<SubpassInfo> subpassInfos;
+  VkExtent2D extent{};
+  for (auto index : group.passes) {
+    SubpassInfo subpassInfo{.depthStencilAttachment = false};
+    for (const auto &use : passes[index].uses) {
+      if (!isAttachment(use)) { continue; }
+      const auto &resource = resources[use.resource];
+      auto found = std::find(attachmentResources.begin(),
+                             attachmentResources.end(), use.resource);
+      uint32_t attachmentIndex = found - attachmentResources.begin();
+      if (found == attachmentResources.end()) {
+        Attachment attachment{};
+        attachment.format = resource.info.format;
+        attachment.samples = resource.info.sampleCount;
+        if (use.clear) {
+          attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        } else if (isDefined(use.resource)) {
+          attachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+        } else {
+          attachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        }
+        // Kept for later render passes and for whoever imported the image
+        if (resource.lastGroup == groupIndex && !resource.preserve) {
+          attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        }
+        attachment.initialLayout = getLayout(use, resource.info.format);
+        attachment.finalLayout = attachment.initialLayout;
+        attachmentResources.push_back(use.resource);
+        attachments.push_back(attachment);
+        imageViews.push_back(resource.imageView->handle);
+        clearValues.push_back(use.clearValue);
+        extent = resource.info.extent;
+      }
+      if (use.usage == RenderGraphUsage::ColorAttachment) {
+        subpassInfo.colorAttachments.push_back(attachmentIndex);
+      } else if (use.usage == RenderGraphUsage::DepthAttachment) {
+        subpassInfo.depthStencilAttachment = true;
+      } else {
+        subpassInfo.inputAttachments.push_back(attachmentIndex);
+      }
+    }
+    subpassInfos.push_back(subpassInfo);
+  }
+
+  auto &cache = renderContext->getResourceCache();
+  auto renderPass = cache.requestRenderPass(attachments, subpassInfos);
+  if (!renderPass) { return false; }
+  auto framebuffer = cache.requestFramebuffer(imageViews, extent, *renderPass);
+  if (!framebuffer) { return false; }
+
+  for (uint32_t i = 0; i < group.passes.size(); ++i) {
+    auto &pass = passes[group.passes[i]];
+    if (i == 0) {
+      commandBuffer.beginRenderPass(*renderPass, *framebuffer, clearValues,
+                                    pass.contents);
+    } else {
+      commandBuffer.nextSubpass(pass.contents);
+    }
+
+    PipelineState pipelineState{};
+    pipelineState.renderPass = renderPass;
+    pipelineState.subpassIndex = i;
+    if (pass.record && !pass.record(commandBuffer, pipelineState)) {
+      commandBuffer.endRenderPass();
+      return false;
+    }
+  }
+  commandBuffer.endRenderPass();
+  return true;
+}
+
+bool RenderGraph::execute(CommandBuffer &commandBuffer) {
+  written.assign(resources.size(), false);
+  for (uint32_t g = 0; g < groups.size(); ++g) {
+    const auto &group = groups[g];
+    handOverMemory(g);
+    // Batched with the barriers left by earlier commands, recorded when the
+    // render pass begins
+    useResources(commandBuffer, group);
+    if (group.raster) {
+      if (!executeRenderPass(commandBuffer, g)) { return false; }
+    } else {
+      commandBuffer.flushBarriers();
+      auto &pass = passes[group.passes[0]];
+      PipelineState pipelineState{};
+      if (pass.record && !pass.record(commandBuffer, pipelineState)) {
+        return false;
+      }
+    }
+    for (auto index : group.passes) {
+      for (const auto &use : passes[index].uses) {
+        if (isWrite(use)) { written[use.resource] = true; }
+      }
+    }
+  }
+  return true;
+}
@@ -0,0 +1,188 @@
+#pragma once
+
+#include "renderer/command_buffer.h"
+#include "renderer/image_view.h"
+#include "renderer/pipeline_state.h"
+#include <functional>
+#include <string>
+
+struct Buffer;
+struct RenderContext;
+
+// An image or buffer of the graph, valid until the graph is reset
+using RenderGraphResource = uint32_t;
+
+// An image the graph makes for the frame. Its contents are lost between
+// frames, and its memory may be shared with images used at other times
+struct RenderGraphImageInfo {
+  VkExtent2D extent{};
+  VkFormat format{VK_FORMAT_UNDEFINED};
+  VkSampleCountFlagBits sampleCount{VK_SAMPLE_COUNT_1_BIT};
+
+  bool operator==(const RenderGraphImageInfo &other) const {
+    return extent.width == other.extent.width &&
+           extent.height == other.extent.height &&
+           format == other.format && sampleCount == other.sampleCount;
+  }
+};
+
+enum class RenderGraphUsage {
+  ColorAttachment,
+  DepthAttachment,
+  // Read at the same pixel it was written, which lets the pass share a
+  // render pass with the one that wrote it
+  InputAttachment,
+  Sampled,
+  BufferRead,
+  BufferWrite,
+};
+
+struct RenderGraphUse {
+  RenderGraphResource resource{0};
+  RenderGraphUsage usage{RenderGraphUsage::ColorAttachment};
+  // Sampled images and buffers, attachments are used at their fixed stages
+  VkPipelineStageFlags2 stages{VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT};
+  VkAccessFlags2 access{VK_ACCESS_2_NONE}; // Buffers only
+  // Attachments that are cleared rather than loaded
+  bool clear{false};
+  VkClearValue clearValue{};
+};
+
+// Records a pass. Passes with attachments are recorded in their subpass,
+// with the render pass and subpass index of `pipelineState` set
+using RenderGraphRecordFunc =
+    std::function<bool(CommandBuffer &commandBuffer,
+                       PipelineState &pipelineState)>;
+
+struct RenderGraphPass {
+  std::string name;
+  std::vector<RenderGraphUse> uses;
+  RenderGraphRecordFunc record;
+  // How the subpass of a pass with attachments is recorded
+  VkSubpassContents contents{VK_SUBPASS_CONTENTS_INLINE};
+  // Kept even when nothing reads what it writes
+  bool sideEffects{false};
+};
+
+struct RenderGraphStats {
+  size_t passCount{0};
+  size_t culledPassCount{0};
+  size_t renderPassCount{0}; // Of the passes with attachments, once merged
+  size_t transientImageCount{0};
+  size_t memorySlotCount{0}; // Allocations the transient images share
+  VkDeviceSize transientBytes{0};
+  VkDeviceSize unaliasedBytes{0}; // Had every transient image its own memory
+};
+
+// The passes of a frame and the resources they use, rebuilt every frame.
+// Compiling culls the passes nothing needs, orders the others so that passes
+// that can share a render pass are next to each other, merges them into
+// subpasses, and places transient images whose lifetimes don't overlap in
+// the same memory. Executing records the barriers each render pass or pass
+// needs as one batch, derived from the tracked state of its resources
+struct RenderGraph {
+public:
+  explicit RenderGraph(RenderContext *renderContext);
+  ~RenderGraph();
+
+  // Drop the passes and resources of the last frame. Transient images are
+  // kept for the next compile to reuse
+  void reset();
+
+  // The contents of imported images are written back at the end of their
+  // last render pass only when `preserve` is set, which also keeps the passes
+  // that write them
+  RenderGraphResource importImage(const ImageView &imageView,
+                                  bool preserve = true);
+  RenderGraphResource importBuffer(Buffer &buffer);
+  RenderGraphResource createImage(const RenderGraphImageInfo &info);
+
+  void addPass(RenderGraphPass &&pass);
+
+  bool compile();
+  bool execute(CommandBuffer &commandBuffer);
+
+  // Valid after compile, for passes to sample transient images
+  const ImageView *getImageView(RenderGraphResource resource) const;
+
+  const RenderGraphStats &getStats() const { return stats; }
+
+private:
+  struct Resource {
+    const ImageView *imageView{nullptr}; // Set for transient images by compile
+    Buffer *buffer{nullptr};
+    RenderGraphImageInfo info{}; // Of images
+    bool transient{false};
+    bool preserve{true};
+    VkImageUsageFlags usage{0}; // Of transient images, from their uses
+    // Render passes or passes using the resource, once compiled
+    uint32_t firstGroup{~0U};
+    uint32_t lastGroup{0};
+    uint32_t transientIndex{0};
+  };
+
+  // Passes recorded together, in one render pass when they have attachments
+  struct PassGroup {
+    std::vector<uint32_t> passes;
+    bool raster{false};
+  };
+
+  // An image of the memory plan, reused as long as the plan doesn't change
+  struct TransientImage {
+    RenderGraphImageInfo info{};
+    VkImageUsageFlags usage{0};
+    uint32_t firstGroup{0};
+    uint32_t lastGroup{0};
+    uint32_t slot{0};
+    VkDeviceSize size{0}; // Of its memory requirements
+    Image image{};
+    ImageView imageView{};
+
+    bool isSamePlan(const TransientImage &other) const {
+      return info == other.info && usage == other.usage &&
+             firstGroup == other.firstGroup && lastGroup == other.lastGroup;
+    }
+  };
+
+  bool isRaster(const RenderGraphPass &pass) const;
+  bool canMerge(const PassGroup &group, const RenderGraphPass &pass) const;
+
+  void cull(std::vector<bool> &needed) const;
+  void buildGroups(const std::vector<bool> &needed);
+  bool allocateTransientImages();
+  void destroyTransientImages();
+  void destroyImages(std::vector<TransientImage> &images,
+                     std::vector<MemoryAllocation> &memory);
+  // Keep the images and memory of the current plan until the frames that
+  // may use them have completed, and destroy those that have
+  void retireTransientImages();
+  void destroyRetiredImages(bool force);
+
+  // The contents of the resource at this point of the execution are needed
+  bool isDefined(RenderGraphResource resource) const;
+  void useResources(CommandBuffer &commandBuffer, const PassGroup &group);
+  bool executeRenderPass(CommandBuffer &commandBuffer, uint32_t groupIndex);
+  void handOverMemory(uint32_t groupIndex);
+
+  RenderContext *renderContext{nullptr};
+
+  std::vector<Resource> resources;
+  std::vector<RenderGraphPass> passes;
+  std::vector<PassGroup> groups;
+  std::vector<bool> written; // By the groups executed so far
+
+  std::vector<TransientImage> transientImages;
+  std::vector<MemoryAllocation> memorySlots;
+  // The transient images of each slot, by first use
+  std::vector<std::vector<uint32_t>> slotImages;
+  // Images and memory of replaced plans, with the timeline value of the
+  // frame that replaced them
+  struct RetiredImages {
+    uint64_t value{0};
+    std::vector<TransientImage> images;
+    std::vector<MemoryAllocation> memorySlots;
+  };
+  std::vector<RetiredImages> retiredImages;
+
+  RenderGraphStats stats{};
+};
@@ -0,0 +1,124 @@
+#include "renderer/render_pass.h"
+#include "renderer/device.h"
+#include <optional>
+
+std::unique_ptr<RenderPass>
+RenderPass::make(Device &device, const std::vector<Attachment> &attachments,
+                 const std::vector<SubpassInfo> &subpasses) {
+  if (subpasses.empty()) { return nullptr; }
+
+  std::vector<VkAttachmentDescription> descriptions;
+  std::optional<uint32_t> depthAttachment{};
+  for (uint32_t i = 0; i < attachments.size(); ++i) {
+    const auto &attachment = attachments[i];
+    VkAttachmentDescription description{};
+    description.format = attachment.format;
+    description.samples = attachment.samples;
+    description.loadOp = attachment.loadOp;
+    description.storeOp = attachment.storeOp;
+    description.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    description.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    description.initialLayout = attachment.initialLayout;
+    description.finalLayout = attachment.finalLayout;
+    if (isDepthStencilFormat(attachment.format)) {
+      if (!isDepthOnlyFormat(attachment.format)) {
+        description.stencilLoadOp = attachment.loadOp;
+        description.stencilStoreOp = attachment.storeOp;
+      }
+      if (!depthAttachment) { depthAttachment = i; }
+    }
+    descriptions.push_back(description);
+  }
+
+  // Sized up front, descriptions point into these until the create call
+  std::vector<std::vector<VkAttachmentReference>> inputReferences(
+      subpasses.size());
+  std::vector<std::vector<VkAttachmentReference>> colorReferences(
+      subpasses.size());
+  std::vector<VkAttachmentReference> depthReferences(subpasses.size());
+  std::vector<VkSubpassDescription> subpassDescriptions;
+  std::vector<uint32_t> colorAttachmentCounts;
+  for (size_t i = 0; i < subpasses.size(); ++i) {
+    const auto &subpass = subpasses[i];
+    for (auto index : subpass.inputAttachments) {
+      inputReferences[i].push_back(
+          {index, isDepthStencilFormat(attachments[index].format)
+                      ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+                      : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL});
+    }
+    for (auto index : subpass.colorAttachments) {
+      colorReferences[i].push_back(
+          {index, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL});
+    }
+
+    VkSubpassDescription description{};
+    description.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    description.inputAttachmentCount = inputReferences[i].size();
+    description.pInputAttachments = inputReferences[i].data();
+    description.colorAttachmentCount = colorReferences[i].size();
+    description.pColorAttachments = colorReferences[i].data();
+    if (subpass.depthStencilAttachment && depthAttachment) {
+      depthReferences[i] = {*depthAttachment,
+                            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+      description.pDepthStencilAttachment = &depthReferences[i];
+    }
+    subpassDescriptions.push_back(description);
+    colorAttachmentCounts.push_back(colorReferences[i].size());
+  }
+
+  // Each subpass may read what the previous one wrote, at the same pixel, and
+  // draw over it. Dependencies chain, so a subpass also waits for the ones
+  // before the previous one
+  std::vector<VkSubpassDependency> dependencies;
+  for (uint32_t i = 1; i < subpasses.size(); ++i) {
+    VkSubpassDependency dependency{};
+    dependency.srcSubpass = i - 1;
+    dependency.dstSubpass = i;
+    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                              VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                              VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependency.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                              VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                              VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+                              VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                               VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependency.dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT |
+                               VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+                               VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                               VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                               VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+    dependencies.push_back(dependency);
+  }
+
+  VkRenderPassCreateInfo createInfo{VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO};
+  createInfo.attachmentCount = descriptions.size();
+  createInfo.pAttachments = descriptions.data();
+  createInfo.subpassCount = subpassDescriptions.size();
+  createInfo.pSubpasses = subpassDescriptions.data();
+  createInfo.dependencyCount = dependencies.size();
+  createInfo.pDependencies = dependencies.data();
+
+  VkRenderPass handle{VK_NULL_HANDLE};
+  auto callbacks = device.getAllocationCallbacks(VK_OBJECT_TYPE_RENDER_PASS);
+  if (vkCreateRenderPass(device.handle, &createInfo, callbacks, &handle) !=
+      VK_SUCCESS) {
+    return nullptr;
+  }
+
+  auto renderPass = std::make_unique<RenderPass>();
+  renderPass->device = &device;
+  renderPass->handle = handle;
+  renderPass->attachments = attachments;
+  renderPass->subpasses = subpasses;
+  renderPass->colorAttachmentCounts = std::move(colorAttachmentCounts);
+  return std::move(renderPass);
+}
+
+RenderPass::~RenderPass() {
+  if (!handle) { return; }
+  vkDestroyRenderPass(
+      device->handle, handle,
+      device->getAllocationCallbacks(VK_OBJECT_TYPE_RENDER_PASS));
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "renderer/resource.h"
+#include <memory>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+struct Device;
+
+struct Attachment {
+  VkFormat format{VK_FORMAT_UNDEFINED};
+  VkSampleCountFlagBits samples{VK_SAMPLE_COUNT_1_BIT};
+  VkAttachmentLoadOp loadOp{VK_ATTACHMENT_LOAD_OP_CLEAR};
+  VkAttachmentStoreOp storeOp{VK_ATTACHMENT_STORE_OP_STORE};
+  VkImageLayout initialLayout{VK_IMAGE_LAYOUT_UNDEFINED};
+  VkImageLayout finalLayout{VK_IMAGE_LAYOUT_UNDEFINED};
+
+  bool operator==(const Attachment &) const = default;
+};
+
+// Indices into the attachments of the render pass. A depth attachment, if
+// any, is used by every subpass that enables it
+struct SubpassInfo {
+  std::vector<uint32_t> inputAttachments;
+  std::vector<uint32_t> colorAttachments;
+  bool depthStencilAttachment{true};
+
+  bool operator==(const SubpassInfo &) const = default;
+};
+
+struct RenderPass : public Resource {
+public:
+  static std::unique_ptr<RenderPass>
+  make(Device &device, const std::vector<Attachment> &attachments,
+       const std::vector<SubpassInfo> &subpasses);
+
+  ~RenderPass() override;
+
+  uint32_t getColorAttachmentCount(uint32_t subpassIndex) const {
+    return colorAttachmentCounts[subpassIndex];
+  }
+  const std::vector<Attachment> &getAttachments() const { return attachments; }
+  const std::vector<SubpassInfo> &getSubpasses() const { return subpasses; }
+
+  Device *device{nullptr};
+  VkRenderPass handle{VK_NULL_HANDLE};
+
+private:
+  std::vector<Attachment> attachments;
+  std::vector<SubpassInfo> subpasses;
+  std::vector<uint32_t> colorAttachmentCounts; // Per subpass
+};
@@ -1,8 +1,196 @@
 #include "renderer/render_pipeline.h"
+#include "renderer/device.h"
+#include <algorithm>
 
-RenderPipeline::~RenderPipeline() { subpasses.clear(); }
+RenderPipeline::RenderPipeline(RenderContext *renderContext)
+    : renderContext{renderContext}, renderGraph{renderContext} {}
+
+RenderPipeline::~RenderPipeline() {
+  for (auto &commands : staticCommands) { releaseStaticCommands(commands); }
+  subpasses.clear();
+}
 
 void RenderPipeline::addSubpass(std::unique_ptr<Subpass> &&subpass) {
   subpass->prepare();
   subpasses.emplace_back(std::move(subpass));
+  staticCommands.emplace_back();
+}
+
+bool RenderPipeline::draw(CommandBuffer &commandBuffer,
+                          RenderTarget &renderTarget) {
+  if (subpasses.empty()) { return true; }
+
+  renderGraph.reset();
+  // The depth image is only needed while drawing
+  std::vector<RenderGraphUse> uses;
+  for (const auto &imageView : renderTarget.imageViews) {
+    if (isDepthStencilFormat(imageView.image->format)) {
+      uses.push_back({.resource = renderGraph.importImage(imageView, false),
+                      .usage = RenderGraphUsage::DepthAttachment,
+                      .clearValue = clearValue[1]});
+    } else {
+      uses.push_back({.resource = renderGraph.importImage(imageView),
+                      .usage = RenderGraphUsage::ColorAttachment,
+                      .clearValue = clearValue[0]});
+    }
+  }
+
+  // Every subpass writes every attachment, the first one clears them
+  for (uint32_t i = 0; i < subpasses.size(); ++i) {
+    auto &subpass = *subpasses[i];
+    auto drawCount = subpass.prepareDraws();
+    auto threadCount = getThreadCount(drawCount);
+
+    RenderGraphPass pass{.name = "subpass " + std::to_string(i), .uses = uses};
+    for (auto &use : pass.uses) { use.clear = i == 0; }
+    pass.contents = threadCount > 1 || subpass.isStatic()
+                        ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+                        : VK_SUBPASS_CONTENTS_INLINE;
+    pass.record = [this, i, drawCount, threadCount,
+                   extent = renderTarget.extent](
+                      CommandBuffer &commandBuffer,
+                      PipelineState &pipelineState) {
+      auto &subpass = *subpasses[i];
+      if (subpass.isStatic()) {
+        return drawStatic(commandBuffer, i, pipelineState, drawCount,
+                          threadCount, extent);
+      }
+      return threadCount > 1
+                 ? drawSecondary(commandBuffer, subpass, pipelineState,
+                                 drawCount, threadCount, extent)
+                 : subpass.draw(commandBuffer, pipelineState);
+    };
+    renderGraph.addPass(std::move(pass));
+  }
+
+  if (!renderGraph.compile()) { return false; }
+  return renderGraph.execute(commandBuffer);
+}
+
+size_t RenderPipeline::getThreadCount(size_t drawCount) const {
+  if (minDrawsPerThread == 0) { return 1; }
+  return std::clamp<size_t>(drawCount / minDrawsPerThread, 1,
+                            renderContext->getThreadCount());
+}
+
+bool RenderPipeline::drawSecondary(CommandBuffer &commandBuffer,
+                                   Subpass &subpass,
+                                   const PipelineState &pipelineState,
+                                   size_t drawCount, size_t threadCount,
+                                   const VkExtent2D &extent) {
+  // Requested up front, the pools of a frame are not shared between threads
+  std::vector<CommandBuffer *> commandBuffers(threadCount, nullptr);
+  for (size_t i = 0; i < threadCount; ++i) {
+    if (!renderContext->requestSecondaryCommandBuffer(&commandBuffers[i], i)) {
+      return false;
+    }
+  }
+
+  if (!recordSecondary(commandBuffer, commandBuffers, subpass, pipelineState,
+                       drawCount, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+                       true, extent)) {
+    return false;
+  }
+  commandBuffer.executeCommands(commandBuffers);
+  return true;
+}
+
+bool RenderPipeline::drawStatic(CommandBuffer &commandBuffer,
+                                uint32_t subpassIndex,
+                                const PipelineState &pipelineState,
+                                size_t drawCount, size_t threadCount,
+                                const VkExtent2D &extent) {
+  auto &subpass = *subpasses[subpassIndex];
+  auto &commands = staticCommands[subpassIndex];
+  // Keeps the pipelines of the recorded commands from being evicted
+  auto state = pipelineState;
+  if (!subpass.requestPipelines(state)) { return false; }
+
+  StaticCommands key{
+      .renderPass = pipelineState.renderPass,
+      .subpassIndex = pipelineState.subpassIndex,
+      .extent = extent,
+      .pipelineGeneration =
+          renderContext->getResourceCache().getPipelineGeneration(),
+  };
+  subpass.getDraws(key.draws);
+  if (commands.commandBuffers.size() == threadCount &&
+      commands.isRecordedFor(key)) {
+    commandBuffer.executeCommands(commands.commandBuffers);
+    return true;
+  }
+
+  // Frames in flight may still execute the previous recording
+  releaseStaticCommands(commands);
+  for (size_t i = 0; i < threadCount; ++i) {
+    CommandBuffer *staticCommandBuffer{nullptr};
+    if (!renderContext->requestStaticCommandBuffer(&staticCommandBuffer, i)) {
+      releaseStaticCommands(commands);
+      return false;
+    }
+    commands.commandBuffers.push_back(staticCommandBuffer);
+  }
+
+  // Executed by the primaries of several frames in flight at once, with the
+  // framebuffers of their own render targets
+  if (!recordSecondary(commandBuffer, commands.commandBuffers, subpass,
+                       pipelineState, drawCount,
+                       VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT, false,
+                       extent)) {
+    releaseStaticCommands(commands);
+    return false;
+  }
+  key.commandBuffers = std::move(commands.commandBuffers);
+  commands = std::move(key);
+  ++staticRecordCount;
+
+  commandBuffer.executeCommands(commands.commandBuffers);
+  return true;
+}
+
+void RenderPipeline::releaseStaticCommands(StaticCommands &commands) {
+  for (size_t i = 0; i < commands.commandBuffers.size(); ++i) {
+    renderContext->releaseStaticCommandBuffer(commands.commandBuffers[i], i);
+  }
+  commands = {};
+}
+
+bool RenderPipeline::recordSecondary(
+    const CommandBuffer &primary,
+    const std::vector<CommandBuffer *> &commandBuffers, Subpass &subpass,
+    const PipelineState &pipelineState, size_t drawCount,
+    VkCommandBufferUsageFlags usage, bool inheritFramebuffer,
+    const VkExtent2D &extent) {
+  auto threadCount = commandBuffers.size();
+  auto record = [&](size_t threadIndex) {
+    auto &secondary = *commandBuffers[threadIndex];
+    auto first = drawCount * threadIndex / threadCount;
+    auto count = drawCount * (threadIndex + 1) / threadCount - first;
+    if (!secondary.begin(usage, &primary, inheritFramebuffer)) {
+      return false;
+    }
+    // Dynamic state is not inherited from the primary
+    VkViewport viewport{.width = static_cast<float>(extent.width),
+                        .height = static_cast<float>(extent.height),
+                        .maxDepth = 1.0f};
+    secondary.setViewport(viewport);
+    secondary.setScissor({.extent = extent});
+
+    auto state = pipelineState;
+    bool ok = subpass.drawRange(secondary, state, first, count, threadIndex);
+    return secondary.end() && ok;
+  };
+
+  // The calling thread records the first range while the workers record
+  // the others, and helps with them once it is done
+  std::vector<uint8_t> results(threadCount, false);
+  auto recordRange = [&](size_t begin, size_t end) {
+    for (auto i = begin; i < end; ++i) { results[i] = record(i); }
+  };
+  if (auto jobSystem = renderContext->getJobSystem()) {
+    jobSystem->parallelFor(threadCount, 1, recordRange);
+  } else {
+    recordRange(0, threadCount);
+  }
+  return std::find(results.begin(), results.end(), false) == results.end();
 }
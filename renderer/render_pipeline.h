@@ -1,18 +1,79 @@
 #pragma once
 
+#include "renderer/render_graph.h"
 #include "renderer/subpass.h"
 
 struct RenderPipeline {
 public:
+  explicit RenderPipeline(RenderContext *renderContext);
   ~RenderPipeline();
 
   void addSubpass(std::unique_ptr<Subpass> &&subpass);
 
+  // Record every subpass as a pass of the render graph writing every image
+  // of `renderTarget`, which merges them into one render pass and barriers
+  // the images into attachment layouts. They are left in them. Subpasses
+  // with enough draws are split into secondary command buffers recorded on
+  // the threads of the render context. Those of static subpasses are kept
+  // and executed again by later frames
+  bool draw(CommandBuffer &commandBuffer, RenderTarget &renderTarget);
+
+  const RenderGraph &getRenderGraph() const { return renderGraph; }
+
+  // Fewest draws worth a secondary command buffer of their own
+  void setMinDrawsPerThread(size_t count) { minDrawsPerThread = count; }
+
+  // Times static subpasses were recorded, once plus once per change
+  uint64_t getStaticRecordCount() const { return staticRecordCount; }
+
 private:
+  // Secondary command buffers of a static subpass, by thread index, and what
+  // they were recorded for
+  struct StaticCommands {
+    std::vector<CommandBuffer *> commandBuffers;
+    std::vector<SubpassDraw> draws;
+    const RenderPass *renderPass{nullptr};
+    uint32_t subpassIndex{0};
+    VkExtent2D extent{};
+    uint64_t pipelineGeneration{0};
+
+    bool isRecordedFor(const StaticCommands &other) const {
+      return draws == other.draws && renderPass == other.renderPass &&
+             subpassIndex == other.subpassIndex &&
+             extent.width == other.extent.width &&
+             extent.height == other.extent.height &&
+             pipelineGeneration == other.pipelineGeneration;
+    }
+  };
+
+  size_t getThreadCount(size_t drawCount) const;
+  bool drawSecondary(CommandBuffer &commandBuffer, Subpass &subpass,
+                     const PipelineState &pipelineState, size_t drawCount,
+                     size_t threadCount, const VkExtent2D &extent);
+  // Execute the static commands of the subpass, recorded again first when
+  // they are out of date. Their pipelines are requested every frame so that
+  // the cache doesn't evict them
+  bool drawStatic(CommandBuffer &commandBuffer, uint32_t subpassIndex,
+                  const PipelineState &pipelineState, size_t drawCount,
+                  size_t threadCount, const VkExtent2D &extent);
+  void releaseStaticCommands(StaticCommands &commands);
+  // Split the draws over the command buffers and record them in parallel
+  bool recordSecondary(const CommandBuffer &primary,
+                       const std::vector<CommandBuffer *> &commandBuffers,
+                       Subpass &subpass, const PipelineState &pipelineState,
+                       size_t drawCount, VkCommandBufferUsageFlags usage,
+                       bool inheritFramebuffer, const VkExtent2D &extent);
+
+  RenderContext *renderContext{nullptr};
+  RenderGraph renderGraph;
+
   std::vector<VkClearValue> clearValue{
       {.color = {0, 0, 0, 1}},
       {.depthStencil = {0, ~0U}},
   };
 
   std::vector<std::unique_ptr<Subpass>> subpasses;
+  std::vector<StaticCommands> staticCommands; // By subpass
+  uint64_t staticRecordCount{0};
+  size_t minDrawsPerThread{64};
 };
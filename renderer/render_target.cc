@@ -2,24 +2,24 @@
 #include "renderer/device.h"
 
 const RenderTarget::CreateFunc RenderTarget::DEFAULT_CREATE_FUNC =
-    [](Image color) -> std::unique_ptr<RenderTarget> {
-  Image depth{};
+    [](Image color,
+       AttachmentPool &attachmentPool) -> std::unique_ptr<RenderTarget> {
   auto format = chooseDepthFormat(color.device->physicalDevice);
-  auto usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
-               VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
-  if (!createImage(&depth, color.device, color.extent, format, usage,
-                   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)) {
-    return nullptr;
-  }
+  auto depth = attachmentPool.request(
+      color.extent, format, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT);
+  if (!depth) { return nullptr; }
 
   auto renderTarget = std::make_unique<RenderTarget>();
   renderTarget->extent = color.extent;
-  renderTarget->images.emplace_back(color);
-  renderTarget->images.emplace_back(depth);
+  renderTarget->images.emplace_back(new Image(color), [](Image *image) {
+    destroyImage(image);
+    delete image;
+  });
+  renderTarget->images.emplace_back(std::move(depth));
 
   for (auto &image : renderTarget->images) {
     ImageView imageView{};
-    if (!createImageView(&imageView, &image)) { return nullptr; }
+    if (!createImageView(&imageView, image.get())) { return nullptr; }
 
     renderTarget->imageViews.emplace_back(imageView);
   }
@@ -31,6 +31,5 @@ RenderTarget::~RenderTarget() {
   for (auto &imageView : imageViews) { destroyImageView(&imageView); }
   imageViews.clear();
 
-  for (auto &image : images) { destroyImage(&image); }
   images.clear();
 }
@@ -1,16 +1,19 @@
 #pragma once
 
+#include "renderer/attachment_pool.h"
 #include "renderer/image_view.h"
 #include <functional>
 
 struct RenderTarget {
-  using CreateFunc = std::function<std::unique_ptr<RenderTarget>(Image color)>;
+  using CreateFunc = std::function<std::unique_ptr<RenderTarget>(
+      Image color, AttachmentPool &attachmentPool)>;
 
   static const CreateFunc DEFAULT_CREATE_FUNC;
 
   ~RenderTarget();
 
   VkExtent2D extent{};
-  std::vector<Image> images;
+  // Shared with other render targets when they come from an attachment pool
+  std::vector<std::shared_ptr<Image>> images;
   std::vector<ImageView> imageViews;
 };
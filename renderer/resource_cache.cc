@@ -1,62 +1,660 @@
 #include "renderer/resource_cache.h"
+#include "renderer/device.h"
+#include "renderer/render_target.h"
 #include "renderer/shader_module.h"
+#include <algorithm>
+#include <iostream>
 
 namespace std {
 
-template <> struct hash<ShaderSource> {
-  std::size_t operator()(const ShaderSource &source) const {
+template <> struct hash<Attachment> {
+  std::size_t operator()(const Attachment &attachment) const {
     std::size_t result{0};
-    hashCombine(result, source.id);
+    hashParam(result, attachment.format, attachment.samples, attachment.loadOp,
+              attachment.storeOp, attachment.initialLayout,
+              attachment.finalLayout);
     return result;
   }
 };
 
-template <> struct hash<ShaderVariant> {
-  std::size_t operator()(const ShaderVariant &variant) const {
+template <> struct hash<SubpassInfo> {
+  std::size_t operator()(const SubpassInfo &subpass) const {
     std::size_t result{0};
-    hashCombine(result, variant.getId());
+    hashParam(result, subpass.inputAttachments, subpass.colorAttachments,
+              subpass.depthStencilAttachment);
     return result;
   }
 };
 
-} // namespace std
+template <> struct hash<VkVertexInputBindingDescription> {
+  std::size_t
+  operator()(const VkVertexInputBindingDescription &binding) const {
+    std::size_t result{0};
+    hashParam(result, binding.binding, binding.stride, binding.inputRate);
+    return result;
+  }
+};
+
+template <> struct hash<VkVertexInputAttributeDescription> {
+  std::size_t
+  operator()(const VkVertexInputAttributeDescription &attribute) const {
+    std::size_t result{0};
+    hashParam(result, attribute.location, attribute.binding, attribute.format,
+              attribute.offset);
+    return result;
+  }
+};
+
+template <> struct hash<ColorBlendAttachmentState> {
+  std::size_t operator()(const ColorBlendAttachmentState &blend) const {
+    std::size_t result{0};
+    hashParam(result, blend.blendEnable, blend.srcColorBlendFactor,
+              blend.dstColorBlendFactor, blend.colorBlendOp,
+              blend.srcAlphaBlendFactor, blend.dstAlphaBlendFactor,
+              blend.alphaBlendOp, blend.colorWriteMask);
+    return result;
+  }
+};
+
+// Descriptors only, set and name don't matter to the layout, so identical
+// sets share one layout object
+template <> struct hash<ShaderResource> {
+  std::size_t operator()(const ShaderResource &resource) const {
+    std::size_t result{0};
+    hashParam(result, resource.type, resource.stages, resource.binding,
+              resource.arraySize);
+    return result;
+  }
+};
+
+template <> struct hash<VkPushConstantRange> {
+  std::size_t operator()(const VkPushConstantRange &range) const {
+    std::size_t result{0};
+    hashParam(result, range.stageFlags, range.offset, range.size);
+    return result;
+  }
+};
+
+template <> struct hash<VertexInputState> {
+  std::size_t operator()(const VertexInputState &state) const {
+    std::size_t result{0};
+    hashParam(result, state.bindings, state.attributes);
+    return result;
+  }
+};
+
+template <> struct hash<InputAssemblyState> {
+  std::size_t operator()(const InputAssemblyState &state) const {
+    std::size_t result{0};
+    hashParam(result, state.topology, state.primitiveRestartEnable);
+    return result;
+  }
+};
+
+template <> struct hash<RasterizationState> {
+  std::size_t operator()(const RasterizationState &state) const {
+    std::size_t result{0};
+    hashParam(result, state.polygonMode, state.cullMode, state.frontFace,
+              state.depthBiasEnable);
+    return result;
+  }
+};
 
-template <typename T, typename... A,
-          std::enable_if_t<std::is_base_of_v<Resource, T>, bool> = true>
-T *requestResource(
-    std::unordered_map<std::size_t, std::unique_ptr<T>> &resources,
-    A &...args) {
-  std::size_t hash{0U};
-  hashParam(hash, args...);
+template <> struct hash<MultisampleState> {
+  std::size_t operator()(const MultisampleState &state) const {
+    std::size_t result{0};
+    hashParam(result, state.rasterizationSamples);
+    return result;
+  }
+};
 
-  if (auto it = resources.find(hash); it != resources.end()) {
-    return it->second.get();
+template <> struct hash<DepthStencilState> {
+  std::size_t operator()(const DepthStencilState &state) const {
+    std::size_t result{0};
+    hashParam(result, state.depthTestEnable, state.depthWriteEnable,
+              state.depthCompareOp, state.stencilTestEnable);
+    return result;
   }
+};
 
-  auto resource = T::make(args...);
-  if (!resource) { return nullptr; }
+template <> struct hash<ColorBlendState> {
+  std::size_t operator()(const ColorBlendState &state) const {
+    std::size_t result{0};
+    hashParam(result, state.attachments);
+    return result;
+  }
+};
 
-  auto it = resources.emplace(hash, std::move(resource));
-  if (!it.second) { return nullptr; }
+} // namespace std
 
-  return it.first->second.get();
+template <typename T, typename K, typename... A>
+T *requestResource(ResourceKeyMap<K, T> &resources, const auto &key,
+                   A &...args) {
+  return resources.getOrCreate(key, [&]() { return T::make(args...); });
 }
 
-template <typename T, typename... A>
-T *requestResource(
-    std::mutex &mutex,
-    std::unordered_map<std::size_t, std::unique_ptr<T>> &resources,
-    A &...args) {
-  std::lock_guard<std::mutex> guard(mutex);
-  return requestResource(resources, args...);
+ResourceCache::~ResourceCache() {
+  if (!jobSystem) { return; }
+  if (warmupState) {
+    for (size_t i = 0; i < warmupState->shaderModules.size(); ++i) {
+      jobSystem->wait(warmupState->shaderModuleJobs[i]);
+    }
+    for (size_t i = 0; i < warmupState->renderPasses.size(); ++i) {
+      jobSystem->wait(warmupState->renderPassJobs[i]);
+    }
+  }
+  jobSystem->wait(jobs);
 }
 
 ShaderModule *ResourceCache::requestShaderModule(VkShaderStageFlagBits stage,
                                                  const ShaderSource &source,
                                                  const ShaderVariant &variant) {
   std::string entry{"main"};
-  return requestResource(mutex.shaderModule, state.shaderModules, stage, source,
-                         entry, variant);
+  if (auto shaderModule = state.shaderModules.find(
+          std::tie(stage, source.id, entry, variant.getPreamble()))) {
+    return shaderModule;
+  }
+
+  ShaderCache *cache{nullptr};
+  std::shared_ptr<const ShaderPack> pack;
+  {
+    std::lock_guard<std::mutex> guard(mutex.shaderModule);
+    cache = shaderCache.get();
+    pack = shaderPack;
+  }
+  return createShaderModule({stage, source.id, entry, variant.getPreamble()},
+                            source, variant, cache, std::move(pack));
+}
+
+std::shared_future<ShaderModule *>
+ResourceCache::requestShaderModuleAsync(VkShaderStageFlagBits stage,
+                                        const ShaderSource &source,
+                                        const ShaderVariant &variant) {
+  ShaderModuleKey key{stage, source.id, "main", variant.getPreamble()};
+  if (auto shaderModule = state.shaderModules.find(key)) {
+    std::promise<ShaderModule *> promise;
+    promise.set_value(shaderModule);
+    return promise.get_future().share();
+  }
+
+  std::unique_lock<std::mutex> lock(mutex.shaderModule);
+  if (auto it = pendingShaderModules.find(key);
+      it != pendingShaderModules.end()) {
+    return it->second;
+  }
+
+  auto jobSystem = requestJobSystem();
+  if (!jobSystem) { // Fall back to compiling on the calling thread
+    lock.unlock();
+    std::promise<ShaderModule *> promise;
+    promise.set_value(requestShaderModule(stage, source, variant));
+    return promise.get_future().share();
+  }
+
+  // The worker only removes itself from the pending modules under the mutex,
+  // which is held here until its future is registered
+  auto cache = shaderCache.get();
+  auto pack = shaderPack;
+  auto task = [this, key, source, variant, cache, pack]() {
+    auto shaderModule = createShaderModule(key, source, variant, cache, pack);
+
+    std::lock_guard<std::mutex> guard(mutex.shaderModule);
+    pendingShaderModules.erase(key);
+    return shaderModule;
+  };
+  auto future = jobSystem->submit(std::move(task), &jobs).share();
+  pendingShaderModules.emplace(key, future);
+  return future;
+}
+
+DescriptorSetLayout *ResourceCache::requestDescriptorSetLayout(
+    const std::vector<ShaderResource> &resources) {
+  // Only the descriptors matter to the layout, identical sets share one layout
+  // whatever their set number and names
+  std::vector<ShaderResource> bindings;
+  for (const auto &resource : resources) {
+    auto &binding = bindings.emplace_back();
+    binding.type = resource.type;
+    binding.stages = resource.stages;
+    binding.binding = resource.binding;
+    binding.arraySize = resource.arraySize;
+  }
+  return requestResource(state.descriptorSetLayouts, std::tie(bindings),
+                         device, bindings);
+}
+
+// Combine the resources of every stage. A descriptor or push constant range
+// used by several stages is declared once, visible to all of them
+std::vector<ShaderResource>
+mergeShaderResources(const std::vector<ShaderModule *> &shaderModules) {
+  std::vector<ShaderResource> merged;
+  for (auto shaderModule : shaderModules) {
+    for (const auto &resource : shaderModule->getResources()) {
+      if (resource.type == ShaderResourceType::SpecializationConstant) {
+        continue;
+      }
+      auto it = std::find_if(
+          merged.begin(), merged.end(), [&](const ShaderResource &other) {
+            if (resource.type == ShaderResourceType::PushConstant) {
+              return other.type == resource.type &&
+                     other.offset == resource.offset &&
+                     other.size == resource.size;
+            }
+            return other.type != ShaderResourceType::PushConstant &&
+                   other.set == resource.set &&
+                   other.binding == resource.binding;
+          });
+      if (it != merged.end()) {
+        it->stages |= resource.stages;
+      } else {
+        merged.push_back(resource);
+      }
+    }
+  }
+  return merged;
+}
+
+PipelineLayout *ResourceCache::requestPipelineLayout(
+    const std::vector<ShaderModule *> &shaderModules) {
+  // The id is a hash of the SPIR-V, which includes the stage
+  std::vector<uint64_t> ids;
+  for (auto shaderModule : shaderModules) {
+    if (!shaderModule) { return nullptr; }
+    ids.push_back(shaderModule->getId());
+  }
+
+  auto pipelineLayout =
+      state.shaderPipelineLayouts.getOrCreate(std::tie(ids), [&]() {
+        auto pipelineLayout = derivePipelineLayout(shaderModules);
+        if (!pipelineLayout) { return std::unique_ptr<PipelineLayout *>{}; }
+        return std::make_unique<PipelineLayout *>(pipelineLayout);
+      });
+  return pipelineLayout ? *pipelineLayout : nullptr;
+}
+
+PipelineLayout *ResourceCache::derivePipelineLayout(
+    const std::vector<ShaderModule *> &shaderModules) {
+  std::vector<std::vector<ShaderResource>> sets;
+  std::vector<VkPushConstantRange> pushConstantRanges;
+  for (const auto &resource : mergeShaderResources(shaderModules)) {
+    if (resource.type == ShaderResourceType::PushConstant) {
+      if (resource.size > 0) {
+        pushConstantRanges.push_back(
+            {resource.stages, resource.offset, resource.size});
+      }
+      continue;
+    }
+    if (sets.size() <= resource.set) { sets.resize(resource.set + 1); }
+    sets[resource.set].push_back(resource);
+  }
+
+  // Unused set numbers below the highest one get an empty layout
+  std::vector<DescriptorSetLayout *> setLayouts;
+  for (const auto &set : sets) {
+    auto setLayout = requestDescriptorSetLayout(set);
+    if (!setLayout) { return nullptr; }
+    setLayouts.push_back(setLayout);
+  }
+
+  return requestResource(state.pipelineLayouts,
+                         std::tie(setLayouts, pushConstantRanges), device,
+                         setLayouts, pushConstantRanges);
+}
+
+RenderPass *
+ResourceCache::requestRenderPass(const std::vector<Attachment> &attachments,
+                                 const std::vector<SubpassInfo> &subpasses) {
+  return state.renderPasses.getOrCreate(
+      std::tie(attachments, subpasses), [&]() {
+        auto renderPass = RenderPass::make(device, attachments, subpasses);
+        if (renderPass && resourceRecorder) {
+          resourceRecorder->recordRenderPass(frameCount, *renderPass);
+        }
+        return renderPass;
+      });
+}
+
+GraphicsPipeline *
+ResourceCache::requestGraphicsPipeline(const PipelineState &pipelineState) {
+  std::vector<uint64_t> ids;
+  for (auto shaderModule : pipelineState.shaderModules) {
+    if (!shaderModule) { return nullptr; }
+    ids.push_back(shaderModule->getId());
+  }
+
+  auto cache = pipelineCache ? pipelineCache->handle : VK_NULL_HANDLE;
+  auto key = std::tie(ids, pipelineState.pipelineLayout,
+                      pipelineState.renderPass, pipelineState.subpassIndex,
+                      pipelineState.vertexInput, pipelineState.inputAssembly,
+                      pipelineState.rasterization, pipelineState.multisample,
+                      pipelineState.depthStencil, pipelineState.colorBlend);
+  return state.graphicsPipelines.getOrCreate(key, [&]() {
+    auto graphicsPipeline =
+        GraphicsPipeline::make(device, cache, pipelineState);
+    if (graphicsPipeline && resourceRecorder) {
+      resourceRecorder->recordGraphicsPipeline(frameCount, pipelineState);
+    }
+    return graphicsPipeline;
+  });
+}
+
+Framebuffer *ResourceCache::requestFramebuffer(const RenderTarget &renderTarget,
+                                               const RenderPass &renderPass) {
+  // The views identify the target, its address may be reused after a resize
+  std::vector<VkImageView> imageViews;
+  for (const auto &imageView : renderTarget.imageViews) {
+    imageViews.push_back(imageView.handle);
+  }
+  return requestFramebuffer(imageViews, renderTarget.extent, renderPass);
+}
+
+Framebuffer *
+ResourceCache::requestFramebuffer(const std::vector<VkImageView> &imageViews,
+                                  const VkExtent2D &extent,
+                                  const RenderPass &renderPass) {
+  return requestResource(state.framebuffers,
+                         std::tie(imageViews, renderPass.handle), device,
+                         imageViews, extent, renderPass);
 }
 
 void ResourceCache::clearFramebuffers() { state.framebuffers.clear(); }
+
+void ResourceCache::evictFramebuffers(
+    const std::vector<VkImageView> &imageViews) {
+  state.framebuffers.evictIf([&](const FramebufferKey &key) {
+    return std::any_of(std::get<0>(key).begin(), std::get<0>(key).end(),
+                       [&](VkImageView imageView) {
+                         return std::find(imageViews.begin(), imageViews.end(),
+                                          imageView) != imageViews.end();
+                       });
+  });
+}
+
+void ResourceCache::setPipelineCache(
+    std::unique_ptr<PipelineCache> &&pipelineCache) {
+  this->pipelineCache = std::move(pipelineCache);
+}
+
+void ResourceCache::setShaderPack(std::unique_ptr<ShaderPack> &&shaderPack) {
+  std::lock_guard<std::mutex> guard(mutex.shaderModule);
+  this->shaderPack = std::move(shaderPack);
+}
+
+void ResourceCache::setResourceRecorder(
+    std::unique_ptr<ResourceRecorder> &&recorder) {
+  resourceRecorder = std::move(recorder);
+}
+
+void ResourceCache::warmup(const ResourceLog &log) {
+  JobSystem *jobSystem{nullptr};
+  {
+    std::lock_guard<std::mutex> guard(mutex.shaderModule);
+    jobSystem = requestJobSystem();
+  }
+  if (!jobSystem || warmupState) { return; }
+
+  // Records sorted by the frame they were first needed in, as (frame, kind,
+  // index), so that background jobs are taken roughly in that order
+  enum Kind { SHADER_MODULE, RENDER_PASS, GRAPHICS_PIPELINE };
+  std::vector<std::tuple<uint64_t, Kind, size_t>> order;
+  for (size_t i = 0; i < log.shaderModules.size(); ++i) {
+    order.emplace_back(log.shaderModules[i].frame, SHADER_MODULE, i);
+  }
+  for (size_t i = 0; i < log.renderPasses.size(); ++i) {
+    order.emplace_back(log.renderPasses[i].frame, RENDER_PASS, i);
+  }
+  for (size_t i = 0; i < log.graphicsPipelines.size(); ++i) {
+    const auto &record = log.graphicsPipelines[i];
+    auto frame =
+        std::max(record.frame, log.renderPasses[record.renderPass].frame);
+    for (auto index : record.shaderModules) {
+      frame = std::max(frame, log.shaderModules[index].frame);
+    }
+    order.emplace_back(frame, GRAPHICS_PIPELINE, i);
+  }
+  std::sort(order.begin(), order.end());
+
+  warmupState = std::make_unique<Warmup>();
+  auto &warmup = *warmupState;
+  warmup.shaderModules.resize(log.shaderModules.size());
+  warmup.renderPasses.resize(log.renderPasses.size());
+  warmup.shaderModuleJobs =
+      std::make_unique<JobCounter[]>(log.shaderModules.size());
+  warmup.renderPassJobs =
+      std::make_unique<JobCounter[]>(log.renderPasses.size());
+  for (auto [frame, kind, i] : order) {
+    if (kind == SHADER_MODULE) {
+      auto task = [this, &warmup, i, record = log.shaderModules[i]]() {
+        ShaderSource source{};
+        if (!createShaderSource(&source, record.filepath)) { return; }
+        ShaderVariant variant{};
+        variant.addDefinitions(record.definitions);
+        if (requestShaderModule(record.stage, source, variant)) {
+          warmup.shaderModules[i] = ShaderModuleKey{
+              record.stage, source.id, "main", variant.getPreamble()};
+        }
+      };
+      jobSystem->runBackground(std::move(task), &warmup.shaderModuleJobs[i]);
+    } else if (kind == RENDER_PASS) {
+      auto task = [this, &warmup, i, record = log.renderPasses[i]]() {
+        warmup.renderPasses[i] =
+            requestRenderPass(record.attachments, record.subpasses);
+      };
+      jobSystem->runBackground(std::move(task), &warmup.renderPassJobs[i]);
+    } else {
+      const auto &record = log.graphicsPipelines[i];
+      std::vector<JobCounter *> dependencies;
+      for (auto index : record.shaderModules) {
+        dependencies.push_back(&warmup.shaderModuleJobs[index]);
+      }
+      dependencies.push_back(&warmup.renderPassJobs[record.renderPass]);
+      auto task = [this, &warmup, record]() {
+        // No frame uses the modules, update() could evict them meanwhile
+        auto pipelineState = record.state;
+        std::vector<const ShaderModuleKey *> pinned;
+        for (auto index : record.shaderModules) {
+          const auto &key = warmup.shaderModules[index];
+          auto shaderModule = key ? state.shaderModules.pin(*key) : nullptr;
+          if (!shaderModule) { break; }
+          pinned.push_back(&*key);
+          pipelineState.shaderModules.push_back(shaderModule);
+        }
+        pipelineState.renderPass = warmup.renderPasses[record.renderPass];
+        if (pinned.size() == record.shaderModules.size() &&
+            pipelineState.renderPass) {
+          pipelineState.pipelineLayout =
+              requestPipelineLayout(pipelineState.shaderModules);
+          if (pipelineState.pipelineLayout) {
+            requestGraphicsPipeline(pipelineState);
+          }
+        }
+        for (auto key : pinned) { state.shaderModules.unpin(*key); }
+      };
+      jobSystem->runAfterAll(std::move(dependencies), std::move(task), &jobs,
+                             true);
+    }
+  }
+
+  std::cout << "[ResourceCache] Warming up " << log.shaderModules.size()
+            << " shader modules, " << log.renderPasses.size()
+            << " render passes and " << log.graphicsPipelines.size()
+            << " pipelines" << std::endl;
+}
+
+void ResourceCache::setShaderCache(std::unique_ptr<ShaderCache> &&shaderCache) {
+  std::lock_guard<std::mutex> guard(mutex.shaderModule);
+  this->shaderCache = std::move(shaderCache);
+}
+
+bool ResourceCache::enableShaderHotReload() {
+  std::lock_guard<std::mutex> guard(mutex.shaderModule);
+  if (shaderWatcher) { return true; }
+
+  shaderWatcher = ShaderWatcher::make();
+  if (!shaderWatcher) { return false; }
+
+  state.shaderModules.forEach(
+      [&](const ShaderModuleKey &key, ShaderModule *shaderModule) {
+        watchShaderModule(key, *shaderModule);
+      });
+  return true;
+}
+
+void ResourceCache::update(uint64_t submittedValue, uint64_t completedValue) {
+  ++frameCount;
+
+  // The frame being recorded is submitted with the next value
+  auto value = submittedValue + 1;
+  if (shaderWatcher) { reloadShaderModules(value); }
+
+  std::erase_if(retiredShaderModules, [&](const auto &retired) {
+    return retired.first <= completedValue;
+  });
+
+  auto getPipelineEvictions = [&]() {
+    return state.shaderModules.getStats().evictions +
+           state.pipelineLayouts.getStats().evictions +
+           state.graphicsPipelines.getStats().evictions;
+  };
+  auto pipelineEvictions = getPipelineEvictions();
+
+  state.shaderModules.update(value, completedValue);
+  state.descriptorSetLayouts.update(value, completedValue);
+  state.pipelineLayouts.update(value, completedValue);
+  state.shaderPipelineLayouts.update(value, completedValue);
+  state.renderPasses.update(value, completedValue);
+  state.graphicsPipelines.update(value, completedValue);
+  state.framebuffers.update(value, completedValue);
+
+  if (getPipelineEvictions() != pipelineEvictions) { ++pipelineGeneration; }
+}
+
+void ResourceCache::setBudgets(const ResourceCacheBudgets &budgets) {
+  state.shaderModules.setBudget(budgets.shaderModules);
+  state.graphicsPipelines.setBudget(budgets.graphicsPipelines);
+  state.framebuffers.setBudget(budgets.framebuffers);
+}
+
+ResourceCacheStats ResourceCache::getStats() const {
+  ResourceCacheStats stats{};
+  stats.shaderModules = state.shaderModules.getStats();
+  stats.descriptorSetLayouts = state.descriptorSetLayouts.getStats();
+  stats.pipelineLayouts = state.pipelineLayouts.getStats();
+  stats.renderPasses = state.renderPasses.getStats();
+  stats.graphicsPipelines = state.graphicsPipelines.getStats();
+  stats.framebuffers = state.framebuffers.getStats();
+  return stats;
+}
+
+JobSystem *ResourceCache::requestJobSystem() {
+  if (!jobSystem) {
+    ownedJobSystem = JobSystem::make();
+    jobSystem = ownedJobSystem.get();
+  }
+  return jobSystem;
+}
+
+ShaderModule *
+ResourceCache::createShaderModule(const ShaderModuleKey &key,
+                                  const ShaderSource &source,
+                                  const ShaderVariant &variant,
+                                  ShaderCache *cache,
+                                  std::shared_ptr<const ShaderPack> pack) {
+  return state.shaderModules.getOrCreate(key, [&]() {
+    auto shaderModule =
+        ShaderModule::make(std::get<0>(key), source, std::get<2>(key), variant,
+                           cache, std::move(pack));
+    if (shaderModule) {
+      if (resourceRecorder) {
+        resourceRecorder->recordShaderModule(frameCount, *shaderModule);
+      }
+      std::lock_guard<std::mutex> guard(mutex.shaderModule);
+      watchShaderModule(key, *shaderModule);
+    }
+    return shaderModule;
+  });
+}
+
+void ResourceCache::watchShaderModule(const ShaderModuleKey &key,
+                                      const ShaderModule &shaderModule) {
+  if (!shaderWatcher) { return; }
+  for (const auto &filepath : shaderModule.getDependencies()) {
+    shaderDependents[shaderWatcher->watch(filepath)].insert(key);
+  }
+}
+
+void ResourceCache::reloadShaderModules(uint64_t value) {
+  std::lock_guard<std::mutex> guard(mutex.shaderModule);
+
+  for (const auto &filepath : shaderWatcher->takeChanges()) {
+    if (auto it = shaderDependents.find(filepath);
+        it != shaderDependents.end()) {
+      staleShaderModules.insert(it->second.begin(), it->second.end());
+    }
+  }
+
+  // Swap in the modules that finished compiling. The previous module is
+  // retired rather than destroyed, recorded frames may still reference it
+  for (auto it = reloadingShaderModules.begin();
+       it != reloadingShaderModules.end();) {
+    if (it->second.wait_for(std::chrono::seconds(0)) !=
+        std::future_status::ready) {
+      ++it;
+      continue;
+    }
+
+    auto key = it->first;
+    auto shaderModule = it->second.get();
+    it = reloadingShaderModules.erase(it);
+
+    auto current = state.shaderModules.find(key);
+    if (!current) { continue; }
+    if (!shaderModule) {
+      std::cout << "[Shader] Failed to reload " << current->getFilepath()
+                << ", keeping the previous version" << std::endl;
+      continue;
+    }
+
+    std::cout << "[Shader] Reloaded " << shaderModule->getFilepath()
+              << std::endl;
+    watchShaderModule(key, *shaderModule);
+    retiredShaderModules.emplace_back(
+        value, state.shaderModules.replace(key, std::move(shaderModule)));
+    ++pipelineGeneration;
+  }
+
+  // Start recompiling stale modules, one reload per module at a time. A module
+  // modified again while reloading stays stale and is picked up afterwards
+  auto jobSystem = requestJobSystem();
+  if (!jobSystem) { return; }
+  for (auto it = staleShaderModules.begin(); it != staleShaderModules.end();) {
+    const auto &key = *it;
+    auto current = state.shaderModules.find(key);
+    if (!current) {
+      it = staleShaderModules.erase(it);
+      continue;
+    }
+    if (reloadingShaderModules.contains(key)) {
+      ++it;
+      continue;
+    }
+
+    const auto &shaderModule = *current;
+    auto stage = shaderModule.getStage();
+    auto filepath = shaderModule.getFilepath();
+    auto entry = shaderModule.getEntry();
+    auto variant = shaderModule.getVariant();
+    auto cache = shaderCache.get();
+    auto pack = shaderPack;
+    auto task = [stage, filepath, entry, variant, cache, pack]() {
+      ShaderSource source{};
+      if (!createShaderSource(&source, filepath)) {
+        return std::unique_ptr<ShaderModule>{};
+      }
+      return ShaderModule::make(stage, source, entry, variant, cache, pack);
+    };
+    reloadingShaderModules.emplace(key,
+                                   jobSystem->submit(std::move(task), &jobs));
+    it = staleShaderModules.erase(it);
+  }
+}
@@ -1,9 +1,23 @@
 #pragma once
 
+#include "core/job_system.h"
+#include "renderer/descriptor_set_layout.h"
 #include "renderer/framebuffer.h"
+#include "renderer/pipeline.h"
+#include "renderer/pipeline_cache.h"
+#include "renderer/pipeline_layout.h"
+#include "renderer/render_pass.h"
+#include "renderer/resource_map.h"
+#include "renderer/resource_recorder.h"
+#include "renderer/shader_cache.h"
 #include "renderer/shader_module.h"
+#include "renderer/shader_pack.h"
+#include "renderer/shader_watcher.h"
 #include <glm/gtx/hash.hpp>
 #include <mutex>
+#include <optional>
+#include <tuple>
+#include <unordered_set>
 
 template <typename T> inline void hashCombine(size_t &seed, const T &v) {
   std::hash<T> hasher{};
@@ -14,28 +28,228 @@ template <typename T> inline void hashParam(size_t &seed, const T &value) {
   hashCombine(seed, value);
 }
 
+template <typename T>
+inline void hashParam(size_t &seed, const std::vector<T> &values) {
+  for (const auto &value : values) { hashCombine(seed, value); }
+}
+
 template <typename T, typename... Args>
 inline void hashParam(size_t &seed, const T &arg, const Args &...args) {
   hashParam(seed, arg);
   hashParam(seed, args...);
 }
 
+// Hashes a key tuple, or a tuple of references to the same values
+struct ResourceKeyHash {
+  template <typename... K>
+  std::size_t operator()(const std::tuple<K...> &key) const {
+    std::size_t seed{0};
+    std::apply([&](const auto &...values) { hashParam(seed, values...); },
+               key);
+    return seed;
+  }
+};
+
+// Full keys of the cached resources, everything they are made from. The
+// device is the same for the whole cache so it is left out
+using ShaderModuleKey =
+    std::tuple<VkShaderStageFlagBits, uint64_t, std::string, std::string>;
+using DescriptorSetLayoutKey = std::tuple<std::vector<ShaderResource>>;
+using PipelineLayoutKey = std::tuple<std::vector<DescriptorSetLayout *>,
+                                     std::vector<VkPushConstantRange>>;
+// Ids of the shader modules a pipeline layout was derived from
+using ShaderPipelineLayoutKey = std::tuple<std::vector<uint64_t>>;
+using RenderPassKey =
+    std::tuple<std::vector<Attachment>, std::vector<SubpassInfo>>;
+// Shader modules by id, they may be destroyed before the pipeline
+using GraphicsPipelineKey =
+    std::tuple<std::vector<uint64_t>, PipelineLayout *, RenderPass *, uint32_t,
+               VertexInputState, InputAssemblyState, RasterizationState,
+               MultisampleState, DepthStencilState, ColorBlendState>;
+using FramebufferKey = std::tuple<std::vector<VkImageView>, VkRenderPass>;
+
+template <typename Key, typename T>
+using ResourceKeyMap = ResourceMap<Key, T, ResourceKeyHash>;
+
+// Shader modules, pipelines and framebuffers may be evicted. Layouts and
+// render passes are small and referenced by pointer from other keys, they are
+// kept for the lifetime of the cache
+struct ResourceCacheBudgets {
+  ResourceBudget shaderModules{};
+  ResourceBudget graphicsPipelines{};
+  ResourceBudget framebuffers{};
+};
+
+struct ResourceCacheStats {
+  ResourceStats shaderModules{};
+  ResourceStats descriptorSetLayouts{};
+  ResourceStats pipelineLayouts{};
+  ResourceStats renderPasses{};
+  ResourceStats graphicsPipelines{};
+  ResourceStats framebuffers{};
+};
+
 struct ResourceCacheState {
-  std::unordered_map<std::size_t, std::unique_ptr<ShaderModule>> shaderModules;
-  std::unordered_map<std::size_t, std::unique_ptr<Framebuffer>> framebuffers;
+  ResourceKeyMap<ShaderModuleKey, ShaderModule> shaderModules;
+  ResourceKeyMap<DescriptorSetLayoutKey, DescriptorSetLayout>
+      descriptorSetLayouts;
+  ResourceKeyMap<PipelineLayoutKey, PipelineLayout> pipelineLayouts;
+  // Skips merging resources on every request, points into pipelineLayouts
+  ResourceKeyMap<ShaderPipelineLayoutKey, PipelineLayout *>
+      shaderPipelineLayouts;
+  ResourceKeyMap<RenderPassKey, RenderPass> renderPasses;
+  ResourceKeyMap<GraphicsPipelineKey, GraphicsPipeline> graphicsPipelines;
+  ResourceKeyMap<FramebufferKey, Framebuffer> framebuffers;
 };
 
 class ResourceCache {
 public:
+  // Background work runs on `jobSystem`, or on a system of its own made
+  // when first needed
+  explicit ResourceCache(Device &device, JobSystem *jobSystem = nullptr)
+      : device{device}, jobSystem{jobSystem} {}
+
+  // Waits for the jobs it queued
+  ~ResourceCache();
+
+  // Every request is safe to make from any thread. Requests for cached
+  // resources take no lock
   ShaderModule *requestShaderModule(VkShaderStageFlagBits stage,
                                     const ShaderSource &source,
                                     const ShaderVariant &variant = {});
 
+  // Compile on the worker pool. Requests for a module that is already cached
+  // or being compiled share the existing result instead of compiling again,
+  // so callers can fire off a whole batch and wait on the futures afterwards
+  std::shared_future<ShaderModule *>
+  requestShaderModuleAsync(VkShaderStageFlagBits stage,
+                           const ShaderSource &source,
+                           const ShaderVariant &variant = {});
+
+  // Identical sets are shared between layouts, layouts between pipelines
+  DescriptorSetLayout *
+  requestDescriptorSetLayout(const std::vector<ShaderResource> &resources);
+
+  // Derived from the reflected resources of the modules
+  PipelineLayout *
+  requestPipelineLayout(const std::vector<ShaderModule *> &shaderModules);
+
+  RenderPass *requestRenderPass(const std::vector<Attachment> &attachments,
+                                const std::vector<SubpassInfo> &subpasses);
+
+  GraphicsPipeline *requestGraphicsPipeline(const PipelineState &pipelineState);
+
+  Framebuffer *requestFramebuffer(const RenderTarget &renderTarget,
+                                  const RenderPass &renderPass);
+  Framebuffer *requestFramebuffer(const std::vector<VkImageView> &imageViews,
+                                  const VkExtent2D &extent,
+                                  const RenderPass &renderPass);
+
+  // Must not run concurrently with framebuffer requests
   void clearFramebuffers();
+  // Evict the framebuffers of any of the views, before they are destroyed.
+  // Frames in flight may still use them until the frame being recorded
+  // completes
+  void evictFramebuffers(const std::vector<VkImageView> &imageViews);
+
+  // Back pipeline creation with a cache persisted across runs. Set it before
+  // requesting pipelines, it isn't synchronized with their creation
+  void setPipelineCache(std::unique_ptr<PipelineCache> &&pipelineCache);
+
+  // Persist compiled shaders across runs, a null cache disables it
+  void setShaderCache(std::unique_ptr<ShaderCache> &&shaderCache);
+  ShaderCache *getShaderCache() const { return shaderCache.get(); }
+
+  // Serve modules from precompiled SPIR-V when the pack has them
+  void setShaderPack(std::unique_ptr<ShaderPack> &&shaderPack);
+
+  // Record every shader module, render pass and pipeline created from now on.
+  // Set it before requesting them, it isn't synchronized with their creation
+  void setResourceRecorder(std::unique_ptr<ResourceRecorder> &&recorder);
+
+  // Build the resources of a recorded log in the background of the worker
+  // pool, in the order they were first needed, and return without waiting for
+  // them. Requests for a resource that is still being built wait for it rather
+  // than build it. Only the first log is warmed up
+  void warmup(const ResourceLog &log);
+
+  // Watch the files of every shader module, modules whose source changes are
+  // recompiled in the background and swapped in by update()
+  bool enableShaderHotReload();
+
+  // Least recently used resources over budget are evicted by update()
+  void setBudgets(const ResourceCacheBudgets &budgets);
+
+  ResourceCacheStats getStats() const;
+
+  // Changes whenever a shader module is swapped in, or a shader module,
+  // pipeline layout or pipeline is evicted. Commands recorded with pipelines
+  // of an older generation may reference destroyed ones
+  uint64_t getPipelineGeneration() const { return pipelineGeneration; }
+
+  // Call once per frame, before it is recorded, with the last submitted and
+  // the completed timeline values. Replaced and evicted resources are kept
+  // alive until every submission that could still reference them has
+  // completed
+  void update(uint64_t submittedValue, uint64_t completedValue);
 
 private:
+  JobSystem *requestJobSystem();
+  ShaderModule *createShaderModule(const ShaderModuleKey &key,
+                                   const ShaderSource &source,
+                                   const ShaderVariant &variant,
+                                   ShaderCache *cache,
+                                   std::shared_ptr<const ShaderPack> pack);
+  // Must be called with the shader module mutex held
+  void watchShaderModule(const ShaderModuleKey &key,
+                         const ShaderModule &shaderModule);
+  PipelineLayout *
+  derivePipelineLayout(const std::vector<ShaderModule *> &shaderModules);
+  // Retires replaced modules at `value`
+  void reloadShaderModules(uint64_t value);
+
+  Device &device;
   ResourceCacheState state{};
+  std::unique_ptr<PipelineCache> pipelineCache;
+  std::unique_ptr<ShaderCache> shaderCache;
+  std::shared_ptr<const ShaderPack> shaderPack; // Shared with its modules
+  std::unique_ptr<ResourceRecorder> resourceRecorder;
+  std::unordered_map<ShaderModuleKey, std::shared_future<ShaderModule *>,
+                     ResourceKeyHash>
+      pendingShaderModules;
+
+  std::unique_ptr<ShaderWatcher> shaderWatcher;
+  // Canonical file path to the keys of the modules compiled from it
+  std::unordered_map<std::string,
+                     std::unordered_set<ShaderModuleKey, ResourceKeyHash>>
+      shaderDependents;
+  std::unordered_set<ShaderModuleKey, ResourceKeyHash> staleShaderModules;
+  std::unordered_map<ShaderModuleKey,
+                     std::future<std::unique_ptr<ShaderModule>>,
+                     ResourceKeyHash>
+      reloadingShaderModules;
+  // Replaced modules with the timeline value they were replaced at
+  std::vector<std::pair<uint64_t, std::unique_ptr<ShaderModule>>>
+      retiredShaderModules;
+  // Recorded with new resources, read by the workers
+  std::atomic<uint64_t> frameCount{0};
+  std::atomic<uint64_t> pipelineGeneration{0};
+  // Guards the shader module bookkeeping, not the lookups
   struct {
     std::mutex shaderModule;
   } mutex;
+  JobSystem *jobSystem{nullptr};
+  JobCounter jobs; // Queued by the cache and not finished yet
+  // Modules and render passes built by the warmup, by record index. Pipeline
+  // jobs run after the counters of the records they use, and pin the modules
+  // by key, which may have been evicted since
+  struct Warmup {
+    std::vector<std::optional<ShaderModuleKey>> shaderModules;
+    std::vector<RenderPass *> renderPasses;
+    std::unique_ptr<JobCounter[]> shaderModuleJobs;
+    std::unique_ptr<JobCounter[]> renderPassJobs;
+  };
+  std::unique_ptr<Warmup> warmupState;
+  // Declared last so that workers are joined before anything they touch
+  std::unique_ptr<JobSystem> ownedJobSystem;
 };
@@ -0,0 +1,507 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+// Limits past which the least recently used entries are evicted
+struct ResourceBudget {
+  size_t maxCount{std::numeric_limits<size_t>::max()};
+  size_t maxBytes{std::numeric_limits<size_t>::max()}; // See getMemorySize()
+};
+
+struct ResourceStats {
+  uint64_t hits{0};
+  uint64_t misses{0}; // Requests that made the resource
+  uint64_t evictions{0};
+  size_t count{0};
+  size_t bytes{0};
+};
+
+// Hash map for resources that are requested far more often than they are
+// created, from any thread.
+//
+// Finding an existing entry takes no lock: each shard publishes an open
+// addressing table of entries, and grows by copying into a new table. Entries
+// compare their full key, so colliding hashes never return the wrong resource.
+// A missing entry is inserted under the lock of its shard and made outside of
+// it, requests for the same key wait for that one construction instead of
+// making their own.
+//
+// update() evicts the least recently used entries over budget. Entries are
+// stamped with the timeline value of the submission they are used in, only
+// those whose value has completed are evicted, and their memory is released
+// once the value of the frame that evicted them has completed too. Values with
+// a getMemorySize() method count it against the byte budget.
+//
+// Lookups publish the epoch they started in, replaced tables and evicted
+// entries are only freed once every lookup that may still be probing them has
+// finished
+
+// Index of the calling thread among those that ever looked up a resource map
+inline size_t getResourceReaderIndex() {
+  static std::atomic<size_t> nextIndex{0};
+  thread_local size_t index = nextIndex.fetch_add(1, std::memory_order_relaxed);
+  return index;
+}
+
+template <typename Key, typename T, typename Hash = std::hash<Key>,
+          typename KeyEqual = std::equal_to<>>
+struct ResourceMap {
+public:
+  ResourceMap() = default;
+  ResourceMap(const ResourceMap &) = delete;
+  ResourceMap &operator=(const ResourceMap &) = delete;
+
+  // `key` may be any type that hashes and compares like Key, e.g. a tuple of
+  // references, so that hits don't copy it
+  template <typename K> T *find(const K &key) {
+    ReadGuard readGuard{*this};
+    auto hash = Hash{}(key);
+    auto &shard = getShard(hash);
+    auto entry = findEntry(shard, hash, key);
+    if (!entry || entry->state.load(std::memory_order_acquire) != READY) {
+      return nullptr;
+    }
+    touch(shard, *entry);
+    return entry->value.load(std::memory_order_acquire);
+  }
+
+  // `make` returns a std::unique_ptr<T>, null on failure. A failed entry is
+  // made again by the next request
+  template <typename K, typename F> T *getOrCreate(const K &key, F &&make) {
+    ReadGuard readGuard{*this};
+    auto hash = Hash{}(key);
+    auto &shard = getShard(hash);
+    auto entry = findEntry(shard, hash, key);
+    if (!entry) {
+      std::lock_guard<std::mutex> guard(shard.mutex);
+      entry = findEntry(shard, hash, key);
+      if (!entry) { entry = insertEntry(shard, hash, key); }
+    }
+
+    auto state = entry->state.load(std::memory_order_acquire);
+    while (state != READY) {
+      if (state == BUILDING) {
+        entry->state.wait(BUILDING, std::memory_order_acquire);
+        state = entry->state.load(std::memory_order_acquire);
+        continue;
+      }
+      if (!entry->state.compare_exchange_weak(state, BUILDING,
+                                              std::memory_order_acquire)) {
+        continue;
+      }
+
+      shard.misses.fetch_add(1, std::memory_order_relaxed);
+      auto value = make();
+      bool made = value != nullptr;
+      if (made) {
+        entry->size = getMemorySize(*value);
+        shard.count.fetch_add(1, std::memory_order_relaxed);
+        shard.bytes.fetch_add(entry->size, std::memory_order_relaxed);
+        entry->value.store(value.get(), std::memory_order_release);
+        entry->owner = std::move(value);
+      }
+      entry->state.store(made ? READY : EMPTY, std::memory_order_release);
+      entry->state.notify_all();
+      if (!made) { return nullptr; }
+      return entry->value.load(std::memory_order_acquire);
+    }
+    touch(shard, *entry);
+    return entry->value.load(std::memory_order_acquire);
+  }
+
+  // Swap the value of a made entry, returns the previous one or null if there
+  // is no such entry. Callers still holding the previous value must be done
+  // with it before it is destroyed
+  template <typename K>
+  std::unique_ptr<T> replace(const K &key, std::unique_ptr<T> &&value) {
+    if (!value) { return nullptr; }
+
+    auto hash = Hash{}(key);
+    auto &shard = getShard(hash);
+    std::lock_guard<std::mutex> guard(shard.mutex);
+    auto entry = findEntry(shard, hash, key);
+    if (!entry || entry->state.load(std::memory_order_acquire) != READY) {
+      return nullptr;
+    }
+
+    auto size = getMemorySize(*value);
+    shard.bytes.fetch_add(size - entry->size, std::memory_order_relaxed);
+    entry->size = size;
+    entry->value.store(value.get(), std::memory_order_release);
+    std::swap(entry->owner, value);
+    return std::move(value);
+  }
+
+  // Keep a made entry from being evicted until as many unpin() calls, for
+  // values used outside of the frames by jobs that may outlive them. Null if
+  // there is no such entry
+  template <typename K> T *pin(const K &key) {
+    auto hash = Hash{}(key);
+    auto &shard = getShard(hash);
+    std::lock_guard<std::mutex> guard(shard.mutex);
+    auto entry = findEntry(shard, hash, key);
+    if (!entry || entry->state.load(std::memory_order_acquire) != READY) {
+      return nullptr;
+    }
+    ++entry->pins;
+    return entry->value.load(std::memory_order_acquire);
+  }
+
+  template <typename K> void unpin(const K &key) {
+    auto hash = Hash{}(key);
+    auto &shard = getShard(hash);
+    std::lock_guard<std::mutex> guard(shard.mutex);
+    if (auto entry = findEntry(shard, hash, key); entry && entry->pins > 0) {
+      --entry->pins;
+    }
+  }
+
+  // Visit every made entry as (const Key &, T *)
+  template <typename F> void forEach(F &&function) {
+    for (auto &shard : shards) {
+      std::lock_guard<std::mutex> guard(shard.mutex);
+      for (const auto &entry : shard.entries) {
+        if (entry->state.load(std::memory_order_acquire) == READY) {
+          function(entry->key, entry->value.load(std::memory_order_acquire));
+        }
+      }
+    }
+  }
+
+  void setBudget(const ResourceBudget &budget) {
+    std::lock_guard<std::mutex> guard(budgetMutex);
+    this->budget = budget;
+  }
+
+  // Call once per frame, before it is recorded. Entries requested from now
+  // on are stamped with `value`, the timeline value the frame is submitted
+  // with, and those stamped up to `completedValue` are no longer in use
+  void update(uint64_t value, uint64_t completedValue) {
+    std::lock_guard<std::mutex> budgetGuard(budgetMutex);
+    currentValue.store(value, std::memory_order_relaxed);
+
+    auto isRetired = [&](uint64_t retiredValue) {
+      return retiredValue <= completedValue;
+    };
+    size_t count{0};
+    size_t bytes{0};
+    for (auto &shard : shards) {
+      std::lock_guard<std::mutex> guard(shard.mutex);
+      auto safeEpoch = getSafeEpoch();
+      std::erase_if(shard.retiredEntries, [&](const RetiredEntry &retired) {
+        return retired.epoch < safeEpoch && isRetired(retired.value);
+      });
+      std::erase_if(shard.retiredTables, [&](const auto &retired) {
+        return retired.first < safeEpoch;
+      });
+      count += shard.count.load(std::memory_order_relaxed);
+      bytes += shard.bytes.load(std::memory_order_relaxed);
+    }
+    if (count <= budget.maxCount && bytes <= budget.maxBytes) { return; }
+
+    // Misses wait until the eviction is done, hits don't. An entry hit while
+    // being evicted is still destroyed late enough for the current frame
+    std::array<std::unique_lock<std::mutex>, SHARD_COUNT> locks;
+    std::vector<std::tuple<uint64_t, Shard *, Entry *>> candidates;
+    for (size_t i = 0; i < SHARD_COUNT; ++i) {
+      locks[i] = std::unique_lock<std::mutex>(shards[i].mutex);
+      for (const auto &entry : shards[i].entries) {
+        auto lastUse = entry->lastUse.load(std::memory_order_relaxed);
+        if (entry->state.load(std::memory_order_acquire) == READY &&
+            entry->pins == 0 && isRetired(lastUse)) {
+          candidates.emplace_back(lastUse, &shards[i], entry.get());
+        }
+      }
+    }
+    std::sort(candidates.begin(), candidates.end());
+
+    for (auto [lastUse, shard, entry] : candidates) {
+      if (count <= budget.maxCount && bytes <= budget.maxBytes) { break; }
+      count -= 1;
+      bytes -= entry->size;
+      evictEntry(*shard, entry, value);
+    }
+  }
+
+  // Evict the made entries whose key matches, as (const Key &), whatever
+  // their last use. They are released once the value of the frame being
+  // recorded has completed
+  template <typename F> void evictIf(F &&predicate) {
+    std::lock_guard<std::mutex> budgetGuard(budgetMutex);
+    auto value = currentValue.load(std::memory_order_relaxed);
+    for (auto &shard : shards) {
+      std::lock_guard<std::mutex> guard(shard.mutex);
+      std::vector<Entry *> evicted;
+      for (const auto &entry : shard.entries) {
+        if (entry->state.load(std::memory_order_acquire) == READY &&
+            predicate(entry->key)) {
+          evicted.push_back(entry.get());
+        }
+      }
+      for (auto entry : evicted) { evictEntry(shard, entry, value); }
+    }
+  }
+
+  ResourceStats getStats() const {
+    ResourceStats stats{};
+    for (auto &shard : shards) {
+      std::lock_guard<std::mutex> guard(shard.mutex);
+      stats.hits += shard.hits.load(std::memory_order_relaxed);
+      stats.misses += shard.misses.load(std::memory_order_relaxed);
+      stats.evictions += shard.evictions;
+      stats.count += shard.count.load(std::memory_order_relaxed);
+      stats.bytes += shard.bytes.load(std::memory_order_relaxed);
+    }
+    return stats;
+  }
+
+  // Destroys every entry. Must not run concurrently with any other call
+  void clear() {
+    for (auto &shard : shards) {
+      std::lock_guard<std::mutex> guard(shard.mutex);
+      shard.table.store(nullptr, std::memory_order_release);
+      shard.owner.reset();
+      shard.retiredTables.clear();
+      shard.entries.clear();
+      shard.retiredEntries.clear();
+      shard.usedSlots = 0;
+      shard.count.store(0, std::memory_order_relaxed);
+      shard.bytes.store(0, std::memory_order_relaxed);
+    }
+  }
+
+private:
+  enum State : uint32_t { EMPTY, BUILDING, READY };
+
+  struct Entry {
+    Entry(size_t hash, Key &&key) : hash{hash}, key{std::move(key)} {}
+
+    const size_t hash;
+    const Key key;
+    std::atomic<State> state{EMPTY};
+    std::atomic<T *> value{nullptr};
+    std::atomic<uint64_t> lastUse{0};
+    // Written by the builder or under the lock
+    std::unique_ptr<T> owner;
+    size_t size{0};
+    uint32_t pins{0}; // Guarded by the lock
+  };
+
+  struct Table {
+    explicit Table(size_t capacity) : slots(capacity) {}
+
+    std::vector<std::atomic<Entry *>> slots;
+  };
+
+  struct RetiredEntry {
+    uint64_t value{0};
+    uint64_t epoch{0};
+    std::unique_ptr<Entry> entry;
+  };
+
+  // The epoch a lookup started in, zero outside of lookups. Slots of their
+  // own so that lookups on different threads don't share a cache line
+  struct alignas(64) ReaderSlot {
+    std::atomic<uint64_t> epoch{0};
+  };
+
+  // Publishes the epoch of the calling thread for the scope of a lookup.
+  // Nested lookups are covered by the outer one, threads past the slots are
+  // counted instead and hold back every reclamation
+  struct ReadGuard {
+    explicit ReadGuard(const ResourceMap &map) : map{map} {
+      auto index = getResourceReaderIndex();
+      if (index >= MAX_READERS) {
+        overflow = true;
+        map.overflowReaders.fetch_add(1, std::memory_order_relaxed);
+      } else if (map.readers[index].epoch.load(std::memory_order_relaxed) ==
+                 0) {
+        slot = &map.readers[index].epoch;
+        slot->store(map.epoch.load(std::memory_order_relaxed),
+                    std::memory_order_relaxed);
+      }
+      // Published before the tables are read, pairs with getSafeEpoch()
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+    ~ReadGuard() {
+      if (slot) { slot->store(0, std::memory_order_release); }
+      if (overflow) {
+        map.overflowReaders.fetch_sub(1, std::memory_order_release);
+      }
+    }
+
+    const ResourceMap &map;
+    std::atomic<uint64_t> *slot{nullptr};
+    bool overflow{false};
+  };
+
+  struct Shard {
+    mutable std::mutex mutex;
+    std::atomic<Table *> table{nullptr};
+    std::unique_ptr<Table> owner;
+    size_t usedSlots{0}; // Entries and tombstones in the current table
+    std::vector<std::unique_ptr<Entry>> entries;
+    // Lookups may still be probing replaced tables and evicted entries. Tables
+    // are kept by the epoch they were unlinked at, entries also until the
+    // value they were evicted at has completed
+    std::vector<std::pair<uint64_t, std::unique_ptr<Table>>> retiredTables;
+    std::vector<RetiredEntry> retiredEntries;
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+    // Of the made entries, failed ones are made again rather than evicted
+    std::atomic<size_t> count{0};
+    std::atomic<size_t> bytes{0};
+    uint64_t evictions{0};
+  };
+
+  static constexpr size_t SHARD_COUNT = 16;
+  static constexpr size_t MIN_CAPACITY = 16;
+  static constexpr size_t MAX_READERS = 64;
+
+  // Memory unlinked at an epoch before the returned one is no longer read by
+  // any lookup. Unlinking advances the epoch, lookups that start in a later
+  // one can't reach the memory anymore
+  uint64_t getSafeEpoch() const {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (overflowReaders.load(std::memory_order_acquire) != 0) { return 0; }
+    auto safeEpoch = epoch.load(std::memory_order_relaxed);
+    for (const auto &reader : readers) {
+      auto readerEpoch = reader.epoch.load(std::memory_order_acquire);
+      if (readerEpoch != 0) { safeEpoch = std::min(safeEpoch, readerEpoch); }
+    }
+    return safeEpoch;
+  }
+
+  // Call after unlinking, returns the epoch to retire the memory at
+  uint64_t advanceEpoch() {
+    return epoch.fetch_add(1, std::memory_order_seq_cst);
+  }
+
+  // Marks the slot of an evicted entry, probes continue past it
+  static Entry *getTombstone() {
+    return reinterpret_cast<Entry *>(uintptr_t{1});
+  }
+
+  static size_t getMemorySize(const T &value) {
+    if constexpr (requires { value.getMemorySize(); }) {
+      return value.getMemorySize();
+    } else {
+      return 0;
+    }
+  }
+
+  // The top bits of a mixed hash pick the shard, the low bits of the hash
+  // pick the slot, so that the entries of a shard spread over its table
+  Shard &getShard(size_t hash) const {
+    auto mixed = static_cast<uint64_t>(hash) * 0x9e3779b97f4a7c15ULL;
+    return shards[mixed >> (64 - std::countr_zero(SHARD_COUNT))];
+  }
+
+  // Hits only write when the value changed, so entries used every frame
+  // aren't written to by every thread
+  void touch(Shard &shard, Entry &entry) {
+    shard.hits.fetch_add(1, std::memory_order_relaxed);
+    auto value = currentValue.load(std::memory_order_relaxed);
+    if (entry.lastUse.load(std::memory_order_relaxed) != value) {
+      entry.lastUse.store(value, std::memory_order_relaxed);
+    }
+  }
+
+  template <typename K>
+  Entry *findEntry(const Shard &shard, size_t hash, const K &key) const {
+    auto table = shard.table.load(std::memory_order_acquire);
+    if (!table) { return nullptr; }
+
+    auto mask = table->slots.size() - 1;
+    for (auto i = hash & mask;; i = (i + 1) & mask) {
+      auto entry = table->slots[i].load(std::memory_order_acquire);
+      if (!entry) { return nullptr; }
+      if (entry != getTombstone() && entry->hash == hash &&
+          KeyEqual{}(entry->key, key)) {
+        return entry;
+      }
+    }
+  }
+
+  // Must be called with the shard lock held
+  template <typename K>
+  Entry *insertEntry(Shard &shard, size_t hash, const K &key) {
+    // At most half full, counting tombstones, so probes stay short and always
+    // reach an empty slot. Rebuilt tables start at most a quarter full
+    auto table = shard.owner.get();
+    if (!table || (shard.usedSlots + 1) * 2 > table->slots.size()) {
+      auto capacity = MIN_CAPACITY;
+      while ((shard.entries.size() + 1) * 4 > capacity) { capacity *= 2; }
+      auto rebuilt = std::make_unique<Table>(capacity);
+      for (const auto &entry : shard.entries) {
+        placeEntry(*rebuilt, entry.get());
+      }
+      shard.table.store(rebuilt.get(), std::memory_order_release);
+      if (shard.owner) {
+        shard.retiredTables.emplace_back(advanceEpoch(),
+                                         std::move(shard.owner));
+      }
+      shard.owner = std::move(rebuilt);
+      shard.usedSlots = shard.entries.size();
+      table = shard.owner.get();
+    }
+
+    auto entry = std::make_unique<Entry>(hash, Key(key));
+    entry->lastUse.store(currentValue.load(std::memory_order_relaxed),
+                         std::memory_order_relaxed);
+    placeEntry(*table, entry.get());
+    ++shard.usedSlots;
+    shard.entries.push_back(std::move(entry));
+    return shard.entries.back().get();
+  }
+
+  static void placeEntry(Table &table, Entry *entry) {
+    auto mask = table.slots.size() - 1;
+    auto i = entry->hash & mask;
+    while (table.slots[i].load(std::memory_order_relaxed)) {
+      i = (i + 1) & mask;
+    }
+    table.slots[i].store(entry, std::memory_order_release);
+  }
+
+  // Must be called with the shard lock held
+  void evictEntry(Shard &shard, Entry *entry, uint64_t value) {
+    auto &table = *shard.owner;
+    auto mask = table.slots.size() - 1;
+    for (auto i = entry->hash & mask;; i = (i + 1) & mask) {
+      if (table.slots[i].load(std::memory_order_relaxed) == entry) {
+        table.slots[i].store(getTombstone(), std::memory_order_release);
+        break;
+      }
+    }
+
+    auto it = std::find_if(shard.entries.begin(), shard.entries.end(),
+                           [&](const std::unique_ptr<Entry> &other) {
+                             return other.get() == entry;
+                           });
+    shard.retiredEntries.push_back(
+        {.value = value, .epoch = advanceEpoch(), .entry = std::move(*it)});
+    shard.entries.erase(it);
+    shard.count.fetch_sub(1, std::memory_order_relaxed);
+    shard.bytes.fetch_sub(entry->size, std::memory_order_relaxed);
+    ++shard.evictions;
+  }
+
+  mutable std::array<Shard, SHARD_COUNT> shards;
+  mutable std::array<ReaderSlot, MAX_READERS> readers;
+  mutable std::atomic<size_t> overflowReaders{0};
+  std::atomic<uint64_t> epoch{1}; // Zero marks a reader slot as unused
+  std::atomic<uint64_t> currentValue{0};
+  std::mutex budgetMutex; // Serializes update() and setBudget()
+  ResourceBudget budget{};
+};
@@ -0,0 +1,399 @@
+#include "renderer/resource_recorder.h"
+#include "core/file_system.h"
+#include "core/hash.h"
+#include "renderer/shader_module.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <type_traits>
+
+constexpr uint32_t RESOURCE_LOG_MAGIC = 0x4c52454e; // "NERL"
+constexpr uint32_t RESOURCE_LOG_VERSION = 1;
+
+struct ResourceLogFileHeader {
+  uint32_t magic{RESOURCE_LOG_MAGIC};
+  uint32_t version{RESOURCE_LOG_VERSION};
+  uint64_t size{0};     // Bytes of records following the header
+  uint64_t checksum{0}; // Stable hash of the records
+};
+
+// Only types without padding, equal records must serialize to equal bytes
+template <typename T>
+concept Serializable = std::has_unique_object_representations_v<T>;
+
+template <Serializable T> void writeValue(std::string &bytes, const T &value) {
+  bytes.append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template <Serializable T>
+void writeValues(std::string &bytes, const std::vector<T> &values) {
+  writeValue(bytes, static_cast<uint32_t>(values.size()));
+  bytes.append(reinterpret_cast<const char *>(values.data()),
+               values.size() * sizeof(T));
+}
+
+void writeString(std::string &bytes, const std::string &value) {
+  writeValue(bytes, static_cast<uint32_t>(value.size()));
+  bytes.append(value);
+}
+
+struct ByteReader {
+public:
+  explicit ByteReader(std::string_view bytes) : bytes{bytes} {}
+
+  template <Serializable T> bool read(T &value) {
+    if (bytes.size() - offset < sizeof(T)) { return false; }
+    memcpy(&value, bytes.data() + offset, sizeof(T));
+    offset += sizeof(T);
+    return true;
+  }
+
+  template <Serializable T> bool read(std::vector<T> &values) {
+    uint32_t count{0};
+    if (!read(count) || (bytes.size() - offset) / sizeof(T) < count) {
+      return false;
+    }
+    values.resize(count);
+    if (count > 0) {
+      memcpy(values.data(), bytes.data() + offset, count * sizeof(T));
+    }
+    offset += count * sizeof(T);
+    return true;
+  }
+
+  bool read(std::string &value) {
+    uint32_t size{0};
+    if (!read(size) || bytes.size() - offset < size) { return false; }
+    value.assign(bytes.substr(offset, size));
+    offset += size;
+    return true;
+  }
+
+  bool read(std::string_view &value, size_t size) {
+    if (bytes.size() - offset < size) { return false; }
+    value = bytes.substr(offset, size);
+    offset += size;
+    return true;
+  }
+
+  bool empty() const { return offset == bytes.size(); }
+
+private:
+  std::string_view bytes;
+  size_t offset{0};
+};
+
+std::string serialize(const ShaderModuleRecord &record) {
+  std::string bytes;
+  writeValue(bytes, record.stage);
+  writeString(bytes, record.filepath);
+  writeValue(bytes, static_cast<uint32_t>(record.definitions.size()));
+  for (const auto &[identifier, token] : record.definitions) {
+    writeString(bytes, identifier);
+    writeString(bytes, token);
+  }
+  return bytes;
+}
+
+bool deserialize(std::string_view bytes, ShaderModuleRecord &record) {
+  ByteReader reader{bytes};
+  uint32_t count{0};
+  if (!reader.read(record.stage) || !reader.read(record.filepath) ||
+      !reader.read(count)) {
+    return false;
+  }
+  for (uint32_t i = 0; i < count; ++i) {
+    auto &[identifier, token] = record.definitions.emplace_back();
+    if (!reader.read(identifier) || !reader.read(token)) { return false; }
+  }
+  return reader.empty();
+}
+
+std::string serialize(const RenderPassRecord &record) {
+  std::string bytes;
+  writeValues(bytes, record.attachments);
+  writeValue(bytes, static_cast<uint32_t>(record.subpasses.size()));
+  for (const auto &subpass : record.subpasses) {
+    writeValues(bytes, subpass.inputAttachments);
+    writeValues(bytes, subpass.colorAttachments);
+    writeValue(bytes, static_cast<uint8_t>(subpass.depthStencilAttachment));
+  }
+  return bytes;
+}
+
+bool deserialize(std::string_view bytes, RenderPassRecord &record) {
+  ByteReader reader{bytes};
+  uint32_t count{0};
+  if (!reader.read(record.attachments) || !reader.read(count)) {
+    return false;
+  }
+  for (uint32_t i = 0; i < count; ++i) {
+    auto &subpass = record.subpasses.emplace_back();
+    uint8_t depthStencilAttachment{0};
+    if (!reader.read(subpass.inputAttachments) ||
+        !reader.read(subpass.colorAttachments) ||
+        !reader.read(depthStencilAttachment)) {
+      return false;
+    }
+    subpass.depthStencilAttachment = depthStencilAttachment != 0;
+  }
+  return reader.empty();
+}
+
+std::string serialize(const GraphicsPipelineRecord &record) {
+  const auto &state = record.state;
+  std::string bytes;
+  writeValues(bytes, record.shaderModules);
+  writeValue(bytes, record.renderPass);
+  writeValue(bytes, state.subpassIndex);
+  writeValues(bytes, state.vertexInput.bindings);
+  writeValues(bytes, state.vertexInput.attributes);
+  writeValue(bytes, state.inputAssembly);
+  writeValue(bytes, state.rasterization);
+  writeValue(bytes, state.multisample);
+  writeValue(bytes, state.depthStencil);
+  writeValues(bytes, state.colorBlend.attachments);
+  return bytes;
+}
+
+bool deserialize(std::string_view bytes, GraphicsPipelineRecord &record) {
+  auto &state = record.state;
+  ByteReader reader{bytes};
+  return reader.read(record.shaderModules) &&
+         reader.read(record.renderPass) && reader.read(state.subpassIndex) &&
+         reader.read(state.vertexInput.bindings) &&
+         reader.read(state.vertexInput.attributes) &&
+         reader.read(state.inputAssembly) &&
+         reader.read(state.rasterization) && reader.read(state.multisample) &&
+         reader.read(state.depthStencil) &&
+         reader.read(state.colorBlend.attachments) && reader.empty();
+}
+
+// Read the records of one kind, each as its frame, size and serialized bytes
+template <typename Record>
+bool readRecords(ByteReader &reader, std::vector<Record> &records,
+                 std::unordered_map<std::string, uint32_t> &indices) {
+  uint32_t count{0};
+  if (!reader.read(count)) { return false; }
+  for (uint32_t i = 0; i < count; ++i) {
+    uint64_t frame{0};
+    uint32_t size{0};
+    std::string_view bytes;
+    Record record{};
+    if (!reader.read(frame) || !reader.read(size) ||
+        !reader.read(bytes, size) || !deserialize(bytes, record)) {
+      return false;
+    }
+    record.frame = frame;
+    if (!indices.emplace(bytes, records.size()).second) { return false; }
+    records.push_back(std::move(record));
+  }
+  return true;
+}
+
+// Records are appended as they are first needed, so the oldest are dropped
+// first. Resources still in use are recorded again by the next session
+ResourceLog pruneLog(const ResourceLog &log, size_t maxRecords) {
+  const auto &pipelines = log.graphicsPipelines;
+  auto firstPipeline =
+      pipelines.size() - std::min(pipelines.size(), maxRecords);
+  std::vector<bool> keptModules(log.shaderModules.size());
+  std::vector<bool> keptRenderPasses(log.renderPasses.size());
+  for (size_t i = firstPipeline; i < pipelines.size(); ++i) {
+    for (auto index : pipelines[i].shaderModules) { keptModules[index] = true; }
+    keptRenderPasses[pipelines[i].renderPass] = true;
+  }
+  auto keepNewest = [&](std::vector<bool> &kept) {
+    auto count =
+        static_cast<size_t>(std::count(kept.begin(), kept.end(), true));
+    for (size_t i = kept.size(); i-- > 0 && count < maxRecords;) {
+      if (!kept[i]) {
+        kept[i] = true;
+        ++count;
+      }
+    }
+  };
+  keepNewest(keptModules);
+  keepNewest(keptRenderPasses);
+
+  // Index of each kept record in the pruned log
+  auto keep = [](const auto &records, const std::vector<bool> &kept,
+                 auto &keptRecords) {
+    std::vector<uint32_t> indices(records.size());
+    for (size_t i = 0; i < records.size(); ++i) {
+      if (!kept[i]) { continue; }
+      indices[i] = static_cast<uint32_t>(keptRecords.size());
+      keptRecords.push_back(records[i]);
+    }
+    return indices;
+  };
+  ResourceLog pruned{};
+  auto moduleIndices =
+      keep(log.shaderModules, keptModules, pruned.shaderModules);
+  auto renderPassIndices =
+      keep(log.renderPasses, keptRenderPasses, pruned.renderPasses);
+  for (size_t i = firstPipeline; i < pipelines.size(); ++i) {
+    auto &record = pruned.graphicsPipelines.emplace_back(pipelines[i]);
+    for (auto &index : record.shaderModules) { index = moduleIndices[index]; }
+    record.renderPass = renderPassIndices[record.renderPass];
+  }
+  return pruned;
+}
+
+template <typename Record>
+void writeRecords(std::string &bytes, const std::vector<Record> &records) {
+  writeValue(bytes, static_cast<uint32_t>(records.size()));
+  for (const auto &record : records) {
+    auto serialized = serialize(record);
+    writeValue(bytes, record.frame);
+    writeValue(bytes, static_cast<uint32_t>(serialized.size()));
+    bytes.append(serialized);
+  }
+}
+
+std::unique_ptr<ResourceRecorder>
+ResourceRecorder::make(const std::string &filepath, size_t maxRecords) {
+  std::error_code error{};
+  auto directory = std::filesystem::path(filepath).parent_path();
+  if (!directory.empty()) {
+    std::filesystem::create_directories(directory, error);
+  }
+
+  auto resourceRecorder = std::make_unique<ResourceRecorder>();
+  resourceRecorder->filepath = filepath;
+  resourceRecorder->maxRecords = maxRecords;
+
+  std::ifstream fs(filepath, std::ios::binary);
+  if (!fs.is_open()) { return std::move(resourceRecorder); }
+  std::string data{std::istreambuf_iterator<char>(fs),
+                   std::istreambuf_iterator<char>()};
+
+  if (!resourceRecorder->load(data)) {
+    std::cout << "[ResourceRecorder] Discard corrupted " << filepath
+              << std::endl;
+    resourceRecorder->log = {};
+    resourceRecorder->shaderModuleIndices.clear();
+    resourceRecorder->renderPassIndices.clear();
+    resourceRecorder->graphicsPipelineIndices.clear();
+  }
+  return std::move(resourceRecorder);
+}
+
+bool ResourceRecorder::load(std::string_view data) {
+  ResourceLogFileHeader header{};
+  if (data.size() < sizeof(header)) { return false; }
+  memcpy(&header, data.data(), sizeof(header));
+  data.remove_prefix(sizeof(header));
+  if (header.magic != RESOURCE_LOG_MAGIC ||
+      header.version != RESOURCE_LOG_VERSION || header.size != data.size() ||
+      stableHash(data.data(), data.size()) != header.checksum) {
+    return false;
+  }
+
+  ByteReader reader{data};
+  if (!readRecords(reader, log.shaderModules, shaderModuleIndices) ||
+      !readRecords(reader, log.renderPasses, renderPassIndices) ||
+      !readRecords(reader, log.graphicsPipelines, graphicsPipelineIndices) ||
+      !reader.empty()) {
+    return false;
+  }
+
+  for (const auto &record : log.graphicsPipelines) {
+    for (auto index : record.shaderModules) {
+      if (index >= log.shaderModules.size()) { return false; }
+    }
+    if (record.renderPass >= log.renderPasses.size()) { return false; }
+  }
+  return true;
+}
+
+ResourceRecorder::~ResourceRecorder() {
+  if (modified) { save(); }
+}
+
+bool ResourceRecorder::save() {
+  std::string bytes(sizeof(ResourceLogFileHeader), '\0');
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    auto pruned = pruneLog(log, maxRecords);
+    writeRecords(bytes, pruned.shaderModules);
+    writeRecords(bytes, pruned.renderPasses);
+    writeRecords(bytes, pruned.graphicsPipelines);
+    modified = false;
+  }
+
+  ResourceLogFileHeader header{};
+  header.size = bytes.size() - sizeof(header);
+  header.checksum = stableHash(bytes.data() + sizeof(header), header.size);
+  memcpy(bytes.data(), &header, sizeof(header));
+
+  if (!writeFileAtomic(filepath, bytes.data(), bytes.size())) {
+    std::cout << "[ResourceRecorder] Failed to write " << filepath
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+ResourceLog ResourceRecorder::getLog() {
+  std::lock_guard<std::mutex> guard(mutex);
+  return log;
+}
+
+// Must be called with the mutex held
+template <typename Record>
+uint32_t addRecord(Record &&record, std::vector<Record> &records,
+                   std::unordered_map<std::string, uint32_t> &indices,
+                   bool &modified) {
+  auto it = indices.emplace(serialize(record), records.size());
+  if (it.second) {
+    records.push_back(std::move(record));
+    modified = true;
+  }
+  return it.first->second;
+}
+
+uint32_t
+ResourceRecorder::recordShaderModule(uint64_t frame,
+                                     const ShaderModule &shaderModule) {
+  ShaderModuleRecord record{};
+  record.frame = frame;
+  record.stage = shaderModule.getStage();
+  record.filepath = shaderModule.getFilepath();
+  record.definitions = shaderModule.getVariant().getDefinitions();
+
+  std::lock_guard<std::mutex> guard(mutex);
+  return addRecord(std::move(record), log.shaderModules, shaderModuleIndices,
+                   modified);
+}
+
+uint32_t ResourceRecorder::recordRenderPass(uint64_t frame,
+                                            const RenderPass &renderPass) {
+  RenderPassRecord record{};
+  record.frame = frame;
+  record.attachments = renderPass.getAttachments();
+  record.subpasses = renderPass.getSubpasses();
+
+  std::lock_guard<std::mutex> guard(mutex);
+  return addRecord(std::move(record), log.renderPasses, renderPassIndices,
+                   modified);
+}
+
+uint32_t
+ResourceRecorder::recordGraphicsPipeline(uint64_t frame,
+                                         const PipelineState &pipelineState) {
+  GraphicsPipelineRecord record{};
+  record.frame = frame;
+  for (auto shaderModule : pipelineState.shaderModules) {
+    record.shaderModules.push_back(recordShaderModule(frame, *shaderModule));
+  }
+  record.renderPass = recordRenderPass(frame, *pipelineState.renderPass);
+  record.state = pipelineState;
+  record.state.shaderModules.clear();
+  record.state.pipelineLayout = nullptr;
+  record.state.renderPass = nullptr;
+
+  std::lock_guard<std::mutex> guard(mutex);
+  return addRecord(std::move(record), log.graphicsPipelines,
+                   graphicsPipelineIndices, modified);
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "renderer/pipeline_state.h"
+#include "renderer/render_pass.h"
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+struct ShaderModule;
+
+struct ShaderModuleRecord {
+  uint64_t frame{0};
+  VkShaderStageFlagBits stage{};
+  std::string filepath;
+  std::vector<std::pair<std::string, std::string>> definitions;
+};
+
+struct RenderPassRecord {
+  uint64_t frame{0};
+  std::vector<Attachment> attachments;
+  std::vector<SubpassInfo> subpasses;
+};
+
+// Shader modules and render pass are indices into the other records, the
+// pointers of the state are left null
+struct GraphicsPipelineRecord {
+  uint64_t frame{0};
+  std::vector<uint32_t> shaderModules;
+  uint32_t renderPass{0};
+  PipelineState state{};
+};
+
+// Resources requested by past sessions, each at the frame it was first
+// requested in
+struct ResourceLog {
+  std::vector<ShaderModuleRecord> shaderModules;
+  std::vector<RenderPassRecord> renderPasses;
+  std::vector<GraphicsPipelineRecord> graphicsPipelines;
+};
+
+// Log of the resources a session creates, persisted at `filepath` so that
+// the next session can build them before they are needed. New records are
+// appended to the loaded log, which is saved back when destroyed. Saved logs
+// keep the newest `maxRecords` pipelines with the modules and render passes
+// they use, and up to `maxRecords` modules and render passes
+struct ResourceRecorder {
+public:
+  static std::unique_ptr<ResourceRecorder> make(const std::string &filepath,
+                                                size_t maxRecords = 4096);
+
+  ~ResourceRecorder();
+
+  bool save();
+
+  ResourceLog getLog();
+
+  // Each resource is recorded once, at the first frame it is recorded at.
+  // Returns the index of its record
+  uint32_t recordShaderModule(uint64_t frame, const ShaderModule &shaderModule);
+  uint32_t recordRenderPass(uint64_t frame, const RenderPass &renderPass);
+  uint32_t recordGraphicsPipeline(uint64_t frame,
+                                  const PipelineState &pipelineState);
+
+private:
+  bool load(std::string_view data);
+
+  std::string filepath;
+  size_t maxRecords{0};
+  std::mutex mutex;
+  ResourceLog log;
+  // Serialized records to their index, the frame is not part of them
+  std::unordered_map<std::string, uint32_t> shaderModuleIndices;
+  std::unordered_map<std::string, uint32_t> renderPassIndices;
+  std::unordered_map<std::string, uint32_t> graphicsPipelineIndices;
+  bool modified{false};
+};
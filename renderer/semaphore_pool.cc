@@ -2,11 +2,10 @@
 #include "renderer/device.h"
 
 SemaphorePool::~SemaphorePool() {
-  reset();
-  for (auto semaphore : semaphores) {
-    vkDestroySemaphore(device.handle, semaphore, nullptr);
+  auto callbacks = device.getAllocationCallbacks(VK_OBJECT_TYPE_SEMAPHORE);
+  for (auto semaphore : createdSemaphores) {
+    vkDestroySemaphore(device.handle, semaphore, callbacks);
   }
-  semaphores.clear();
 }
 
 bool SemaphorePool::requestOutSemaphore(VkSemaphore &semaphore) {
@@ -15,12 +14,14 @@ bool SemaphorePool::requestOutSemaphore(VkSemaphore &semaphore) {
     semaphores.pop_back();
     return true;
   }
-  // Create one, and don't keep track of it
+  // Create one, owned by the pool until it is destroyed
   VkSemaphoreCreateInfo createInfo{VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
-  if (vkCreateSemaphore(device.handle, &createInfo, nullptr, &semaphore) !=
+  auto callbacks = device.getAllocationCallbacks(VK_OBJECT_TYPE_SEMAPHORE);
+  if (vkCreateSemaphore(device.handle, &createInfo, callbacks, &semaphore) !=
       VK_SUCCESS) {
     return false;
   }
+  createdSemaphores.push_back(semaphore);
   return true;
 }
 
@@ -31,10 +32,12 @@ bool SemaphorePool::requestSemaphore(VkSemaphore &semaphore) {
   }
   VkSemaphore handle{VK_NULL_HANDLE};
   VkSemaphoreCreateInfo createInfo{VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
-  if (vkCreateSemaphore(device.handle, &createInfo, nullptr, &handle) !=
+  auto callbacks = device.getAllocationCallbacks(VK_OBJECT_TYPE_SEMAPHORE);
+  if (vkCreateSemaphore(device.handle, &createInfo, callbacks, &handle) !=
       VK_SUCCESS) {
     return false;
   }
+  createdSemaphores.push_back(handle);
   semaphores.emplace_back(handle);
   ++activeSemaphoreCount;
   semaphore = semaphores.back();
@@ -53,3 +56,16 @@ void SemaphorePool::reset() {
   }
   releasedSemaphores.clear();
 }
+
+bool createTimelineSemaphore(Device &device, VkSemaphore &semaphore) {
+  VkSemaphoreTypeCreateInfo typeCreateInfo{
+      VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO};
+  typeCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+  typeCreateInfo.initialValue = 0;
+  VkSemaphoreCreateInfo createInfo{VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+  createInfo.pNext = &typeCreateInfo;
+  return vkCreateSemaphore(
+             device.handle, &createInfo,
+             device.getAllocationCallbacks(VK_OBJECT_TYPE_SEMAPHORE),
+             &semaphore) == VK_SUCCESS;
+}
@@ -5,6 +5,9 @@
 
 struct Device;
 
+// Semaphores handed out may be released to the pool of another frame. Each
+// pool destroys the semaphores it created, wherever they are, so the pools of
+// the frames are destroyed together
 struct SemaphorePool {
   SemaphorePool(Device &device) : device{device} {}
   ~SemaphorePool();
@@ -15,7 +18,11 @@ struct SemaphorePool {
 
 private:
   Device &device;
+  std::vector<VkSemaphore> createdSemaphores;
   std::vector<VkSemaphore> semaphores;
   std::vector<VkSemaphore> releasedSemaphores;
   uint32_t activeSemaphoreCount{0};
 };
+
+// Starts at 0, signalled and waited on with increasing values
+bool createTimelineSemaphore(Device &device, VkSemaphore &semaphore);
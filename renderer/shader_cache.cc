@@ -0,0 +1,208 @@
+#include "renderer/shader_cache.h"
+#include "core/file_system.h"
+#include "core/hash.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+constexpr uint32_t SHADER_CACHE_MAGIC = 0x5653454e; // "NESV"
+constexpr uint32_t SHADER_CACHE_VERSION = 2;
+constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+constexpr const char *SHADER_CACHE_EXTENSION = ".spv";
+
+struct ShaderCacheHeader {
+  uint32_t magic{SHADER_CACHE_MAGIC};
+  uint32_t version{SHADER_CACHE_VERSION};
+  uint64_t key{0};
+  uint64_t checksum{0}; // Stable hash of everything after the header
+  uint64_t wordCount{0};
+  uint64_t reflectionSize{0}; // Bytes of serialized resources after the spirv
+};
+
+std::unique_ptr<ShaderCache> ShaderCache::make(const std::string &directory,
+                                               uint64_t capacity) {
+  std::error_code error{};
+  std::filesystem::create_directories(directory, error);
+  if (error) {
+    std::cout << "[ShaderCache] Failed to create " << directory << ": "
+              << error.message() << std::endl;
+    return nullptr;
+  }
+
+  uint64_t size{0};
+  for (const auto &entry :
+       std::filesystem::directory_iterator(directory, error)) {
+    if (!entry.is_regular_file()) { continue; }
+    const auto &path = entry.path();
+    if (path.extension() == ".tmp") { // Left over by an interrupted write
+      std::filesystem::remove(path, error);
+    } else if (path.extension() == SHADER_CACHE_EXTENSION) {
+      size += entry.file_size();
+    }
+  }
+
+  auto shaderCache = std::make_unique<ShaderCache>();
+  shaderCache->directory = directory;
+  shaderCache->capacity = capacity;
+  shaderCache->size = size;
+  return std::move(shaderCache);
+}
+
+bool ShaderCache::load(uint64_t key, std::vector<uint32_t> &spirv,
+                       std::vector<ShaderResource> &resources) {
+  auto path = getEntryPath(key);
+
+  std::ifstream fs(path, std::ios::binary | std::ios::ate);
+  if (!fs.is_open()) {
+    std::lock_guard<std::mutex> guard(mutex);
+    ++stats.misses;
+    return false;
+  }
+
+  auto fileSize = static_cast<uint64_t>(fs.tellg());
+  fs.seekg(0);
+
+  ShaderCacheHeader header{};
+  bool valid = fileSize >= sizeof(header) &&
+               fs.read(reinterpret_cast<char *>(&header), sizeof(header)) &&
+               header.magic == SHADER_CACHE_MAGIC &&
+               header.version == SHADER_CACHE_VERSION && header.key == key &&
+               header.wordCount > 0 && header.wordCount <= fileSize &&
+               header.reflectionSize <= fileSize &&
+               fileSize == sizeof(header) +
+                               header.wordCount * sizeof(uint32_t) +
+                               header.reflectionSize;
+
+  if (valid) {
+    std::vector<uint8_t> bytes(fileSize - sizeof(header));
+    auto spirvSize = header.wordCount * sizeof(uint32_t);
+    valid = fs.read(reinterpret_cast<char *>(bytes.data()),
+                    static_cast<std::streamsize>(bytes.size())) &&
+            stableHash(bytes.data(), bytes.size()) == header.checksum &&
+            deserializeShaderResources(bytes.data() + spirvSize,
+                                       header.reflectionSize, resources);
+    if (valid) {
+      spirv.resize(header.wordCount);
+      memcpy(spirv.data(), bytes.data(), spirvSize);
+      valid = spirv[0] == SPIRV_MAGIC;
+    }
+  }
+  fs.close();
+
+  std::lock_guard<std::mutex> guard(mutex);
+  std::error_code error{};
+  if (!valid) {
+    std::cout << "[ShaderCache] Discard corrupted entry " << path << std::endl;
+    spirv.clear();
+    resources.clear();
+    std::filesystem::remove(path, error);
+    if (!error) { size -= std::min(size, fileSize); }
+    ++stats.corruptions;
+    ++stats.misses;
+    return false;
+  }
+
+  // Bump the modification time, it's the recency used by eviction
+  std::filesystem::last_write_time(
+      path, std::filesystem::file_time_type::clock::now(), error);
+  ++stats.hits;
+  return true;
+}
+
+bool ShaderCache::store(uint64_t key, const std::vector<uint32_t> &spirv,
+                        const std::vector<ShaderResource> &resources) {
+  if (spirv.empty()) { return false; }
+
+  std::vector<uint8_t> bytes(sizeof(ShaderCacheHeader) +
+                             spirv.size() * sizeof(uint32_t));
+  memcpy(bytes.data() + sizeof(ShaderCacheHeader), spirv.data(),
+         spirv.size() * sizeof(uint32_t));
+  serializeShaderResources(resources, bytes);
+
+  ShaderCacheHeader header{};
+  header.key = key;
+  header.wordCount = spirv.size();
+  header.reflectionSize = bytes.size() - sizeof(header) -
+                          spirv.size() * sizeof(uint32_t);
+  header.checksum = stableHash(bytes.data() + sizeof(header),
+                               bytes.size() - sizeof(header));
+  memcpy(bytes.data(), &header, sizeof(header));
+
+  auto path = getEntryPath(key);
+
+  std::lock_guard<std::mutex> guard(mutex);
+  std::error_code error{};
+  uint64_t replacedSize{0};
+  if (std::filesystem::exists(path, error)) {
+    replacedSize = std::filesystem::file_size(path, error);
+  }
+  if (!writeFileAtomic(path, bytes.data(), bytes.size())) {
+    std::cout << "[ShaderCache] Failed to write " << path << std::endl;
+    return false;
+  }
+  size = size - std::min(size, replacedSize) + bytes.size();
+  ++stats.stores;
+
+  if (size > capacity) { evict(); }
+  return true;
+}
+
+void ShaderCache::recordLoad(double milliseconds) {
+  std::lock_guard<std::mutex> guard(mutex);
+  stats.loadMilliseconds += milliseconds;
+}
+
+void ShaderCache::recordCompile(double milliseconds) {
+  std::lock_guard<std::mutex> guard(mutex);
+  stats.compileMilliseconds += milliseconds;
+}
+
+ShaderCacheStats ShaderCache::getStats() {
+  std::lock_guard<std::mutex> guard(mutex);
+  return stats;
+}
+
+std::string ShaderCache::getEntryPath(uint64_t key) const {
+  char name[17]{};
+  snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+  return (std::filesystem::path(directory) / name).string() +
+         SHADER_CACHE_EXTENSION;
+}
+
+// Must be called with the mutex held
+void ShaderCache::evict() {
+  struct Entry {
+    std::filesystem::path path;
+    std::filesystem::file_time_type time;
+    uint64_t size;
+  };
+
+  std::error_code error{};
+  std::vector<Entry> entries;
+  uint64_t total{0};
+  for (const auto &entry :
+       std::filesystem::directory_iterator(directory, error)) {
+    if (!entry.is_regular_file() ||
+        entry.path().extension() != SHADER_CACHE_EXTENSION) {
+      continue;
+    }
+    entries.push_back({entry.path(), entry.last_write_time(error),
+                       entry.file_size(error)});
+    total += entries.back().size;
+  }
+
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry &a, const Entry &b) { return a.time < b.time; });
+
+  // Shrink below the capacity with some headroom, so that the next few stores
+  // don't trigger another directory scan
+  uint64_t target = capacity - capacity / 4;
+  for (const auto &entry : entries) {
+    if (total <= target) { break; }
+    if (std::filesystem::remove(entry.path, error)) {
+      total -= entry.size;
+      ++stats.evictions;
+    }
+  }
+  size = total;
+}
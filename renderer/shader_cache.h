@@ -0,0 +1,47 @@
+#pragma once
+
+#include "renderer/shader_reflection.h"
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct ShaderCacheStats {
+  uint32_t hits{0};
+  uint32_t misses{0};
+  uint32_t stores{0};
+  uint32_t evictions{0};
+  uint32_t corruptions{0};
+  double loadMilliseconds{0.0};    // Time spent serving hits
+  double compileMilliseconds{0.0}; // Time spent compiling misses
+};
+
+// Content addressed on-disk store of compiled SPIR-V and its reflection. Each
+// entry lives in its own file named after its key, the directory is kept under
+// `capacity` bytes by evicting the least recently used entries
+struct ShaderCache {
+public:
+  static std::unique_ptr<ShaderCache> make(const std::string &directory,
+                                           uint64_t capacity = 64ULL << 20);
+
+  bool load(uint64_t key, std::vector<uint32_t> &spirv,
+            std::vector<ShaderResource> &resources);
+  bool store(uint64_t key, const std::vector<uint32_t> &spirv,
+             const std::vector<ShaderResource> &resources);
+
+  void recordLoad(double milliseconds);
+  void recordCompile(double milliseconds);
+
+  ShaderCacheStats getStats();
+
+private:
+  std::string getEntryPath(uint64_t key) const;
+  void evict();
+
+  std::string directory;
+  uint64_t capacity{0};
+  uint64_t size{0}; // Bytes currently on disk
+
+  std::mutex mutex;
+  ShaderCacheStats stats{};
+};
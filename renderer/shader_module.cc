@@ -1,67 +1,28 @@
 #include "renderer/shader_module.h"
-#include "core/file_system.h"
+#include "core/hash.h"
 #include "core/string_utils.h"
+#include "renderer/shader_cache.h"
+#include "renderer/shader_pack.h"
 #include <SPIRV/GlslangToSpv.h>
+#include <chrono>
 #include <glslang/Public/ResourceLimits.h>
+#include <glslang/build_info.h>
 #include <iostream>
 
 bool createShaderSource(ShaderSource *shaderSource,
                         const std::string &filepath) {
   std::string source{};
-  if (!readFile(filepath, source)) { return false; }
-
-  std::hash<std::string> hasher{};
-  shaderSource->id = hasher(std::string{source.cbegin(), source.cend()});
+  ShaderIncludeGraph includes{};
+  if (!preprocessShader(filepath, source, includes)) { return false; }
 
+  shaderSource->id = stableHash(source);
   shaderSource->filepath = filepath;
   shaderSource->source = std::move(source);
+  shaderSource->includes = std::move(includes);
 
   return true;
 }
 
-// Pre-compile shader files to include header code
-bool precompileShader(const std::string &source,
-                      std::vector<std::string> &finalSource) {
-  auto lines = split(source, '\n');
-
-  for (auto &line : lines) {
-    trim(line);
-    if (line.find("#include \"") == 0) {
-      std::string includePath = line.substr(10);
-      size_t lastQuote = includePath.find('"');
-      if (!includePath.empty() && lastQuote != std::string::npos) {
-        includePath = includePath.substr(0, lastQuote);
-      }
-
-      std::string code{};
-      if (!readFile(includePath, code)) { return false; }
-
-      std::vector<std::string> includedFile;
-      if (!precompileShader(code, includedFile)) { return false; }
-
-      for (const auto &includedFileLine : includedFile) {
-        finalSource.push_back(includedFileLine);
-      }
-    } else {
-      finalSource.push_back(line);
-    }
-  }
-
-  return true;
-}
-
-std::vector<uint8_t> convertToBytes(std::vector<std::string> &lines) {
-  std::vector<uint8_t> bytes;
-
-  for (auto &line : lines) {
-    line += "\n";
-    std::vector<uint8_t> lineBytes(line.begin(), line.end());
-    bytes.insert(bytes.end(), lineBytes.begin(), lineBytes.end());
-  }
-
-  return bytes;
-}
-
 inline EShLanguage findShaderLanguage(VkShaderStageFlagBits stage) {
   switch (stage) {
   case VK_SHADER_STAGE_VERTEX_BIT:
@@ -111,23 +72,31 @@ inline EShLanguage findShaderLanguage(VkShaderStageFlagBits stage) {
   }
 }
 
-bool compileToSpirv(VkShaderStageFlagBits stage,
-                    const std::vector<uint8_t> &glsl, const std::string &entry,
-                    const ShaderVariant &variant,
+// glslang keeps per-thread state, so every compiling thread initializes the
+// library once and releases its reference when the thread exits
+struct GlslangProcess {
+  GlslangProcess() { glslang::InitializeProcess(); }
+  ~GlslangProcess() { glslang::FinalizeProcess(); }
+};
+
+bool compileToSpirv(VkShaderStageFlagBits stage, std::string_view glsl,
+                    const std::string &entry, const ShaderVariant &variant,
                     std::vector<std::uint32_t> &spirv, std::string &infoLog) {
-  glslang::InitializeProcess(); // Initialize glslang library
+  thread_local GlslangProcess process{};
 
   auto messages = static_cast<EShMessages>(EShMsgDefault | EShMsgVulkanRules |
                                            EShMsgSpvRules);
 
   auto lang = findShaderLanguage(stage);
-  auto source = std::string(glsl.begin(), glsl.end());
 
+  // Hand glslang the expanded source in place, no copy or terminator needed
   const char *fileNames[1] = {""};
-  const char *shaderSource = reinterpret_cast<const char *>(source.data());
+  const char *shaderSource = glsl.data();
+  const int shaderLength = static_cast<int>(glsl.size());
 
   glslang::TShader shader(lang);
-  shader.setStringsWithLengthsAndNames(&shaderSource, nullptr, fileNames, 1);
+  shader.setStringsWithLengthsAndNames(&shaderSource, &shaderLength, fileNames,
+                                       1);
   shader.setEntryPoint(entry.c_str());
   shader.setSourceEntryPoint(entry.c_str());
   shader.setPreamble(variant.getPreamble().c_str());
@@ -178,11 +147,29 @@ bool compileToSpirv(VkShaderStageFlagBits stage,
 
   infoLog += logger.getAllMessages() + "\n";
 
-  glslang::FinalizeProcess(); // Shutdown glslang library
-
   return true;
 }
 
+// Identify a compilation by everything that can change its output, so the key
+// stays valid across runs and invalidates itself when glslang is upgraded
+uint64_t getShaderCacheKey(VkShaderStageFlagBits stage,
+                           const ShaderSource &source,
+                           const std::string &entry,
+                           const ShaderVariant &variant) {
+  auto key = stableHash(source.id); // Already a stable hash of the source
+  key = stableHash(stage, key);
+  key = stableHash(entry, key);
+  key = stableHash(variant.getPreamble(), key);
+  for (const auto &process : variant.getProcesses()) {
+    key = stableHash(process, key);
+  }
+  key = stableHash(glslang::EShTargetSpv_1_5, key);
+  key = stableHash(GLSLANG_VERSION_MAJOR, key);
+  key = stableHash(GLSLANG_VERSION_MINOR, key);
+  key = stableHash(GLSLANG_VERSION_PATCH, key);
+  return stableHash(std::string_view{GLSLANG_VERSION_FLAVOR}, key);
+}
+
 void ShaderVariant::addDefinitions(
     const std::vector<std::pair<std::string, std::string>> &definitions) {
   for (const auto &definition : definitions) { addDefinition(definition); }
@@ -193,6 +180,7 @@ void ShaderVariant::addDefinition(
   const auto &identifier = definition.first;
   const auto &token = definition.second;
 
+  definitions.push_back(definition);
   preamble.append("#define " + identifier + " " + token + "\n");
   processes.emplace_back("D" + identifier + " " + token);
 
@@ -204,29 +192,65 @@ void ShaderVariant::updateId() {
   id = hasher(preamble);
 }
 
-std::unique_ptr<ShaderModule> ShaderModule::make(VkShaderStageFlagBits stage,
-                                                 const ShaderSource &source,
-                                                 const std::string &entry,
-                                                 const ShaderVariant &variant) {
-  std::vector<std::string> finalSource{};
-  if (!precompileShader(source.source, finalSource)) { return nullptr; }
+std::unique_ptr<ShaderModule>
+ShaderModule::make(VkShaderStageFlagBits stage, const ShaderSource &source,
+                   const std::string &entry, const ShaderVariant &variant,
+                   ShaderCache *cache, std::shared_ptr<const ShaderPack> pack) {
+  auto start = std::chrono::steady_clock::now();
+  auto elapsed = [&start]() {
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+  };
 
   std::vector<uint32_t> spirv{};
-  std::string infoLog{};
-  if (!compileToSpirv(stage, convertToBytes(finalSource), entry, variant, spirv,
-                      infoLog)) {
-    std::cout << "[Shader] Make shader module failed: " << infoLog << std::endl;
-    return nullptr;
+  std::span<const uint32_t> packedSpirv{};
+  std::vector<ShaderResource> resources{};
+  uint64_t key{0};
+  if (cache || pack) { key = getShaderCacheKey(stage, source, entry, variant); }
+  if (pack && !pack->find(key, packedSpirv, resources)) { pack.reset(); }
+  if (!pack && cache) {
+    if (cache->load(key, spirv, resources)) { cache->recordLoad(elapsed()); }
   }
 
-  // Generate a unique id, determined by source and variant
-  std::hash<std::string> hasher{};
-  size_t id = hasher(
-      std::string{reinterpret_cast<const char *>(spirv.data()),
-                  reinterpret_cast<const char *>(spirv.data() + spirv.size())});
+  if (!pack && spirv.empty()) {
+    std::string infoLog{};
+    if (!compileToSpirv(stage, source.source, entry, variant, spirv,
+                        infoLog)) {
+      std::cout << "[Shader] Make shader module failed: " << infoLog
+                << std::endl;
+      return nullptr;
+    }
+    if (!reflectShader(stage, spirv, resources)) {
+      std::cout << "[Shader] Failed to reflect " << source.filepath
+                << std::endl;
+      return nullptr;
+    }
+    if (cache) {
+      cache->store(key, spirv, resources);
+      cache->recordCompile(elapsed());
+    }
+  }
 
   auto shaderModule = std::make_unique<ShaderModule>();
-  shaderModule->id = id;
-  shaderModule->spirv = std::move(spirv);
+  if (pack) {
+    shaderModule->spirv = packedSpirv;
+    shaderModule->pack = std::move(pack); // Keeps the mapping alive
+  } else {
+    shaderModule->spirvStorage = std::move(spirv);
+    shaderModule->spirv = shaderModule->spirvStorage;
+  }
+
+  // Id from a stable hash of the SPIR-V words, equal for equal code
+  shaderModule->id = stableHash(shaderModule->spirv.data(),
+                                shaderModule->spirv.size_bytes());
+  shaderModule->stage = stage;
+  shaderModule->entry = entry;
+  shaderModule->variant = variant;
+  shaderModule->filepath = source.filepath;
+  for (const auto &include : source.includes) {
+    shaderModule->dependencies.push_back(include.first);
+  }
+  shaderModule->resources = std::move(resources);
   return std::move(shaderModule);
 }
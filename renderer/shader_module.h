@@ -1,13 +1,18 @@
 #pragma once
 
 #include "renderer/resource.h"
+#include "renderer/shader_preprocessor.h"
+#include "renderer/shader_reflection.h"
+#include <memory>
+#include <span>
 #include <string>
 #include <vulkan/vulkan.h>
 
 struct ShaderSource {
   uint64_t id;
   std::string filepath;
-  std::string source;
+  std::string source; // With every #include expanded
+  ShaderIncludeGraph includes;
 };
 
 bool createShaderSource(ShaderSource *shaderSource,
@@ -20,6 +25,10 @@ public:
   void addDefinition(const std::pair<std::string, std::string> &definition);
 
   uint64_t getId() const { return id; }
+  const std::vector<std::pair<std::string, std::string>> &
+  getDefinitions() const {
+    return definitions;
+  }
   const std::string &getPreamble() const { return preamble; }
   const std::vector<std::string> &getProcesses() const { return processes; }
 
@@ -27,23 +36,56 @@ private:
   void updateId();
 
   uint64_t id{0};
+  std::vector<std::pair<std::string, std::string>> definitions;
   std::string preamble;
   std::vector<std::string> processes;
 };
 
-struct ShaderResource {};
+struct ShaderCache;
+struct ShaderPack;
+
+// Stable key of everything that determines the compiled output, shared by the
+// shader cache and shader packs
+uint64_t getShaderCacheKey(VkShaderStageFlagBits stage,
+                           const ShaderSource &source,
+                           const std::string &entry,
+                           const ShaderVariant &variant);
 
 struct ShaderModule : public Resource {
 public:
   uint64_t getId() const { return id; }
+  VkShaderStageFlagBits getStage() const { return stage; }
+  const std::string &getEntry() const { return entry; }
+  const ShaderVariant &getVariant() const { return variant; }
+  const std::string &getFilepath() const { return filepath; }
+  // Every file the module was compiled from, includes too
+  const std::vector<std::string> &getDependencies() const {
+    return dependencies;
+  }
+  std::span<const uint32_t> getSpirv() const { return spirv; }
+  const std::vector<ShaderResource> &getResources() const { return resources; }
+  // Bytes held by the module, SPIR-V served from a shader pack isn't counted
+  size_t getMemorySize() const {
+    return spirvStorage.size() * sizeof(uint32_t) +
+           resources.size() * sizeof(ShaderResource);
+  }
 
-  static std::unique_ptr<ShaderModule> make(VkShaderStageFlagBits stage,
-                                            const ShaderSource &source,
-                                            const std::string &entry,
-                                            const ShaderVariant &variant);
+  // Served from the pack if it has the module, then the cache, compiled last
+  static std::unique_ptr<ShaderModule>
+  make(VkShaderStageFlagBits stage, const ShaderSource &source,
+       const std::string &entry, const ShaderVariant &variant,
+       ShaderCache *cache = nullptr,
+       std::shared_ptr<const ShaderPack> pack = nullptr);
 
 private:
   uint64_t id{0};
-  std::vector<uint32_t> spirv;
+  VkShaderStageFlagBits stage{};
+  std::string entry;
+  ShaderVariant variant{};
+  std::string filepath;
+  std::vector<std::string> dependencies;
+  std::span<const uint32_t> spirv; // Into the pack or the storage
+  std::vector<uint32_t> spirvStorage;
+  std::shared_ptr<const ShaderPack> pack;
   std::vector<ShaderResource> resources;
 };
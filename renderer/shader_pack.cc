@@ -0,0 +1,156 @@
+#include "renderer/shader_pack.h"
+#include "core/file_system.h"
+#include "core/hash.h"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+constexpr uint32_t SHADER_PACK_MAGIC = 0x5053454e; // "NESP"
+constexpr uint32_t SHADER_PACK_VERSION = 1;
+constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+
+struct ShaderPackHeader {
+  uint32_t magic{SHADER_PACK_MAGIC};
+  uint32_t version{SHADER_PACK_VERSION};
+  uint64_t entryCount{0};
+};
+
+// The reflection data follows the spirv words of the entry
+struct ShaderPackIndexEntry {
+  uint64_t key{0};
+  uint64_t offset{0}; // From the start of the file, 8 bytes aligned
+  uint64_t wordCount{0};
+  uint64_t reflectionSize{0};
+  uint64_t checksum{0}; // Stable hash of the spirv and reflection bytes
+};
+
+std::unique_ptr<ShaderPack> ShaderPack::make(const std::string &filepath) {
+  int fd = open(filepath.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) { return nullptr; }
+
+  struct stat status {};
+  if (fstat(fd, &status) != 0 ||
+      static_cast<size_t>(status.st_size) < sizeof(ShaderPackHeader)) {
+    close(fd);
+    return nullptr;
+  }
+  auto size = static_cast<size_t>(status.st_size);
+
+  // The mapping stays valid after closing the descriptor
+  void *data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) { return nullptr; }
+
+  auto shaderPack = std::make_unique<ShaderPack>();
+  shaderPack->data = data;
+  shaderPack->size = size;
+
+  auto bytes = static_cast<const uint8_t *>(data);
+  ShaderPackHeader header{};
+  memcpy(&header, bytes, sizeof(header));
+  auto indexSize = (size - sizeof(header)) / sizeof(ShaderPackIndexEntry);
+  if (header.magic != SHADER_PACK_MAGIC ||
+      header.version != SHADER_PACK_VERSION || header.entryCount > indexSize) {
+    std::cout << "[ShaderPack] Invalid pack " << filepath << std::endl;
+    return nullptr;
+  }
+
+  std::span<const ShaderPackIndexEntry> index{
+      reinterpret_cast<const ShaderPackIndexEntry *>(bytes + sizeof(header)),
+      header.entryCount};
+  for (size_t i = 0; i < index.size(); ++i) {
+    const auto &entry = index[i];
+    bool valid = entry.offset % sizeof(uint64_t) == 0 && entry.offset <= size &&
+                 entry.wordCount > 0 &&
+                 entry.wordCount <= (size - entry.offset) / sizeof(uint32_t) &&
+                 entry.reflectionSize <=
+                     size - entry.offset - entry.wordCount * sizeof(uint32_t) &&
+                 (i == 0 || index[i - 1].key < entry.key);
+    if (!valid) {
+      std::cout << "[ShaderPack] Invalid pack " << filepath << std::endl;
+      return nullptr;
+    }
+  }
+  shaderPack->index = index;
+
+  std::cout << "[ShaderPack] Mapped " << index.size() << " shaders from "
+            << filepath << std::endl;
+  return std::move(shaderPack);
+}
+
+bool ShaderPack::write(const std::string &filepath,
+                       std::vector<ShaderPackEntry> entries) {
+  std::sort(entries.begin(), entries.end(),
+            [](const ShaderPackEntry &a, const ShaderPackEntry &b) {
+              return a.key < b.key;
+            });
+  entries.erase(std::unique(entries.begin(), entries.end(),
+                            [](const ShaderPackEntry &a,
+                               const ShaderPackEntry &b) {
+                              return a.key == b.key;
+                            }),
+                entries.end());
+
+  ShaderPackHeader header{};
+  header.entryCount = entries.size();
+  std::vector<ShaderPackIndexEntry> index(entries.size());
+  std::vector<uint8_t> bytes(sizeof(header) +
+                             index.size() * sizeof(ShaderPackIndexEntry));
+
+  for (size_t i = 0; i < entries.size(); ++i) {
+    const auto &entry = entries[i];
+    if (entry.spirv.empty() || entry.spirv[0] != SPIRV_MAGIC) { return false; }
+
+    // Aligned so that the mapped words can be used in place
+    auto alignment = sizeof(uint64_t);
+    bytes.resize((bytes.size() + alignment - 1) & ~(alignment - 1));
+    auto offset = bytes.size();
+    auto spirv = reinterpret_cast<const uint8_t *>(entry.spirv.data());
+    bytes.insert(bytes.end(), spirv,
+                 spirv + entry.spirv.size() * sizeof(uint32_t));
+    serializeShaderResources(entry.resources, bytes);
+
+    index[i].key = entry.key;
+    index[i].offset = offset;
+    index[i].wordCount = entry.spirv.size();
+    index[i].reflectionSize =
+        bytes.size() - offset - entry.spirv.size() * sizeof(uint32_t);
+    index[i].checksum =
+        stableHash(bytes.data() + offset, bytes.size() - offset);
+  }
+
+  memcpy(bytes.data(), &header, sizeof(header));
+  memcpy(bytes.data() + sizeof(header), index.data(),
+         index.size() * sizeof(ShaderPackIndexEntry));
+  return writeFileAtomic(filepath, bytes.data(), bytes.size());
+}
+
+ShaderPack::~ShaderPack() {
+  if (data) { munmap(data, size); }
+}
+
+bool ShaderPack::find(uint64_t key, std::span<const uint32_t> &spirv,
+                      std::vector<ShaderResource> &resources) const {
+  auto it = std::lower_bound(
+      index.begin(), index.end(), key,
+      [](const ShaderPackIndexEntry &entry, uint64_t key) {
+        return entry.key < key;
+      });
+  if (it == index.end() || it->key != key) { return false; }
+
+  auto bytes = static_cast<const uint8_t *>(data) + it->offset;
+  auto spirvSize = it->wordCount * sizeof(uint32_t);
+  if (stableHash(bytes, spirvSize + it->reflectionSize) != it->checksum ||
+      !deserializeShaderResources(bytes + spirvSize, it->reflectionSize,
+                                  resources)) {
+    std::cout << "[ShaderPack] Corrupted entry " << key << std::endl;
+    return false;
+  }
+
+  spirv = {reinterpret_cast<const uint32_t *>(bytes), it->wordCount};
+  return true;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "renderer/shader_reflection.h"
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+struct ShaderPackEntry {
+  uint64_t key{0}; // Same key as the shader cache
+  std::vector<uint32_t> spirv;
+  std::vector<ShaderResource> resources;
+};
+
+struct ShaderPackIndexEntry;
+
+// Read-only memory mapping of a pack of precompiled shaders. The SPIR-V of an
+// entry is served straight from the mapping, it lives as long as the pack
+struct ShaderPack {
+public:
+  static std::unique_ptr<ShaderPack> make(const std::string &filepath);
+
+  // Entries are sorted by key in the written file
+  static bool write(const std::string &filepath,
+                    std::vector<ShaderPackEntry> entries);
+
+  ~ShaderPack();
+
+  bool find(uint64_t key, std::span<const uint32_t> &spirv,
+            std::vector<ShaderResource> &resources) const;
+
+  size_t getEntryCount() const { return index.size(); }
+
+private:
+  void *data{nullptr};
+  size_t size{0};
+  std::span<const ShaderPackIndexEntry> index;
+};
@@ -0,0 +1,159 @@
+#include "renderer/shader_preprocessor.h"
+#include "core/file_system.h"
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <mutex>
+
+// A parsed file, its content split at include directives into text spans
+struct ShaderFile {
+  struct Segment {
+    std::string_view text;
+    std::string include; // Included file following the text, if any
+  };
+
+  std::filesystem::file_time_type time{};
+  std::string content;
+  std::vector<Segment> segments; // Views into content
+};
+
+bool parseIncludeDirective(std::string_view line, std::string_view &path) {
+  auto skipWhitespace = [&line]() {
+    auto begin = line.find_first_not_of(" \t");
+    line.remove_prefix(begin == std::string_view::npos ? line.size() : begin);
+  };
+
+  skipWhitespace();
+  if (!line.starts_with('#')) { return false; }
+  line.remove_prefix(1);
+  skipWhitespace();
+  if (!line.starts_with("include")) { return false; }
+  line.remove_prefix(7);
+  skipWhitespace();
+  if (!line.starts_with('"')) { return false; }
+  line.remove_prefix(1);
+  auto end = line.find('"');
+  if (end == std::string_view::npos || end == 0) { return false; }
+  path = line.substr(0, end);
+  return true;
+}
+
+void parseShaderFile(ShaderFile &file) {
+  std::string_view content{file.content};
+  size_t textBegin{0};
+  size_t lineBegin{0};
+  while (lineBegin < content.size()) {
+    auto lineEnd = content.find('\n', lineBegin);
+    if (lineEnd == std::string_view::npos) { lineEnd = content.size(); }
+
+    std::string_view path{};
+    if (parseIncludeDirective(content.substr(lineBegin, lineEnd - lineBegin),
+                              path)) {
+      auto text = content.substr(textBegin, lineBegin - textBegin);
+      file.segments.push_back({text, std::string{path}});
+      textBegin = std::min(lineEnd + 1, content.size());
+    }
+    lineBegin = lineEnd + 1;
+  }
+  file.segments.push_back({content.substr(textBegin), {}});
+}
+
+// Return the parsed file, reading it only if it changed since the last time
+std::shared_ptr<const ShaderFile> requestShaderFile(const std::string &path) {
+  static std::mutex mutex;
+  static std::unordered_map<std::string, std::shared_ptr<const ShaderFile>>
+      files;
+
+  std::error_code error{};
+  auto time = std::filesystem::last_write_time(path, error);
+  if (error) { return nullptr; }
+
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    if (auto it = files.find(path);
+        it != files.end() && it->second->time == time) {
+      return it->second;
+    }
+  }
+
+  auto file = std::make_shared<ShaderFile>();
+  file->time = time;
+  if (!readFile(path, file->content)) { return nullptr; }
+  parseShaderFile(*file);
+
+  std::lock_guard<std::mutex> guard(mutex);
+  files[path] = file;
+  return file;
+}
+
+// Included paths are relative to the file that includes them
+std::string resolveInclude(const std::string &path,
+                           const std::string &include) {
+  auto directory = std::filesystem::path(path).parent_path();
+  return (directory / include).lexically_normal().string();
+}
+
+// Collect the spans making up the expanded source, in order
+bool flattenShaderFile(const std::string &path,
+                       std::vector<std::string> &stack,
+                       std::vector<std::shared_ptr<const ShaderFile>> &files,
+                       std::vector<std::string_view> &spans,
+                       ShaderIncludeGraph &includes) {
+  if (std::find(stack.begin(), stack.end(), path) != stack.end()) {
+    std::cout << "[Shader] Recursive include of " << path << std::endl;
+    return false;
+  }
+
+  auto file = requestShaderFile(path);
+  if (!file) {
+    std::cout << "[Shader] Failed to read " << path << std::endl;
+    return false;
+  }
+  files.push_back(file); // Keep the spans alive while expanding
+
+  bool visited = includes.contains(path);
+  auto &directIncludes = includes[path];
+
+  stack.push_back(path);
+  for (const auto &segment : file->segments) {
+    spans.push_back(segment.text);
+    if (segment.include.empty()) { continue; }
+
+    if (!segment.text.empty() && !segment.text.ends_with('\n')) {
+      spans.emplace_back("\n");
+    }
+    auto include = resolveInclude(path, segment.include);
+    if (!visited && std::find(directIncludes.begin(), directIncludes.end(),
+                              include) == directIncludes.end()) {
+      directIncludes.push_back(include);
+    }
+    if (!flattenShaderFile(include, stack, files, spans, includes)) {
+      return false;
+    }
+  }
+  stack.pop_back();
+
+  if (!spans.empty() && !spans.back().empty() &&
+      !spans.back().ends_with('\n')) {
+    spans.emplace_back("\n");
+  }
+  return true;
+}
+
+bool preprocessShader(const std::string &filepath, std::string &expanded,
+                      ShaderIncludeGraph &includes) {
+  std::vector<std::string> stack;
+  std::vector<std::shared_ptr<const ShaderFile>> files;
+  std::vector<std::string_view> spans;
+  if (!flattenShaderFile(filepath, stack, files, spans, includes)) {
+    return false;
+  }
+
+  size_t size{0};
+  for (auto span : spans) { size += span.size(); }
+
+  expanded.clear();
+  expanded.reserve(size);
+  for (auto span : spans) { expanded.append(span); }
+  return true;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Every file reachable from a shader, mapped to the files it includes directly
+using ShaderIncludeGraph =
+    std::unordered_map<std::string, std::vector<std::string>>;
+
+// Expand the #include "..." directives of the file at `filepath` into one
+// contiguous buffer. Included paths are relative to the including file. Files
+// are parsed once and memoized by path and modification time, so variants and
+// materials sharing headers don't read them from disk again
+bool preprocessShader(const std::string &filepath, std::string &expanded,
+                      ShaderIncludeGraph &includes);
@@ -0,0 +1,478 @@
+#include "renderer/shader_reflection.h"
+#include <algorithm>
+#include <cstring>
+#include <optional>
+#include <tuple>
+
+constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+constexpr size_t SPIRV_HEADER_WORDS = 5;
+
+// Opcodes
+constexpr uint32_t SPIRV_OP_NAME = 5;
+constexpr uint32_t SPIRV_OP_TYPE_BOOL = 20;
+constexpr uint32_t SPIRV_OP_TYPE_INT = 21;
+constexpr uint32_t SPIRV_OP_TYPE_FLOAT = 22;
+constexpr uint32_t SPIRV_OP_TYPE_VECTOR = 23;
+constexpr uint32_t SPIRV_OP_TYPE_MATRIX = 24;
+constexpr uint32_t SPIRV_OP_TYPE_IMAGE = 25;
+constexpr uint32_t SPIRV_OP_TYPE_SAMPLER = 26;
+constexpr uint32_t SPIRV_OP_TYPE_SAMPLED_IMAGE = 27;
+constexpr uint32_t SPIRV_OP_TYPE_ARRAY = 28;
+constexpr uint32_t SPIRV_OP_TYPE_RUNTIME_ARRAY = 29;
+constexpr uint32_t SPIRV_OP_TYPE_STRUCT = 30;
+constexpr uint32_t SPIRV_OP_TYPE_POINTER = 32;
+constexpr uint32_t SPIRV_OP_CONSTANT = 43;
+constexpr uint32_t SPIRV_OP_SPEC_CONSTANT_TRUE = 48;
+constexpr uint32_t SPIRV_OP_SPEC_CONSTANT_FALSE = 49;
+constexpr uint32_t SPIRV_OP_SPEC_CONSTANT = 50;
+constexpr uint32_t SPIRV_OP_VARIABLE = 59;
+constexpr uint32_t SPIRV_OP_DECORATE = 71;
+constexpr uint32_t SPIRV_OP_MEMBER_DECORATE = 72;
+constexpr uint32_t SPIRV_OP_TYPE_ACCELERATION_STRUCTURE = 5341;
+
+// Decorations
+constexpr uint32_t SPIRV_DECORATION_SPEC_ID = 1;
+constexpr uint32_t SPIRV_DECORATION_BUFFER_BLOCK = 3;
+constexpr uint32_t SPIRV_DECORATION_ARRAY_STRIDE = 6;
+constexpr uint32_t SPIRV_DECORATION_MATRIX_STRIDE = 7;
+constexpr uint32_t SPIRV_DECORATION_BINDING = 33;
+constexpr uint32_t SPIRV_DECORATION_DESCRIPTOR_SET = 34;
+constexpr uint32_t SPIRV_DECORATION_OFFSET = 35;
+constexpr uint32_t SPIRV_DECORATION_INPUT_ATTACHMENT_INDEX = 43;
+
+// Storage classes
+constexpr uint32_t SPIRV_STORAGE_UNIFORM_CONSTANT = 0;
+constexpr uint32_t SPIRV_STORAGE_UNIFORM = 2;
+constexpr uint32_t SPIRV_STORAGE_PUSH_CONSTANT = 9;
+constexpr uint32_t SPIRV_STORAGE_STORAGE_BUFFER = 12;
+
+// Image dimensions
+constexpr uint32_t SPIRV_DIM_BUFFER = 5;
+constexpr uint32_t SPIRV_DIM_SUBPASS_DATA = 6;
+
+// Types nest shallowly in practice, deeper means a malformed or cyclic module
+constexpr uint32_t SPIRV_MAX_TYPE_DEPTH = 32;
+constexpr uint32_t SPIRV_MAX_STRUCT_MEMBERS = 16383;
+
+struct SpirvMember {
+  std::optional<uint32_t> offset;
+  std::optional<uint32_t> matrixStride;
+};
+
+// Everything the reflector keeps about one result id
+struct SpirvId {
+  uint32_t opcode{0};
+  uint32_t resultType{0};
+  std::vector<uint32_t> operands; // Words following the result id
+  std::string name;
+  std::optional<uint32_t> set;
+  std::optional<uint32_t> binding;
+  std::optional<uint32_t> inputAttachmentIndex;
+  std::optional<uint32_t> specId;
+  std::optional<uint32_t> arrayStride;
+  bool bufferBlock{false};
+  std::vector<SpirvMember> members;
+};
+
+struct SpirvModule {
+  std::vector<SpirvId> ids;
+
+  const SpirvId *find(uint32_t id) const {
+    return id < ids.size() ? &ids[id] : nullptr;
+  }
+};
+
+std::string readSpirvString(const uint32_t *words, size_t count) {
+  auto chars = reinterpret_cast<const char *>(words);
+  return std::string{chars, strnlen(chars, count * sizeof(uint32_t))};
+}
+
+bool parseSpirv(const std::vector<uint32_t> &spirv, SpirvModule &module) {
+  if (spirv.size() < SPIRV_HEADER_WORDS || spirv[0] != SPIRV_MAGIC) {
+    return false;
+  }
+  auto bound = spirv[3];
+  if (bound > spirv.size()) { return false; } // Every id takes a word at least
+  module.ids.resize(bound);
+
+  size_t offset = SPIRV_HEADER_WORDS;
+  while (offset < spirv.size()) {
+    auto opcode = spirv[offset] & 0xffff;
+    auto wordCount = spirv[offset] >> 16;
+    if (wordCount == 0 || offset + wordCount > spirv.size()) { return false; }
+
+    const uint32_t *operands = spirv.data() + offset + 1;
+    size_t operandCount = wordCount - 1;
+    offset += wordCount;
+
+    switch (opcode) {
+    case SPIRV_OP_NAME: {
+      if (operandCount < 1 || operands[0] >= bound) { return false; }
+      module.ids[operands[0]].name =
+          readSpirvString(operands + 1, operandCount - 1);
+      break;
+    }
+
+    case SPIRV_OP_DECORATE: {
+      if (operandCount < 2 || operands[0] >= bound) { return false; }
+      auto &id = module.ids[operands[0]];
+      auto value = operandCount > 2 ? operands[2] : 0U;
+      switch (operands[1]) {
+      case SPIRV_DECORATION_SPEC_ID: id.specId = value; break;
+      case SPIRV_DECORATION_BUFFER_BLOCK: id.bufferBlock = true; break;
+      case SPIRV_DECORATION_ARRAY_STRIDE: id.arrayStride = value; break;
+      case SPIRV_DECORATION_BINDING: id.binding = value; break;
+      case SPIRV_DECORATION_DESCRIPTOR_SET: id.set = value; break;
+      case SPIRV_DECORATION_INPUT_ATTACHMENT_INDEX:
+        id.inputAttachmentIndex = value;
+        break;
+      default: break;
+      }
+      break;
+    }
+
+    case SPIRV_OP_MEMBER_DECORATE: {
+      if (operandCount < 4 || operands[0] >= bound) { return false; }
+      auto &members = module.ids[operands[0]].members;
+      auto member = operands[1];
+      if (member >= SPIRV_MAX_STRUCT_MEMBERS) { return false; }
+      if (members.size() <= member) { members.resize(member + 1); }
+      if (operands[2] == SPIRV_DECORATION_OFFSET) {
+        members[member].offset = operands[3];
+      } else if (operands[2] == SPIRV_DECORATION_MATRIX_STRIDE) {
+        members[member].matrixStride = operands[3];
+      }
+      break;
+    }
+
+    case SPIRV_OP_TYPE_BOOL:
+    case SPIRV_OP_TYPE_INT:
+    case SPIRV_OP_TYPE_FLOAT:
+    case SPIRV_OP_TYPE_VECTOR:
+    case SPIRV_OP_TYPE_MATRIX:
+    case SPIRV_OP_TYPE_IMAGE:
+    case SPIRV_OP_TYPE_SAMPLER:
+    case SPIRV_OP_TYPE_SAMPLED_IMAGE:
+    case SPIRV_OP_TYPE_ARRAY:
+    case SPIRV_OP_TYPE_RUNTIME_ARRAY:
+    case SPIRV_OP_TYPE_STRUCT:
+    case SPIRV_OP_TYPE_POINTER:
+    case SPIRV_OP_TYPE_ACCELERATION_STRUCTURE: {
+      if (operandCount < 1 || operands[0] >= bound) { return false; }
+      auto &id = module.ids[operands[0]];
+      id.opcode = opcode;
+      id.operands.assign(operands + 1, operands + operandCount);
+      break;
+    }
+
+    case SPIRV_OP_CONSTANT:
+    case SPIRV_OP_SPEC_CONSTANT_TRUE:
+    case SPIRV_OP_SPEC_CONSTANT_FALSE:
+    case SPIRV_OP_SPEC_CONSTANT:
+    case SPIRV_OP_VARIABLE: {
+      if (operandCount < 2 || operands[1] >= bound) { return false; }
+      auto &id = module.ids[operands[1]];
+      id.opcode = opcode;
+      id.resultType = operands[0];
+      id.operands.assign(operands + 2, operands + operandCount);
+      break;
+    }
+
+    default: break;
+    }
+  }
+  return true;
+}
+
+// Size in bytes as laid out in a block, 0 if unknown or runtime sized
+uint32_t getSpirvTypeSize(const SpirvModule &module, uint32_t typeId,
+                          std::optional<uint32_t> matrixStride = {},
+                          uint32_t depth = 0) {
+  auto type = module.find(typeId);
+  if (!type || depth > SPIRV_MAX_TYPE_DEPTH) { return 0; }
+  const auto &operands = type->operands;
+
+  switch (type->opcode) {
+  case SPIRV_OP_TYPE_BOOL: return 4;
+
+  case SPIRV_OP_TYPE_INT:
+  case SPIRV_OP_TYPE_FLOAT:
+    return operands.empty() ? 0 : operands[0] / 8;
+
+  case SPIRV_OP_TYPE_VECTOR:
+    if (operands.size() < 2) { return 0; }
+    return operands[1] *
+           getSpirvTypeSize(module, operands[0], {}, depth + 1);
+
+  case SPIRV_OP_TYPE_MATRIX: {
+    if (operands.size() < 2) { return 0; }
+    auto columnSize = matrixStride.value_or(
+        getSpirvTypeSize(module, operands[0], {}, depth + 1));
+    return operands[1] * columnSize;
+  }
+
+  case SPIRV_OP_TYPE_ARRAY: {
+    if (operands.size() < 2) { return 0; }
+    auto length = module.find(operands[1]);
+    if (!length || length->opcode != SPIRV_OP_CONSTANT ||
+        length->operands.empty()) {
+      return 0;
+    }
+    auto stride = type->arrayStride.value_or(
+        getSpirvTypeSize(module, operands[0], matrixStride, depth + 1));
+    return length->operands[0] * stride;
+  }
+
+  case SPIRV_OP_TYPE_STRUCT: {
+    uint32_t size{0};
+    uint32_t packed{0}; // Used when members carry no offsets
+    for (uint32_t i = 0; i < operands.size(); ++i) {
+      SpirvMember member{};
+      if (i < type->members.size()) { member = type->members[i]; }
+      auto memberSize = getSpirvTypeSize(module, operands[i],
+                                         member.matrixStride, depth + 1);
+      size = std::max(size, member.offset.value_or(packed) + memberSize);
+      packed += memberSize;
+    }
+    return size;
+  }
+
+  default: return 0;
+  }
+}
+
+bool reflectVariable(const SpirvModule &module, const SpirvId &variable,
+                     VkShaderStageFlagBits stage, ShaderResource &resource) {
+  auto pointer = module.find(variable.resultType);
+  if (!pointer || pointer->opcode != SPIRV_OP_TYPE_POINTER ||
+      pointer->operands.size() < 2 || variable.operands.empty()) {
+    return false;
+  }
+  auto storage = variable.operands[0];
+
+  resource.stages = stage;
+  resource.set = variable.set.value_or(0);
+  resource.binding = variable.binding.value_or(0);
+  resource.inputAttachmentIndex = variable.inputAttachmentIndex.value_or(0);
+  resource.name = variable.name;
+
+  // Arrays of descriptors bind several descriptors at one binding
+  auto typeId = pointer->operands[1];
+  auto type = module.find(typeId);
+  auto isArray = [](const SpirvId *type) {
+    return type->opcode == SPIRV_OP_TYPE_ARRAY ||
+           type->opcode == SPIRV_OP_TYPE_RUNTIME_ARRAY;
+  };
+  for (uint32_t depth = 0; type && isArray(type); ++depth) {
+    if (depth > SPIRV_MAX_TYPE_DEPTH || type->operands.empty()) {
+      return false;
+    }
+    if (type->opcode == SPIRV_OP_TYPE_RUNTIME_ARRAY) {
+      resource.arraySize = 0;
+    } else {
+      auto length = type->operands.size() > 1 ? module.find(type->operands[1])
+                                              : nullptr;
+      if (!length || length->operands.empty()) { return false; }
+      resource.arraySize *= length->operands[0];
+    }
+    typeId = type->operands[0];
+    type = module.find(typeId);
+  }
+  if (!type) { return false; }
+
+  switch (storage) {
+  case SPIRV_STORAGE_UNIFORM_CONSTANT:
+    switch (type->opcode) {
+    case SPIRV_OP_TYPE_IMAGE: {
+      if (type->operands.size() < 6) { return false; }
+      auto dim = type->operands[1];
+      auto sampled = type->operands[5]; // 1 sampled, 2 storage
+      if (dim == SPIRV_DIM_SUBPASS_DATA) {
+        resource.type = ShaderResourceType::InputAttachment;
+      } else if (dim == SPIRV_DIM_BUFFER) {
+        resource.type = sampled == 2 ? ShaderResourceType::StorageTexelBuffer
+                                     : ShaderResourceType::UniformTexelBuffer;
+      } else {
+        resource.type = sampled == 2 ? ShaderResourceType::ImageStorage
+                                     : ShaderResourceType::Image;
+      }
+      return true;
+    }
+    case SPIRV_OP_TYPE_SAMPLED_IMAGE:
+      resource.type = ShaderResourceType::ImageSampler;
+      return true;
+    case SPIRV_OP_TYPE_SAMPLER:
+      resource.type = ShaderResourceType::Sampler;
+      return true;
+    case SPIRV_OP_TYPE_ACCELERATION_STRUCTURE:
+      resource.type = ShaderResourceType::AccelerationStructure;
+      return true;
+    default: return false;
+    }
+
+  case SPIRV_STORAGE_UNIFORM:
+    // Storage buffers from before SPIR-V 1.3 are uniform buffer blocks
+    resource.type = type->bufferBlock ? ShaderResourceType::BufferStorage
+                                      : ShaderResourceType::BufferUniform;
+    resource.size = getSpirvTypeSize(module, typeId);
+    return true;
+
+  case SPIRV_STORAGE_STORAGE_BUFFER:
+    resource.type = ShaderResourceType::BufferStorage;
+    resource.size = getSpirvTypeSize(module, typeId);
+    return true;
+
+  case SPIRV_STORAGE_PUSH_CONSTANT: {
+    // The range starts at the first member, the block may skip the bytes
+    // that another stage pushes
+    resource.type = ShaderResourceType::PushConstant;
+    resource.set = 0;
+    resource.binding = 0;
+    resource.arraySize = 1;
+    uint32_t offset{~0U};
+    for (const auto &member : type->members) {
+      if (member.offset) { offset = std::min(offset, *member.offset); }
+    }
+    resource.offset = offset == ~0U ? 0 : offset;
+    auto size = getSpirvTypeSize(module, typeId);
+    resource.size = size > resource.offset ? size - resource.offset : 0;
+    return true;
+  }
+
+  default: return false; // Stage inputs, outputs and private variables
+  }
+}
+
+bool reflectShader(VkShaderStageFlagBits stage,
+                   const std::vector<uint32_t> &spirv,
+                   std::vector<ShaderResource> &resources) {
+  SpirvModule module{};
+  if (!parseSpirv(spirv, module)) { return false; }
+
+  resources.clear();
+  for (const auto &id : module.ids) {
+    if (id.opcode == SPIRV_OP_VARIABLE) {
+      ShaderResource resource{};
+      if (reflectVariable(module, id, stage, resource)) {
+        resources.push_back(std::move(resource));
+      }
+    } else if (id.specId && (id.opcode == SPIRV_OP_SPEC_CONSTANT ||
+                             id.opcode == SPIRV_OP_SPEC_CONSTANT_TRUE ||
+                             id.opcode == SPIRV_OP_SPEC_CONSTANT_FALSE)) {
+      ShaderResource resource{};
+      resource.type = ShaderResourceType::SpecializationConstant;
+      resource.stages = stage;
+      resource.constantId = *id.specId;
+      resource.size = getSpirvTypeSize(module, id.resultType);
+      resource.name = id.name;
+      resources.push_back(std::move(resource));
+    }
+  }
+
+  std::sort(resources.begin(), resources.end(),
+            [](const ShaderResource &a, const ShaderResource &b) {
+              return std::tie(a.type, a.set, a.binding, a.constantId) <
+                     std::tie(b.type, b.set, b.binding, b.constantId);
+            });
+  return true;
+}
+
+bool getDescriptorType(ShaderResourceType type,
+                       VkDescriptorType &descriptorType) {
+  switch (type) {
+  case ShaderResourceType::InputAttachment:
+    descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+    return true;
+  case ShaderResourceType::Image:
+    descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    return true;
+  case ShaderResourceType::ImageSampler:
+    descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    return true;
+  case ShaderResourceType::ImageStorage:
+    descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    return true;
+  case ShaderResourceType::Sampler:
+    descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+    return true;
+  case ShaderResourceType::UniformTexelBuffer:
+    descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+    return true;
+  case ShaderResourceType::StorageTexelBuffer:
+    descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER;
+    return true;
+  case ShaderResourceType::BufferUniform:
+    descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    return true;
+  case ShaderResourceType::BufferStorage:
+    descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    return true;
+  case ShaderResourceType::AccelerationStructure:
+    descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+    return true;
+  default: return false;
+  }
+}
+
+void appendWord(std::vector<uint8_t> &bytes, uint32_t word) {
+  auto begin = reinterpret_cast<const uint8_t *>(&word);
+  bytes.insert(bytes.end(), begin, begin + sizeof(word));
+}
+
+bool readWord(const uint8_t *&data, const uint8_t *end, uint32_t &word) {
+  if (end - data < static_cast<ptrdiff_t>(sizeof(word))) { return false; }
+  memcpy(&word, data, sizeof(word));
+  data += sizeof(word);
+  return true;
+}
+
+void serializeShaderResources(const std::vector<ShaderResource> &resources,
+                              std::vector<uint8_t> &bytes) {
+  appendWord(bytes, static_cast<uint32_t>(resources.size()));
+  for (const auto &resource : resources) {
+    appendWord(bytes, static_cast<uint32_t>(resource.type));
+    appendWord(bytes, resource.stages);
+    appendWord(bytes, resource.set);
+    appendWord(bytes, resource.binding);
+    appendWord(bytes, resource.arraySize);
+    appendWord(bytes, resource.inputAttachmentIndex);
+    appendWord(bytes, resource.offset);
+    appendWord(bytes, resource.size);
+    appendWord(bytes, resource.constantId);
+    appendWord(bytes, static_cast<uint32_t>(resource.name.size()));
+    bytes.insert(bytes.end(), resource.name.begin(), resource.name.end());
+  }
+}
+
+bool deserializeShaderResources(const uint8_t *data, size_t size,
+                                std::vector<ShaderResource> &resources) {
+  auto end = data + size;
+  uint32_t count{0};
+  if (!readWord(data, end, count)) { return false; }
+
+  resources.clear();
+  for (uint32_t i = 0; i < count; ++i) {
+    ShaderResource resource{};
+    uint32_t type{0};
+    uint32_t nameSize{0};
+    if (!readWord(data, end, type) || !readWord(data, end, resource.stages) ||
+        !readWord(data, end, resource.set) ||
+        !readWord(data, end, resource.binding) ||
+        !readWord(data, end, resource.arraySize) ||
+        !readWord(data, end, resource.inputAttachmentIndex) ||
+        !readWord(data, end, resource.offset) ||
+        !readWord(data, end, resource.size) ||
+        !readWord(data, end, resource.constantId) ||
+        !readWord(data, end, nameSize) ||
+        static_cast<size_t>(end - data) < nameSize ||
+        type > static_cast<uint32_t>(
+                   ShaderResourceType::SpecializationConstant)) {
+      return false;
+    }
+    resource.type = static_cast<ShaderResourceType>(type);
+    resource.name.assign(reinterpret_cast<const char *>(data), nameSize);
+    data += nameSize;
+    resources.push_back(std::move(resource));
+  }
+  return data == end;
+}
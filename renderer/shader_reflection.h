@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+enum class ShaderResourceType {
+  InputAttachment,
+  Image,
+  ImageSampler,
+  ImageStorage,
+  Sampler,
+  UniformTexelBuffer,
+  StorageTexelBuffer,
+  BufferUniform,
+  BufferStorage,
+  AccelerationStructure,
+  PushConstant,
+  SpecializationConstant,
+};
+
+struct ShaderResource {
+  ShaderResourceType type{};
+  VkShaderStageFlags stages{0};
+  uint32_t set{0};
+  uint32_t binding{0};
+  uint32_t arraySize{1}; // 0 for runtime sized arrays
+  uint32_t inputAttachmentIndex{0};
+  uint32_t offset{0}; // Push constants
+  uint32_t size{0};   // Push and specialization constants, in bytes
+  uint32_t constantId{0};
+  std::string name;
+
+  bool operator==(const ShaderResource &) const = default;
+};
+
+// Collect the descriptors, push constant blocks and specialization constants
+// declared by a SPIR-V module. Only the instructions needed for that are
+// decoded, returns false if the module is malformed
+bool reflectShader(VkShaderStageFlagBits stage,
+                   const std::vector<uint32_t> &spirv,
+                   std::vector<ShaderResource> &resources);
+
+// False if the resource is not bound through a descriptor
+bool getDescriptorType(ShaderResourceType type,
+                       VkDescriptorType &descriptorType);
+
+void serializeShaderResources(const std::vector<ShaderResource> &resources,
+                              std::vector<uint8_t> &bytes);
+bool deserializeShaderResources(const uint8_t *data, size_t size,
+                                std::vector<ShaderResource> &resources);
@@ -0,0 +1,136 @@
+#include "renderer/shader_watcher.h"
+#include <iostream>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+std::string canonicalPath(const std::string &filepath) {
+  std::error_code error{};
+  auto path = std::filesystem::weakly_canonical(filepath, error);
+  return error ? filepath : path.string();
+}
+
+std::unique_ptr<ShaderWatcher> ShaderWatcher::make() {
+  auto watcher = std::make_unique<ShaderWatcher>();
+
+#ifdef __linux__
+  watcher->inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (watcher->inotifyFd < 0) { return nullptr; }
+  if (pipe(watcher->wakeFds) != 0) { return nullptr; }
+#endif
+
+  watcher->thread = std::thread(&ShaderWatcher::run, watcher.get());
+  return std::move(watcher);
+}
+
+ShaderWatcher::~ShaderWatcher() {
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    stopping = true;
+  }
+  condition.notify_all();
+
+#ifdef __linux__
+  if (wakeFds[1] >= 0) {
+    char wake{1};
+    [[maybe_unused]] auto result = write(wakeFds[1], &wake, 1);
+  }
+#endif
+
+  if (thread.joinable()) { thread.join(); }
+
+#ifdef __linux__
+  for (int fd : {inotifyFd, wakeFds[0], wakeFds[1]}) {
+    if (fd >= 0) { close(fd); }
+  }
+#endif
+}
+
+std::string ShaderWatcher::watch(const std::string &filepath) {
+  auto path = canonicalPath(filepath);
+
+  std::lock_guard<std::mutex> guard(mutex);
+#ifdef __linux__
+  if (!files.insert(path).second) { return path; }
+
+  // Watch the directory rather than the file, editors commonly save by
+  // replacing the file which would silently drop a watch on the file itself
+  auto directory = std::filesystem::path(path).parent_path().string();
+  for (const auto &it : directories) {
+    if (it.second == directory) { return path; }
+  }
+  int wd = inotify_add_watch(inotifyFd, directory.c_str(),
+                             IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+  if (wd < 0) {
+    std::cout << "[ShaderWatcher] Failed to watch " << directory << std::endl;
+    return path;
+  }
+  directories[wd] = directory;
+#else
+  if (!files.contains(path)) {
+    std::error_code error{};
+    files[path] = std::filesystem::last_write_time(path, error);
+  }
+#endif
+  return path;
+}
+
+std::vector<std::string> ShaderWatcher::takeChanges() {
+  std::lock_guard<std::mutex> guard(mutex);
+  std::vector<std::string> result(changes.begin(), changes.end());
+  changes.clear();
+  return result;
+}
+
+void ShaderWatcher::pushChange(const std::string &path) {
+  std::lock_guard<std::mutex> guard(mutex);
+  if (files.contains(path)) { changes.insert(path); }
+}
+
+#ifdef __linux__
+void ShaderWatcher::run() {
+  alignas(inotify_event) char buffer[4096];
+
+  while (true) {
+    pollfd fds[2]{{inotifyFd, POLLIN, 0}, {wakeFds[0], POLLIN, 0}};
+    if (poll(fds, 2, -1) < 0) { continue; }
+    if (fds[1].revents & POLLIN) { return; }
+
+    ssize_t length{0};
+    while ((length = read(inotifyFd, buffer, sizeof(buffer))) > 0) {
+      for (char *p = buffer; p < buffer + length;) {
+        auto event = reinterpret_cast<const inotify_event *>(p);
+        p += sizeof(inotify_event) + event->len;
+        if (event->len == 0) { continue; }
+
+        std::string directory;
+        {
+          std::lock_guard<std::mutex> guard(mutex);
+          auto it = directories.find(event->wd);
+          if (it == directories.end()) { continue; }
+          directory = it->second;
+        }
+        pushChange((std::filesystem::path(directory) / event->name).string());
+      }
+    }
+  }
+}
+#else
+void ShaderWatcher::run() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (!condition.wait_for(lock, std::chrono::milliseconds(250),
+                             [this]() { return stopping; })) {
+    for (auto &[path, time] : files) {
+      std::error_code error{};
+      auto current = std::filesystem::last_write_time(path, error);
+      if (!error && current != time) {
+        time = current;
+        changes.insert(path);
+      }
+    }
+  }
+}
+#endif
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <condition_variable>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Watch shader files for modifications on a background thread. Uses inotify
+// on Linux and falls back to polling modification times elsewhere
+struct ShaderWatcher {
+public:
+  static std::unique_ptr<ShaderWatcher> make();
+
+  ~ShaderWatcher();
+
+  // Returns the canonical path that changes are reported with
+  std::string watch(const std::string &filepath);
+
+  // Files modified since the previous call, without duplicates
+  std::vector<std::string> takeChanges();
+
+private:
+  void run();
+  void pushChange(const std::string &path);
+
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable condition;
+  bool stopping{false};
+  std::unordered_set<std::string> changes;
+
+#ifdef __linux__
+  int inotifyFd{-1};
+  int wakeFds[2]{-1, -1};
+  std::unordered_map<int, std::string> directories; // Watch descriptor to path
+  std::unordered_set<std::string> files;
+#else
+  std::unordered_map<std::string, std::filesystem::file_time_type> files;
+#endif
+};
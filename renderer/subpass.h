@@ -1,8 +1,26 @@
 #pragma once
 
+#include "renderer/pipeline_state.h"
 #include "renderer/render_context.h"
 #include "renderer/shader_module.h"
 
+struct SubMesh;
+
+// A sub mesh drawn by a subpass, with everything its draw was recorded
+// from. Buffers are compared by id, a new one may reuse a freed address
+struct SubpassDraw {
+  const SubMesh *subMesh{nullptr};
+  uint64_t variantId{0};
+  uint64_t vertexBufferId{0};
+  uint64_t indexBufferId{0};
+  VkIndexType indexType{VK_INDEX_TYPE_UINT16};
+  uint32_t indexCount{0};
+  uint32_t firstIndex{0};
+  int32_t vertexOffset{0};
+
+  bool operator==(const SubpassDraw &) const = default;
+};
+
 struct Subpass {
 public:
   Subpass(RenderContext *renderContext, ShaderSource &&vertexShader,
@@ -12,8 +30,39 @@ public:
 
   virtual void prepare() = 0;
 
+  // `pipelineState` comes with the render pass and subpass index set
+  virtual bool draw(CommandBuffer &commandBuffer,
+                    PipelineState &pipelineState) = 0;
+
+  // Draws that can be split over threads, collected once per frame before
+  // any drawRange. Subpasses that record inline only have none
+  virtual size_t prepareDraws() { return 0; }
+
+  // Record `count` draws from `first` into a command buffer of their own.
+  // Ranges are recorded concurrently, each on its own `threadIndex`
+  virtual bool drawRange(CommandBuffer &commandBuffer,
+                         PipelineState &pipelineState, size_t first,
+                         size_t count, size_t threadIndex) {
+    return false;
+  }
+
+  // Static subpasses record their draws once into secondary command buffers
+  // that every frame executes, until the draws, the pipelines or the render
+  // target change. Their draws must not reference per frame resources
+  void setStatic(bool value) { staticDraws = value; }
+  bool isStatic() const { return staticDraws; }
+
+  // The draws of the last prepareDraws(), commands recorded for them stay
+  // valid while they don't change
+  virtual void getDraws(std::vector<SubpassDraw> &draws) const {}
+
+  // Request the pipelines of the draws of the last prepareDraws() again, so
+  // that the cache keeps those of commands recorded in earlier frames
+  virtual bool requestPipelines(PipelineState &pipelineState) { return true; }
+
 protected:
   RenderContext *renderContext{nullptr};
   ShaderSource vertexShader{};
   ShaderSource fragmentShader{};
+  bool staticDraws{false};
 };
@@ -304,7 +304,8 @@ Swapchain::make(Device &device, VkSurfaceKHR surface, const VkExtent2D &extent,
   createInfo.surface = surface;
 
   VkSwapchainKHR handle{VK_NULL_HANDLE};
-  if (vkCreateSwapchainKHR(device.handle, &createInfo, nullptr, &handle) !=
+  auto callbacks = device.getAllocationCallbacks(VK_OBJECT_TYPE_SWAPCHAIN_KHR);
+  if (vkCreateSwapchainKHR(device.handle, &createInfo, callbacks, &handle) !=
       VK_SUCCESS) {
     return nullptr;
   }
@@ -338,7 +339,9 @@ Swapchain::Swapchain(Device *device, VkSurfaceKHR surface)
 
 Swapchain::~Swapchain() {
   images.clear();
-  vkDestroySwapchainKHR(device->handle, handle, nullptr);
+  vkDestroySwapchainKHR(
+      device->handle, handle,
+      device->getAllocationCallbacks(VK_OBJECT_TYPE_SWAPCHAIN_KHR));
 }
 
 VkResult Swapchain::acquireImage(uint32_t &index, VkSemaphore semaphore) {
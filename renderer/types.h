@@ -13,3 +13,36 @@ struct ImageMemoryBarrier {
   uint32_t oldQueueFamily{VK_QUEUE_FAMILY_IGNORED};
   uint32_t newQueueFamily{VK_QUEUE_FAMILY_IGNORED};
 };
+
+// define how an image view is about to be used during command recording,
+// the barrier it needs is derived from how it was used before
+struct ImageUsage {
+  VkImageLayout layout{VK_IMAGE_LAYOUT_UNDEFINED};
+  VkPipelineStageFlags2 stages{VK_PIPELINE_STAGE_2_NONE};
+  VkAccessFlags2 access{VK_ACCESS_2_NONE};
+  bool discard{false}; // The current contents are not needed
+};
+
+// define how a whole buffer is about to be used during command recording
+struct BufferUsage {
+  VkPipelineStageFlags2 stages{VK_PIPELINE_STAGE_2_NONE};
+  VkAccessFlags2 access{VK_ACCESS_2_NONE};
+};
+
+// define memory access for a buffer range during command recording
+struct BufferMemoryBarrier {
+  VkPipelineStageFlags srcStage{VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT};
+  VkPipelineStageFlags dstStage{VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT};
+  VkAccessFlags srcAccess{0};
+  VkAccessFlags dstAccess{0};
+  uint32_t oldQueueFamily{VK_QUEUE_FAMILY_IGNORED};
+  uint32_t newQueueFamily{VK_QUEUE_FAMILY_IGNORED};
+};
+
+// define memory access for every resource during command recording
+struct GlobalMemoryBarrier {
+  VkPipelineStageFlags srcStage{VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT};
+  VkPipelineStageFlags dstStage{VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT};
+  VkAccessFlags srcAccess{0};
+  VkAccessFlags dstAccess{0};
+};
@@ -0,0 +1,401 @@
+#include "renderer/uploader.h"
+#include "renderer/buffer.h"
+#include "renderer/device.h"
+#include "renderer/image.h"
+#include "renderer/semaphore_pool.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+// Suits the texel block size of any format for buffer to image copies
+constexpr VkDeviceSize STAGING_ALIGNMENT = 16;
+
+bool createCommandBuffer(Device &device, uint32_t queueFamilyIndex,
+                         VkCommandPool &commandPool,
+                         VkCommandBuffer &commandBuffer) {
+  VkCommandPoolCreateInfo createInfo{
+      VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+  createInfo.queueFamilyIndex = queueFamilyIndex;
+  createInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  if (vkCreateCommandPool(
+          device.handle, &createInfo,
+          device.getAllocationCallbacks(VK_OBJECT_TYPE_COMMAND_POOL),
+          &commandPool) != VK_SUCCESS) {
+    return false;
+  }
+
+  VkCommandBufferAllocateInfo allocateInfo{
+      VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+  allocateInfo.commandPool = commandPool;
+  allocateInfo.commandBufferCount = 1;
+  allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  return vkAllocateCommandBuffers(device.handle, &allocateInfo,
+                                  &commandBuffer) == VK_SUCCESS;
+}
+
+void destroyCommandPools(Device &device, UploadBatch &batch) {
+  auto callbacks = device.getAllocationCallbacks(VK_OBJECT_TYPE_COMMAND_POOL);
+  vkDestroyCommandPool(device.handle, batch.transferCommandPool, callbacks);
+  vkDestroyCommandPool(device.handle, batch.graphicsCommandPool, callbacks);
+}
+
+bool beginCommandBuffer(VkCommandBuffer commandBuffer) {
+  VkCommandBufferBeginInfo beginInfo{
+      VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  return vkBeginCommandBuffer(commandBuffer, &beginInfo) == VK_SUCCESS;
+}
+
+std::unique_ptr<Uploader> Uploader::make(Device &device,
+                                         const Queue &graphicsQueue,
+                                         VkDeviceSize stagingBlockSize) {
+  if (!device.features.timelineSemaphore) {
+    std::cout << "[Uploader] Timeline semaphores are not supported"
+              << std::endl;
+    return nullptr;
+  }
+
+  const Queue *transferQueue{nullptr};
+  if (!device.getTransferQueue(&transferQueue)) { return nullptr; }
+
+  auto uploader = std::make_unique<Uploader>();
+  uploader->device = &device;
+  uploader->transferQueue = transferQueue;
+  uploader->graphicsQueue = &graphicsQueue;
+  uploader->stagingBlockSize = stagingBlockSize;
+  if (!createTimelineSemaphore(device, uploader->transferSemaphore) ||
+      !createTimelineSemaphore(device, uploader->graphicsSemaphore)) {
+    return nullptr;
+  }
+  return std::move(uploader);
+}
+
+Uploader::~Uploader() {
+  // Batches still in flight must not lose their command buffers
+  if (submittedValue > 0) {
+    VkSemaphore semaphores[] = {transferSemaphore, graphicsSemaphore};
+    uint64_t values[] = {submittedValue, readyValue};
+    VkSemaphoreWaitInfo waitInfo{VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO};
+    waitInfo.semaphoreCount = 2;
+    waitInfo.pSemaphores = semaphores;
+    waitInfo.pValues = values;
+    device->functions.waitSemaphores(device->handle, &waitInfo, UINT64_MAX);
+  }
+
+  auto destroy = [&](std::unique_ptr<UploadBatch> &batch) {
+    if (batch) { destroyCommandPools(*device, *batch); }
+  };
+  destroy(pendingBatch);
+  for (auto &batch : submittedBatches) { destroy(batch); }
+  for (auto &batch : acquiredBatches) { destroy(batch); }
+  for (auto &batch : freeBatches) { destroy(batch); }
+
+  auto callbacks = device->getAllocationCallbacks(VK_OBJECT_TYPE_SEMAPHORE);
+  if (transferSemaphore) {
+    vkDestroySemaphore(device->handle, transferSemaphore, callbacks);
+  }
+  if (graphicsSemaphore) {
+    vkDestroySemaphore(device->handle, graphicsSemaphore, callbacks);
+  }
+}
+
+// Must be called with the mutex held
+bool Uploader::requestBatch() {
+  if (pendingBatch) { return true; }
+
+  std::unique_ptr<UploadBatch> batch;
+  if (!freeBatches.empty()) {
+    batch = std::move(freeBatches.back());
+    freeBatches.pop_back();
+  } else {
+    batch = std::make_unique<UploadBatch>();
+    if (!createCommandBuffer(*device, transferQueue->familyIndex,
+                             batch->transferCommandPool,
+                             batch->transferCommandBuffer) ||
+        !createCommandBuffer(*device, graphicsQueue->familyIndex,
+                             batch->graphicsCommandPool,
+                             batch->graphicsCommandBuffer)) {
+      destroyCommandPools(*device, *batch);
+      return false;
+    }
+  }
+
+  if (!beginCommandBuffer(batch->transferCommandBuffer)) {
+    freeBatches.emplace_back(std::move(batch));
+    return false;
+  }
+  batch->value = submittedValue + 1;
+  pendingBatch = std::move(batch);
+  return true;
+}
+
+// Must be called with the mutex held
+bool Uploader::requestStaging(VkDeviceSize size, Buffer **buffer,
+                              VkDeviceSize &offset) {
+  auto &batch = *pendingBatch;
+  auto alignedOffset = (batch.stagingOffset + STAGING_ALIGNMENT - 1) /
+                       STAGING_ALIGNMENT * STAGING_ALIGNMENT;
+  if (!batch.stagingBuffers.empty() &&
+      alignedOffset + size <= batch.stagingBuffers.back()->size) {
+    *buffer = batch.stagingBuffers.back().get();
+    offset = alignedOffset;
+    batch.stagingOffset = alignedOffset + size;
+    return true;
+  }
+
+  std::unique_ptr<Buffer> stagingBuffer;
+  if (size <= stagingBlockSize && !freeStagingBuffers.empty()) {
+    stagingBuffer = std::move(freeStagingBuffers.back());
+    freeStagingBuffers.pop_back();
+  } else {
+    stagingBuffer = Buffer::make(*device, std::max(size, stagingBlockSize),
+                                 VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    if (!stagingBuffer) { return false; }
+  }
+  *buffer = stagingBuffer.get();
+  offset = 0;
+  batch.stagingOffset = size;
+  batch.stagingBuffers.emplace_back(std::move(stagingBuffer));
+  return true;
+}
+
+bool Uploader::uploadBuffer(const Buffer &buffer, VkDeviceSize offset,
+                            const void *data, VkDeviceSize size,
+                            uint64_t &value) {
+  std::lock_guard<std::mutex> guard(mutex);
+  Buffer *stagingBuffer{nullptr};
+  VkDeviceSize stagingOffset{0};
+  if (!requestBatch() || !requestStaging(size, &stagingBuffer, stagingOffset)) {
+    return false;
+  }
+  memcpy(static_cast<char *>(stagingBuffer->getMapped()) + stagingOffset,
+         data, size);
+
+  auto &batch = *pendingBatch;
+  VkBufferCopy region{stagingOffset, offset, size};
+  vkCmdCopyBuffer(batch.transferCommandBuffer, stagingBuffer->handle,
+                  buffer.handle, 1, &region);
+
+  // Release to the graphics queue family, which acquires the same range
+  if (transferQueue->familyIndex != graphicsQueue->familyIndex) {
+    VkBufferMemoryBarrier barrier{VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER};
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.srcQueueFamilyIndex = transferQueue->familyIndex;
+    barrier.dstQueueFamilyIndex = graphicsQueue->familyIndex;
+    barrier.buffer = buffer.handle;
+    barrier.offset = offset;
+    barrier.size = size;
+    vkCmdPipelineBarrier(batch.transferCommandBuffer,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1,
+                         &barrier, 0, nullptr);
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+    batch.bufferBarriers.push_back(barrier);
+  }
+
+  value = batch.value;
+  return true;
+}
+
+bool Uploader::uploadImage(Image &image, const void *data, VkDeviceSize size,
+                           VkImageLayout newLayout, uint64_t &value) {
+  std::lock_guard<std::mutex> guard(mutex);
+  Buffer *stagingBuffer{nullptr};
+  VkDeviceSize stagingOffset{0};
+  if (!requestBatch() || !requestStaging(size, &stagingBuffer, stagingOffset)) {
+    return false;
+  }
+  memcpy(static_cast<char *>(stagingBuffer->getMapped()) + stagingOffset,
+         data, size);
+
+  auto &batch = *pendingBatch;
+  VkImageMemoryBarrier barrier{VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = image.handle;
+  barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+  vkCmdPipelineBarrier(batch.transferCommandBuffer,
+                       VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &barrier);
+
+  VkBufferImageCopy region{};
+  region.bufferOffset = stagingOffset;
+  region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+  region.imageExtent = {image.extent.width, image.extent.height, 1};
+  vkCmdCopyBufferToImage(batch.transferCommandBuffer, stagingBuffer->handle,
+                         image.handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
+                         &region);
+
+  // The layout transition is part of the release, and repeated by the acquire
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = 0;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.newLayout = newLayout;
+  if (transferQueue->familyIndex != graphicsQueue->familyIndex) {
+    barrier.srcQueueFamilyIndex = transferQueue->familyIndex;
+    barrier.dstQueueFamilyIndex = graphicsQueue->familyIndex;
+  }
+  vkCmdPipelineBarrier(batch.transferCommandBuffer,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &barrier);
+  if (transferQueue->familyIndex != graphicsQueue->familyIndex) {
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+    batch.imageBarriers.push_back(barrier);
+  }
+  batch.imageLayouts.emplace_back(&image, newLayout);
+
+  value = batch.value;
+  return true;
+}
+
+// Must be called with the mutex held
+bool Uploader::submitPending() {
+  if (!pendingBatch || pendingBatch->stagingBuffers.empty()) { return true; }
+  auto &batch = *pendingBatch;
+  if (vkEndCommandBuffer(batch.transferCommandBuffer) != VK_SUCCESS) {
+    return false;
+  }
+
+  VkTimelineSemaphoreSubmitInfo timelineInfo{
+      VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO};
+  timelineInfo.signalSemaphoreValueCount = 1;
+  timelineInfo.pSignalSemaphoreValues = &batch.value;
+
+  VkSubmitInfo submitInfo{VK_STRUCTURE_TYPE_SUBMIT_INFO};
+  submitInfo.pNext = &timelineInfo;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &batch.transferCommandBuffer;
+  submitInfo.signalSemaphoreCount = 1;
+  submitInfo.pSignalSemaphores = &transferSemaphore;
+  if (!transferQueue->submit({submitInfo}, VK_NULL_HANDLE)) { return false; }
+
+  submittedValue = batch.value;
+  submittedBatches.emplace_back(std::move(pendingBatch));
+  return true;
+}
+
+// Must be called with the mutex held. Submit the acquire of each completed
+// transfer to the graphics queue. Its
+// barrier orders every later graphics submission after the copies, and as the
+// transfer has already signalled the wait does not hold the queue up
+bool Uploader::acquireCompleted() {
+  uint64_t completedValue{0};
+  if (device->functions.getSemaphoreCounterValue(
+          device->handle, transferSemaphore, &completedValue) != VK_SUCCESS) {
+    return false;
+  }
+
+  while (!submittedBatches.empty() &&
+         submittedBatches.front()->value <= completedValue) {
+    auto batch = std::move(submittedBatches.front());
+    submittedBatches.pop_front();
+    for (auto &stagingBuffer : batch->stagingBuffers) {
+      if (stagingBuffer->size == stagingBlockSize) {
+        freeStagingBuffers.emplace_back(std::move(stagingBuffer));
+      }
+    }
+    batch->stagingBuffers.clear();
+    batch->stagingOffset = 0;
+
+    auto commandBuffer = batch->graphicsCommandBuffer;
+    if (!beginCommandBuffer(commandBuffer)) { return false; }
+    VkMemoryBarrier memoryBarrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    memoryBarrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                         VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1,
+                         &memoryBarrier, batch->bufferBarriers.size(),
+                         batch->bufferBarriers.data(),
+                         batch->imageBarriers.size(),
+                         batch->imageBarriers.data());
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) { return false; }
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo{
+        VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO};
+    timelineInfo.waitSemaphoreValueCount = 1;
+    timelineInfo.pWaitSemaphoreValues = &batch->value;
+    timelineInfo.signalSemaphoreValueCount = 1;
+    timelineInfo.pSignalSemaphoreValues = &batch->value;
+
+    VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    VkSubmitInfo submitInfo{VK_STRUCTURE_TYPE_SUBMIT_INFO};
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.waitSemaphoreCount = 1;
+    submitInfo.pWaitSemaphores = &transferSemaphore;
+    submitInfo.pWaitDstStageMask = &waitStage;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &graphicsSemaphore;
+    if (!graphicsQueue->submit({submitInfo}, VK_NULL_HANDLE)) { return false; }
+
+    // Graphics work waits for the upload on the queue, not in a barrier.
+    // Image states are only tracked on this thread
+    for (auto [image, layout] : batch->imageLayouts) {
+      image->getState(0, 0) = {.layout = layout};
+    }
+    batch->imageLayouts.clear();
+
+    readyValue = batch->value;
+    acquiredBatches.emplace_back(std::move(batch));
+  }
+  return true;
+}
+
+// Must be called with the mutex held
+void Uploader::recycleAcquired() {
+  uint64_t completedValue{0};
+  if (device->functions.getSemaphoreCounterValue(
+          device->handle, graphicsSemaphore, &completedValue) != VK_SUCCESS) {
+    return;
+  }
+
+  while (!acquiredBatches.empty() &&
+         acquiredBatches.front()->value <= completedValue) {
+    auto batch = std::move(acquiredBatches.front());
+    acquiredBatches.pop_front();
+    vkResetCommandPool(device->handle, batch->transferCommandPool, 0);
+    vkResetCommandPool(device->handle, batch->graphicsCommandPool, 0);
+    batch->bufferBarriers.clear();
+    batch->imageBarriers.clear();
+    freeBatches.emplace_back(std::move(batch));
+  }
+}
+
+bool Uploader::update() {
+  std::lock_guard<std::mutex> guard(mutex);
+  if (!submitPending() || !acquireCompleted()) {
+    std::cout << "[Uploader] Failed to submit uploads" << std::endl;
+    return false;
+  }
+  recycleAcquired();
+  return true;
+}
+
+bool Uploader::wait(uint64_t value) {
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    if (pendingBatch && value >= pendingBatch->value && !submitPending()) {
+      return false;
+    }
+    if (value > submittedValue) { return false; }
+  }
+
+  VkSemaphoreWaitInfo waitInfo{VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO};
+  waitInfo.semaphoreCount = 1;
+  waitInfo.pSemaphores = &transferSemaphore;
+  waitInfo.pValues = &value;
+  if (device->functions.waitSemaphores(device->handle, &waitInfo,
+                                       UINT64_MAX) != VK_SUCCESS) {
+    return false;
+  }
+  return update();
+}
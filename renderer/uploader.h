@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+struct Buffer;
+struct Device;
+struct Image;
+struct Queue;
+
+// Copies recorded in one transfer submission, and the barriers that hand the
+// resources over to the graphics queue once it has completed
+struct UploadBatch {
+  uint64_t value{0}; // Timeline value of the transfer and of the acquire
+  VkCommandPool transferCommandPool{VK_NULL_HANDLE};
+  VkCommandBuffer transferCommandBuffer{VK_NULL_HANDLE};
+  VkCommandPool graphicsCommandPool{VK_NULL_HANDLE};
+  VkCommandBuffer graphicsCommandBuffer{VK_NULL_HANDLE};
+  std::vector<std::unique_ptr<Buffer>> stagingBuffers;
+  VkDeviceSize stagingOffset{0};
+  std::vector<VkBufferMemoryBarrier> bufferBarriers;
+  std::vector<VkImageMemoryBarrier> imageBarriers;
+  // Tracked once the batch is acquired, on the thread that calls update()
+  std::vector<std::pair<Image *, VkImageLayout>> imageLayouts;
+};
+
+// Uploads buffer and image data through staging buffers on a transfer queue,
+// so that copies overlap with rendering. Uploads may be recorded from any
+// thread, each returns the timeline value after which the resource can be
+// used by graphics work recorded on the thread that calls update()
+struct Uploader {
+public:
+  static std::unique_ptr<Uploader>
+  make(Device &device, const Queue &graphicsQueue,
+       VkDeviceSize stagingBlockSize = 16 * 1024 * 1024);
+
+  ~Uploader();
+
+  bool uploadBuffer(const Buffer &buffer, VkDeviceSize offset,
+                    const void *data, VkDeviceSize size, uint64_t &value);
+
+  // Replace the contents of the first mip level and layer of a color image.
+  // Its tracked layout becomes `newLayout` when update() hands it over
+  bool uploadImage(Image &image, const void *data, VkDeviceSize size,
+                   VkImageLayout newLayout, uint64_t &value);
+
+  // Call once per frame from the thread that submits to the graphics queue.
+  // Submits the recorded uploads and hands completed ones over to the
+  // graphics queue, which never waits for a transfer in progress
+  bool update();
+
+  // Block until the upload of `value` has completed and is handed over. Call
+  // from the thread that calls update()
+  bool wait(uint64_t value);
+
+  bool isReady(uint64_t value) const { return value <= readyValue; }
+
+private:
+  bool requestBatch();
+  bool requestStaging(VkDeviceSize size, Buffer **buffer,
+                      VkDeviceSize &offset);
+  bool submitPending();
+  bool acquireCompleted();
+  void recycleAcquired();
+
+  Device *device{nullptr};
+  const Queue *transferQueue{nullptr};
+  const Queue *graphicsQueue{nullptr};
+  VkSemaphore transferSemaphore{VK_NULL_HANDLE};
+  VkSemaphore graphicsSemaphore{VK_NULL_HANDLE};
+  VkDeviceSize stagingBlockSize{0};
+
+  std::mutex mutex;
+  std::unique_ptr<UploadBatch> pendingBatch;
+  uint64_t submittedValue{0};
+  std::atomic<uint64_t> readyValue{0};
+  std::deque<std::unique_ptr<UploadBatch>> submittedBatches;
+  std::deque<std::unique_ptr<UploadBatch>> acquiredBatches;
+  std::vector<std::unique_ptr<UploadBatch>> freeBatches;
+  std::vector<std::unique_ptr<Buffer>> freeStagingBuffers;
+};
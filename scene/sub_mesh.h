@@ -2,7 +2,23 @@
 
 #include "renderer/shader_module.h"
 #include "scene/component.h"
+#include <glm/vec3.hpp>
 
+struct Buffer;
+
+// The layout of the vertices of every sub mesh, interleaved in one binding
+struct Vertex {
+  glm::vec3 position;
+  glm::vec3 color;
+};
+
+// Indexed triangles, in vertex and index buffers that sub meshes may share
 struct SubMesh : public Component {
   ShaderVariant shaderVariant{};
+  const Buffer *vertexBuffer{nullptr};
+  const Buffer *indexBuffer{nullptr};
+  VkIndexType indexType{VK_INDEX_TYPE_UINT16};
+  uint32_t indexCount{0};
+  uint32_t firstIndex{0};
+  int32_t vertexOffset{0}; // Added to each index
 };
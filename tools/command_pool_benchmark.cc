@@ -0,0 +1,115 @@
+// Measure the CPU cost per frame of recycling command buffers with each
+// CommandBufferResetMode, for several command buffers per frame. Every frame
+// resets the pool of the frame it takes over, the way RenderFrame does with
+// frames in flight, then requests, begins, records and ends its command
+// buffers. Nothing is submitted, so only the driver's CPU side is measured.
+//
+//   command_pool_benchmark [frames]
+
+#include "renderer/command_pool.h"
+#include "renderer/device.h"
+#include "renderer/instance.h"
+#include <array>
+#include <chrono>
+#include <iostream>
+#include <string>
+
+constexpr size_t FRAMES_IN_FLIGHT = 3;
+constexpr size_t WARMUP_FRAMES = 2 * FRAMES_IN_FLIGHT;
+
+constexpr std::array<CommandBufferResetMode, 3> RESET_MODES{
+    CommandBufferResetMode::ResetPool,
+    CommandBufferResetMode::ResetIndividually,
+    CommandBufferResetMode::AlwaysAllocate,
+};
+
+bool recordFrame(CommandPool &commandPool, size_t commandBufferCount) {
+  if (!commandPool.resetPool()) { return false; }
+  for (size_t i = 0; i < commandBufferCount; ++i) {
+    CommandBuffer *commandBuffer{nullptr};
+    if (!commandPool.requestCommandBuffer(&commandBuffer) ||
+        !commandBuffer->begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT)) {
+      return false;
+    }
+    // A few commands, so that there is something for the reset to release
+    VkViewport viewport{.width = 1920, .height = 1080, .maxDepth = 1.0f};
+    commandBuffer->setViewport(viewport);
+    commandBuffer->setScissor({.extent = {1920, 1080}});
+    if (!commandBuffer->end()) { return false; }
+  }
+  return true;
+}
+
+// Microseconds per frame, or a negative value when a frame failed
+double run(Device &device, uint32_t queueFamilyIndex,
+           CommandBufferResetMode resetMode, size_t commandBufferCount,
+           size_t frameCount) {
+  std::vector<std::unique_ptr<CommandPool>> commandPools;
+  for (size_t i = 0; i < FRAMES_IN_FLIGHT; ++i) {
+    auto commandPool = CommandPool::make(device, queueFamilyIndex, resetMode);
+    if (!commandPool) { return -1.0; }
+    commandPools.emplace_back(std::move(commandPool));
+  }
+
+  // The first frames allocate what later ones recycle
+  for (size_t frame = 0; frame < WARMUP_FRAMES; ++frame) {
+    if (!recordFrame(*commandPools[frame % FRAMES_IN_FLIGHT],
+                     commandBufferCount)) {
+      return -1.0;
+    }
+  }
+
+  auto begin = std::chrono::steady_clock::now();
+  for (size_t frame = 0; frame < frameCount; ++frame) {
+    if (!recordFrame(*commandPools[frame % FRAMES_IN_FLIGHT],
+                     commandBufferCount)) {
+      return -1.0;
+    }
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  auto microseconds =
+      std::chrono::duration<double, std::micro>(end - begin).count();
+  return microseconds / static_cast<double>(frameCount);
+}
+
+int main(int argc, char **argv) {
+  size_t frameCount =
+      std::max<size_t>(argc > 1 ? std::stoul(argv[1]) : 1000, 1);
+
+  VkInstance instance{VK_NULL_HANDLE};
+  VkDebugUtilsMessengerEXT messenger{VK_NULL_HANDLE};
+  if (!createInstance(&instance, &messenger)) { return 1; }
+  Device device{};
+  if (!createDevice(instance, &device, VK_NULL_HANDLE)) { return 1; }
+
+  int result = 0;
+  const Queue *queue{nullptr};
+  if (device.getQueue(VK_QUEUE_GRAPHICS_BIT, 0, &queue)) {
+    std::cout << "buffers  reset pool us/frame  reset individually "
+                 "us/frame  always allocate us/frame"
+              << std::endl;
+    for (size_t commandBufferCount : {1, 4, 16, 64, 256}) {
+      std::cout << commandBufferCount;
+      for (auto resetMode : RESET_MODES) {
+        auto microseconds = run(device, queue->familyIndex, resetMode,
+                                commandBufferCount, frameCount);
+        if (microseconds < 0.0) {
+          std::cout << std::endl
+                    << "[Benchmark] Recording a frame failed" << std::endl;
+          result = 1;
+          break;
+        }
+        std::cout << "\t " << microseconds;
+      }
+      if (result != 0) { break; }
+      std::cout << std::endl;
+    }
+  } else {
+    result = 1;
+  }
+
+  destroyDevice(&device);
+  destroyInstance(&instance, &messenger);
+  return result;
+}
@@ -0,0 +1,112 @@
+// Measure resource lookups from several threads at once, the way recording
+// threads request pipelines and framebuffers every frame. Compares the sharded
+// ResourceMap against one mutex around an unordered_map.
+//
+//   resource_map_benchmark [lookups per thread]
+
+#include "renderer/resource_map.h"
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+struct BenchmarkResource {
+  uint64_t value{0};
+};
+
+constexpr uint64_t KEY_COUNT = 1024;
+
+// What ResourceCache used before: a single lock taken for hits too
+struct LockedMap {
+public:
+  BenchmarkResource *getOrCreate(uint64_t key) {
+    std::lock_guard<std::mutex> guard(mutex);
+    auto &resource = resources[key];
+    if (!resource) {
+      resource = std::make_unique<BenchmarkResource>(key);
+      ++creations;
+    }
+    return resource.get();
+  }
+
+  std::atomic<size_t> creations{0};
+
+private:
+  std::mutex mutex;
+  std::unordered_map<uint64_t, std::unique_ptr<BenchmarkResource>> resources;
+};
+
+struct ShardedMap {
+public:
+  BenchmarkResource *getOrCreate(uint64_t key) {
+    return resources.getOrCreate(key, [&]() {
+      ++creations;
+      return std::make_unique<BenchmarkResource>(key);
+    });
+  }
+
+  std::atomic<size_t> creations{0};
+
+private:
+  ResourceMap<uint64_t, BenchmarkResource> resources;
+};
+
+// Every thread walks all keys from a different starting point, so the first
+// pass races to create them and the rest are hits
+template <typename Map>
+double run(size_t threadCount, size_t lookups, size_t &creations) {
+  Map map{};
+  std::atomic<bool> start{false};
+  std::atomic<uint64_t> checksum{0};
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < threadCount; ++t) {
+    threads.emplace_back([&, t]() {
+      while (!start.load(std::memory_order_acquire)) {}
+      uint64_t sum{0};
+      for (size_t i = 0; i < lookups; ++i) {
+        auto key = (i + t * 97) % KEY_COUNT;
+        sum += map.getOrCreate(key)->value;
+      }
+      checksum += sum;
+    });
+  }
+
+  auto begin = std::chrono::steady_clock::now();
+  start.store(true, std::memory_order_release);
+  for (auto &thread : threads) { thread.join(); }
+  auto end = std::chrono::steady_clock::now();
+
+  creations = map.creations;
+  auto nanoseconds =
+      std::chrono::duration<double, std::nano>(end - begin).count();
+  return nanoseconds / static_cast<double>(lookups);
+}
+
+int main(int argc, char **argv) {
+  // At least one pass over the keys, the creation counts are checked
+  size_t lookups = std::max<size_t>(
+      argc > 1 ? std::stoul(argv[1]) : 1000000, KEY_COUNT);
+  size_t maxThreadCount = std::max(1U, std::thread::hardware_concurrency());
+
+  std::cout << "threads  locked ns/lookup  sharded ns/lookup" << std::endl;
+  for (size_t threadCount = 1; threadCount <= maxThreadCount;
+       threadCount *= 2) {
+    size_t lockedCreations{0};
+    size_t shardedCreations{0};
+    auto locked = run<LockedMap>(threadCount, lookups, lockedCreations);
+    auto sharded = run<ShardedMap>(threadCount, lookups, shardedCreations);
+    std::cout << threadCount << "\t " << locked << "\t\t   " << sharded
+              << std::endl;
+
+    // Each key must be made exactly once however the threads race
+    if (lockedCreations != KEY_COUNT || shardedCreations != KEY_COUNT) {
+      std::cout << "[Benchmark] Expected " << KEY_COUNT
+                << " creations, got " << lockedCreations << " and "
+                << shardedCreations << std::endl;
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,141 @@
+// Compile the shaders listed in a manifest into one pack file that the
+// renderer maps at startup instead of compiling them.
+//
+//   shader_pack <manifest> <output>
+//
+// Each manifest line is a stage, a source path relative to the manifest and
+// the definitions of one variant, '#' starts a comment:
+//
+//   frag base.frag HAS_BASE_COLOR_TEXTURE=1 ALPHA_MASK
+
+#include "core/string_utils.h"
+#include "core/job_system.h"
+#include "renderer/shader_module.h"
+#include "renderer/shader_pack.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <optional>
+
+struct ShaderPackJob {
+  VkShaderStageFlagBits stage{};
+  std::string filepath;
+  std::vector<std::pair<std::string, std::string>> definitions;
+};
+
+std::optional<VkShaderStageFlagBits> parseStage(const std::string &name) {
+  if (name == "vert") { return VK_SHADER_STAGE_VERTEX_BIT; }
+  if (name == "tesc") { return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT; }
+  if (name == "tese") { return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT; }
+  if (name == "geom") { return VK_SHADER_STAGE_GEOMETRY_BIT; }
+  if (name == "frag") { return VK_SHADER_STAGE_FRAGMENT_BIT; }
+  if (name == "comp") { return VK_SHADER_STAGE_COMPUTE_BIT; }
+  return std::nullopt;
+}
+
+bool readManifest(const std::string &filepath,
+                  std::vector<ShaderPackJob> &jobs) {
+  std::ifstream fs(filepath);
+  if (!fs.is_open()) {
+    std::cout << "[ShaderPack] Failed to read " << filepath << std::endl;
+    return false;
+  }
+
+  auto directory = std::filesystem::path(filepath).parent_path();
+  std::string line{};
+  for (size_t number = 1; std::getline(fs, line); ++number) {
+    line = line.substr(0, line.find('#'));
+    std::replace(line.begin(), line.end(), '\t', ' ');
+    std::vector<std::string> tokens;
+    for (auto &token : split(trim(line), ' ')) {
+      if (!trim(token).empty()) { tokens.push_back(token); }
+    }
+    if (tokens.empty()) { continue; }
+
+    auto stage = parseStage(tokens[0]);
+    if (!stage || tokens.size() < 2) {
+      std::cout << "[ShaderPack] " << filepath << ":" << number
+                << ": expected <stage> <source> [definitions]" << std::endl;
+      return false;
+    }
+
+    ShaderPackJob job{};
+    job.stage = *stage;
+    job.filepath = (directory / tokens[1]).string();
+    for (size_t i = 2; i < tokens.size(); ++i) {
+      auto separator = tokens[i].find('=');
+      if (separator == std::string::npos) {
+        job.definitions.emplace_back(tokens[i], "1");
+      } else {
+        job.definitions.emplace_back(tokens[i].substr(0, separator),
+                                     tokens[i].substr(separator + 1));
+      }
+    }
+    jobs.push_back(std::move(job));
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  if (argc != 3) {
+    std::cout << "Usage: " << argv[0] << " <manifest> <output>" << std::endl;
+    return 1;
+  }
+
+  std::vector<ShaderPackJob> jobs;
+  if (!readManifest(argv[1], jobs)) { return 1; }
+
+  auto jobSystem = JobSystem::make();
+  if (!jobSystem) { return 1; }
+
+  auto compile =
+      [](const ShaderPackJob &job) -> std::optional<ShaderPackEntry> {
+    ShaderSource source{};
+    if (!createShaderSource(&source, job.filepath)) { return std::nullopt; }
+
+    ShaderVariant variant{};
+    variant.addDefinitions(job.definitions);
+
+    // Same entry point the renderer requests
+    std::string entry{"main"};
+    auto shaderModule = ShaderModule::make(job.stage, source, entry, variant);
+    if (!shaderModule) { return std::nullopt; }
+
+    auto spirv = shaderModule->getSpirv();
+    return ShaderPackEntry{
+        getShaderCacheKey(job.stage, source, entry, variant),
+        {spirv.begin(), spirv.end()},
+        shaderModule->getResources(),
+    };
+  };
+
+  // One job per shader, they vary too much in cost to be batched
+  std::vector<std::optional<ShaderPackEntry>> results(jobs.size());
+  JobCounter counter;
+  for (size_t i = 0; i < jobs.size(); ++i) {
+    jobSystem->run([&, i]() { results[i] = compile(jobs[i]); }, &counter);
+  }
+  jobSystem->wait(counter);
+
+  std::vector<ShaderPackEntry> entries;
+  bool failed{false};
+  for (size_t i = 0; i < results.size(); ++i) {
+    if (!results[i]) {
+      std::cout << "[ShaderPack] Failed to compile " << jobs[i].filepath
+                << std::endl;
+      failed = true;
+      continue;
+    }
+    entries.push_back(std::move(*results[i]));
+  }
+  if (failed) { return 1; }
+
+  if (!ShaderPack::write(argv[2], std::move(entries))) {
+    std::cout << "[ShaderPack] Failed to write " << argv[2] << std::endl;
+    return 1;
+  }
+  std::cout << "[ShaderPack] Wrote " << jobs.size() << " shaders to "
+            << argv[2] << std::endl;
+  return 0;
+}